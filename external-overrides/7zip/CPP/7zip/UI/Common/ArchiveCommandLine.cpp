@@ -178,7 +178,13 @@ enum Enum
   kDeleteAfterCompressing,
   kSetArcMTime,
 
-  kGcxReport //to gcx
+  kGcxReport, //to gcx
+  kGcxBench,
+  kGcxBenchThreads,
+  kGcxBenchDicts,
+  kGcxChunk,
+  kGcxUnchunk,
+  kGcxExtract
 
   #ifndef Z7_NO_CRYPTO
   , kPassword
@@ -330,7 +336,13 @@ static const CSwitchForm kSwitchForms[] =
   
   { "sdel", SWFRM_SIMPLE },
   { "stl", SWFRM_SIMPLE },
-  { "gcx_report", NSwitchType::kString, false,1, NULL } // para gcx
+  { "gcx_report", NSwitchType::kString, false,1, NULL }, // para gcx
+  { "gcx_bench", NSwitchType::kString, false,1, NULL },
+  { "gcx_bench_mt", NSwitchType::kString, false,1, NULL },
+  { "gcx_bench_md", NSwitchType::kString, false,1, NULL },
+  { "gcx_chunk", NSwitchType::kString, false,1, NULL },
+  { "gcx_unchunk", NSwitchType::kSimple, false,0, NULL },
+  { "gcx_extract", NSwitchType::kString, false,1, NULL }
 
   #ifndef Z7_NO_CRYPTO
   , { "p", SWFRM_STRING }
@@ -1296,6 +1308,28 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
     options.GcxReportPath = parser[NKey::kGcxReport].PostStrings.Front(); 
     printf("Caminho do relatório GCX: %S\n", options.GcxReportPath.Ptr());
   }
+  if (parser[NKey::kGcxBenchThreads].ThereIs)
+    options.GcxBenchThreads = parser[NKey::kGcxBenchThreads].PostStrings.Front();
+  if (parser[NKey::kGcxBenchDicts].ThereIs)
+    options.GcxBenchDicts = parser[NKey::kGcxBenchDicts].PostStrings.Front();
+  if (parser[NKey::kGcxBench].ThereIs)
+  {
+    // no archive command: Main2() runs the in-memory benchmark
+    options.GcxBenchPath = parser[NKey::kGcxBench].PostStrings.Front();
+    return;
+  }
+  if (parser[NKey::kGcxChunk].ThereIs || parser[NKey::kGcxUnchunk].ThereIs
+      || parser[NKey::kGcxExtract].ThereIs)
+  {
+    // no archive command either: the non-switch strings are the file arguments
+    if (parser[NKey::kGcxChunk].ThereIs)
+      options.GcxChunkSize = parser[NKey::kGcxChunk].PostStrings.Front();
+    options.GcxUnchunk = parser[NKey::kGcxUnchunk].ThereIs;
+    if (parser[NKey::kGcxExtract].ThereIs)
+      options.GcxExtractQuery = parser[NKey::kGcxExtract].PostStrings.Front();
+    options.GcxArgs = nonSwitchStrings;
+    return;
+  }
 
 
   if (numNonSwitchStrings < kMinNonSwitchWords)
@@ -49,6 +49,13 @@ enum
 struct CArcCmdLineOptions
 {
   UString GcxReportPath; //to gcx
+  UString GcxBenchPath; // -gcx_bench: in-memory LZMA2 sweep of this file
+  UString GcxBenchThreads; // -gcx_bench_mt list, e.g. 1,2,4
+  UString GcxBenchDicts; // -gcx_bench_md list, e.g. 1m,16m,64m
+  UString GcxChunkSize; // -gcx_chunk: write a chunked LZMA2 file (GcxChunked.h)
+  bool GcxUnchunk; // -gcx_unchunk: decode a whole chunked file
+  UString GcxExtractQuery; // -gcx_extract: substrings from a chunked file
+  UStringVector GcxArgs; // file arguments of the three modes above
   bool HelpMode;
 
   // bool LargePages;
@@ -122,6 +129,7 @@ struct CArcCmdLineOptions
   bool NumIterations_Defined;
 
   CArcCmdLineOptions():
+      GcxUnchunk(false),
       HelpMode(false),
       // LargePages(false),
       CaseSensitive_Change(false),
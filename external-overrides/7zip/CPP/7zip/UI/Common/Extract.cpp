@@ -2,6 +2,11 @@
 
 #include "StdAfx.h"
 
+#include "../../../../C/Alloc.h"
+#include "../../../../C/CpuArch.h"
+#include "../../../../C/Lzma2Dec.h"
+
+#include "../../../Common/MyBuffer.h"
 #include "../../../Common/StringConvert.h"
 
 #include "../../../Windows/FileDir.h"
@@ -14,13 +19,10 @@
 #include "../Common/HashCalc.h"
 
 #include "Extract.h"
+#include "GcxChunked.h"
+#include "GcxReport.h"
 #include "SetProperties.h"
 
-//to gcx
-#include <ctime>
-#include <cstdio>
-#include <cstdlib>
-
 using namespace NWindows;
 using namespace NFile;
 using namespace NDir;
@@ -226,7 +228,7 @@ static HRESULT DecompressArchive(
 
   if (options.StdInMode)
   {
-    result = archive->Extract(NULL, (UInt32)(Int32)-1, testMode, ecs);
+    result = archive->Extract(NULL, (UInt32)0xFFFFFFFF, testMode, ecs);
     NCOM::CPropVariant prop;
     if (archive->GetArchiveProperty(kpidPhySize, &prop) == S_OK)
       ConvertPropVariantToUInt64(prop, stdInProcessed);
@@ -295,8 +297,8 @@ HRESULT Extract(
   CRecordVector<UInt64> arcSizes;
 
   //to gcx
-  clock_t clock_time;
-  clock_time = clock();
+  gcx_probe probe;
+  gcx_probe_start(&probe);
 
   unsigned numArcs = options.StdInMode ? 1 : arcPaths.Size();
 
@@ -583,25 +585,225 @@ HRESULT Extract(
   st.PackSize = ecs->LocalProgressSpec->InSize;
 
   //to gcx
-  clock_time = clock() - clock_time;
-  double duration = ((double)clock_time)/CLOCKS_PER_SEC;
-  UString reportPath1 = file_report_gcx; // Cria uma cópia mutável
-  if (reportPath1[0] == L'=') {
-    reportPath1.Delete(0); // Remove o '=' do início
+  gcx_probe_stop(&probe);
+  Gcx_AppendReport(file_report_gcx, probe, "decompression");
+
+  return S_OK;
+}
+
+class CGcxChunkedArchive
+{
+  FILE *_file;
+  UInt64 _dataPos;
+  CByteBuffer _packed;
+public:
+  UInt64 ChunkSize;
+  UInt64 PlainSize;
+  UInt32 NumChunks;
+  CByteBuffer Props;
+  CRecordVector<UInt64> Offsets;
+
+  CGcxChunkedArchive(): _file(NULL) {}
+  ~CGcxChunkedArchive() { if (_file) fclose(_file); }
+
+  UInt64 ChunkLen(UInt32 index) const
+  {
+    return MyMin(ChunkSize, PlainSize - (UInt64)index * ChunkSize);
+  }
+
+  bool Open(const UString &path)
+  {
+    _file = fopen(GetAnsiString(path), "rb");
+    if (!_file)
+      return false;
+    Byte header[kGcxChunkedHeaderSize];
+    if (fread(header, 1, kGcxChunkedHeaderSize, _file) != kGcxChunkedHeaderSize
+        || memcmp(header, kGcxChunkedSignature, kGcxChunkedSignatureSize) != 0)
+      return false;
+    ChunkSize = GetUi64(header + kGcxChunkedSignatureSize);
+    PlainSize = GetUi64(header + kGcxChunkedSignatureSize + 8);
+    NumChunks = GetUi32(header + kGcxChunkedSignatureSize + 16);
+    if (ChunkSize == 0 || (PlainSize + ChunkSize - 1) / ChunkSize != NumChunks)
+      return false;
+    Props.Alloc(NumChunks);
+    CByteBuffer offsets(((size_t)NumChunks + 1) * 8);
+    if (fread(Props, 1, Props.Size(), _file) != Props.Size()
+        || fread(offsets, 1, offsets.Size(), _file) != offsets.Size())
+      return false;
+    for (UInt32 i = 0; i <= NumChunks; i++)
+      Offsets.Add(GetUi64(offsets + (size_t)i * 8));
+    _dataPos = kGcxChunkedHeaderSize + Props.Size() + offsets.Size();
+    return true;
+  }
+
+  // dest must hold ChunkLen(index) bytes
+  HRESULT DecodeChunk(UInt32 index, Byte *dest)
+  {
+    const size_t packSize = (size_t)(Offsets[index + 1] - Offsets[index]);
+    if (_packed.Size() < packSize)
+      _packed.Alloc(packSize);
+    if (fseek(_file, (long)(_dataPos + Offsets[index]), SEEK_SET) != 0
+        || fread(_packed, 1, packSize, _file) != packSize)
+      return E_FAIL;
+    SizeT destLen = (SizeT)ChunkLen(index);
+    SizeT srcLen = packSize;
+    ELzmaStatus status;
+    const SRes res = Lzma2Decode(dest, &destLen, _packed, &srcLen, Props[index],
+        LZMA_FINISH_END, &status, &g_Alloc);
+    if (res == SZ_ERROR_MEM)
+      return E_OUTOFMEMORY;
+    if (res != SZ_OK || destLen != ChunkLen(index) || srcLen != packSize)
+      return S_FALSE;
+    return S_OK;
+  }
+};
+
+
+HRESULT GcxChunkedDecompress(const UString &archivePath, const UString &outPath,
+    const UString &file_report_gcx)
+{
+  gcx_probe probe;
+  gcx_probe_start(&probe);
+
+  CGcxChunkedArchive arc;
+  if (!arc.Open(archivePath))
+  {
+    printf("%s is not a chunked 7z file\n", GetAnsiString(archivePath).Ptr());
+    return E_FAIL;
+  }
+  FILE *out = fopen(GetAnsiString(outPath), "wb");
+  if (!out)
+    return E_FAIL;
+  CByteBuffer chunk((size_t)arc.ChunkSize);
+  for (UInt32 i = 0; i < arc.NumChunks; i++)
+  {
+    const HRESULT res = arc.DecodeChunk(i, chunk);
+    const size_t size = (size_t)arc.ChunkLen(i);
+    if (res != S_OK || fwrite(chunk, 1, size, out) != size)
+    {
+      fclose(out);
+      return (res != S_OK ? res : E_FAIL);
+    }
+  }
+  if (fclose(out) != 0)
+    return E_FAIL;
+
+  gcx_probe_stop(&probe);
+  Gcx_AppendReport(file_report_gcx, probe, "decompression");
+  return S_OK;
+}
+
+
+struct CGcxCachedChunk
+{
+  UInt32 Index;
+  UInt64 LastUse;
+  CByteBuffer Data;
+};
+
+/*
+Each line of the query file is an inclusive "l r" interval of the plain text.
+Only the chunks covering it are decoded, and the last kGcxChunkedCacheSize
+decoded chunks are kept (LRU). The substrings go to outPath (if not empty)
+in the "[l,r]\n<substring>\n" format of scripts/extract.py.
+*/
+HRESULT GcxChunkedExtract(const UString &archivePath, const UString &queryPath,
+    const UString &outPath, const UString &file_report_gcx)
+{
+  CGcxChunkedArchive arc;
+  if (!arc.Open(archivePath))
+  {
+    printf("%s is not a chunked 7z file\n", GetAnsiString(archivePath).Ptr());
+    return E_FAIL;
   }
-  AString reportPathAnsi = GetAnsiString(reportPath1);
-  const char *reportPath = reportPathAnsi.Ptr();
-  printf("\nGravando resultados em %s\n",reportPath);
-  FILE *report_gcx = fopen(reportPath, "a");
-  if(report_gcx == NULL){
-    printf("Error opening file %s\n",reportPath);
-    exit(1);
+  FILE *queries = fopen(GetAnsiString(queryPath), "r");
+  if (!queries)
+    return E_FAIL;
+  FILE *out = NULL;
+  if (!outPath.IsEmpty())
+  {
+    out = fopen(GetAnsiString(outPath), "wb");
+    if (!out)
+    {
+      fclose(queries);
+      return E_FAIL;
+    }
+  }
+
+  CGcxCachedChunk cache[kGcxChunkedCacheSize];
+  for (unsigned k = 0; k < kGcxChunkedCacheSize; k++)
+  {
+    cache[k].Index = (UInt32)0xFFFFFFFF;
+    cache[k].LastUse = 0;
   }
-  //long long int peak = malloc_count_peak();
-  // long long int stack = stack_count_usage(base);
-  fprintf(report_gcx, "0|0|%5.4lf|",duration);
-  printf("Time inserted into the DCX report: %5.4lf\n", duration);
-  fclose(report_gcx);
+  UInt64 tick = 0, numQueries = 0, numDecoded = 0;
+  unsigned long long l, r;
+  HRESULT res = S_OK;
+
+  gcx_probe probe;
+  gcx_probe_start(&probe);
+  while (res == S_OK && fscanf(queries, "%llu %llu", &l, &r) == 2)
+  {
+    if (l > r || r >= arc.PlainSize)
+    {
+      printf("query [%llu,%llu] out of range (text length %llu)\n",
+          l, r, (unsigned long long)arc.PlainSize);
+      res = E_INVALIDARG;
+      break;
+    }
+    if (out)
+      fprintf(out, "[%llu,%llu]\n", l, r);
+    tick++;
+    for (UInt64 pos = l; pos <= r;)
+    {
+      const UInt32 index = (UInt32)(pos / arc.ChunkSize);
+      unsigned slot = 0;
+      for (unsigned k = 0; k < kGcxChunkedCacheSize; k++)
+      {
+        if (cache[k].Index == index)
+        {
+          slot = k;
+          break;
+        }
+        if (cache[k].LastUse < cache[slot].LastUse)
+          slot = k;
+      }
+      CGcxCachedChunk &c = cache[slot];
+      if (c.Index != index)
+      {
+        if (c.Data.Size() < arc.ChunkSize)
+          c.Data.Alloc((size_t)arc.ChunkSize);
+        c.Index = index;
+        res = arc.DecodeChunk(index, c.Data);
+        if (res != S_OK)
+        {
+          c.Index = (UInt32)0xFFFFFFFF;
+          break;
+        }
+        numDecoded++;
+      }
+      c.LastUse = tick;
+      const UInt64 chunkStart = (UInt64)index * arc.ChunkSize;
+      const UInt64 end = MyMin((UInt64)r + 1, chunkStart + arc.ChunkLen(index));
+      if (out && fwrite(c.Data + (size_t)(pos - chunkStart), 1,
+          (size_t)(end - pos), out) != (size_t)(end - pos))
+        res = E_FAIL;
+      pos = end;
+    }
+    if (out)
+      fputc('\n', out);
+    numQueries++;
+  }
+  gcx_probe_stop(&probe);
+
+  fclose(queries);
+  if (out && fclose(out) != 0 && res == S_OK)
+    res = E_FAIL;
+  if (res != S_OK)
+    return res;
 
+  printf("queries: %u, chunks: %u, chunks decoded: %u\n",
+      (unsigned)numQueries, (unsigned)arc.NumChunks, (unsigned)numDecoded);
+  Gcx_AppendReport(file_report_gcx, probe, "extraction");
   return S_OK;
 }
@@ -0,0 +1,43 @@
+// GcxChunked.h
+
+#ifndef ZIP7_INC_GCX_CHUNKED_H
+#define ZIP7_INC_GCX_CHUNKED_H
+
+#include "../../../Common/MyString.h"
+#include "../../../Common/MyTypes.h"
+
+/*
+Chunked LZMA2 file for substring extraction (to gcx).
+The input is cut into chunks of a fixed size and every chunk is an
+independent LZMA2 stream, so a chunk can be decoded on its own:
+
+  8 bytes        kGcxChunkedSignature
+  UInt64         chunk size
+  UInt64         plain size
+  UInt32         number of chunks (n)
+  n bytes        LZMA2 property byte of each chunk
+  (n + 1) UInt64 offsets of the chunks, from the end of this table
+  n LZMA2 streams
+
+All numbers are little-endian.
+*/
+
+const unsigned kGcxChunkedSignatureSize = 8;
+const Byte kGcxChunkedSignature[kGcxChunkedSignatureSize] =
+  { '7', 'z', 'G', 'C', 'X', 'c', 'k', '1' };
+
+const unsigned kGcxChunkedHeaderSize = kGcxChunkedSignatureSize + 8 + 8 + 4;
+
+// decoded chunks kept by GcxChunkedExtract()
+const unsigned kGcxChunkedCacheSize = 8;
+
+HRESULT GcxChunkedCompress(const UString &inPath, const UString &archivePath,
+    UInt64 chunkSize, const UString &file_report_gcx);
+
+HRESULT GcxChunkedDecompress(const UString &archivePath, const UString &outPath,
+    const UString &file_report_gcx);
+
+HRESULT GcxChunkedExtract(const UString &archivePath, const UString &queryPath,
+    const UString &outPath, const UString &file_report_gcx);
+
+#endif
@@ -0,0 +1,35 @@
+// GcxReport.h
+
+#ifndef ZIP7_INC_GCX_REPORT_H
+#define ZIP7_INC_GCX_REPORT_H
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "../../../Common/MyString.h"
+#include "../../../Common/StringConvert.h"
+
+//to gcx
+#define GCX_PROBE_NO_MALLOC_COUNT
+#include "../../../../../malloc_count/gcx_probe.h"
+
+// appends the columns of a stopped probe to the gcx report, and its record
+inline void Gcx_AppendReport(const UString &file_report_gcx, const gcx_probe &probe,
+    const char *phase)
+{
+  gcx_probe_record(&probe, "7zz", phase);
+  if (file_report_gcx.IsEmpty())
+    return;
+  UString reportPath1 = file_report_gcx;
+  if (reportPath1[0] == L'=') {
+    reportPath1.Delete(0);
+  }
+  AString reportPathAnsi = GetAnsiString(reportPath1);
+  const char *reportPath = reportPathAnsi.Ptr();
+  if (!gcx_probe_report(reportPath, &probe)) {
+    printf("Error opening file %s\n",reportPath);
+    exit(1);
+  }
+}
+
+#endif
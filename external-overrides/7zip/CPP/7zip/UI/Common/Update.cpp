@@ -6,6 +6,11 @@
 
 #include "Update.h"
 
+#include "../../../../C/Alloc.h"
+#include "../../../../C/CpuArch.h"
+#include "../../../../C/Lzma2Enc.h"
+
+#include "../../../Common/MyBuffer.h"
 #include "../../../Common/StringConvert.h"
 
 #include "../../../Windows/DLL.h"
@@ -29,17 +34,12 @@
 #include "../Common/UpdateProduce.h"
 
 #include "EnumDirItems.h"
+#include "GcxChunked.h"
+#include "GcxReport.h"
 #include "SetProperties.h"
 #include "TempFiles.h"
 #include "UpdateCallback.h"
 
-//to gcx
-#include <ctime>
-#include <cstdio>
-#include <cstdlib>
-//using namespace std::chrono;
-//using timer = std::chrono::high_resolution_clock;
-
 static const char * const kUpdateIsNotSupoorted =
   "update operations are not supported for this archive";
 
@@ -370,14 +370,14 @@ static HRESULT Compress(
     const UString &file_report_gcx)
 {
   //to gcx
-  clock_t clock_time;
-  clock_time = clock();
+  gcx_probe probe;
+  gcx_probe_start(&probe);
   
   CMyComPtr<IOutArchive> outArchive;
   int formatIndex = options.MethodMode.Type.FormatIndex;
   if (arc)
   {
-    clock_time = clock();
+    gcx_probe_start(&probe);
     formatIndex = arc->FormatIndex;
     if (formatIndex < 0)
       return E_NOTIMPL;
@@ -953,25 +953,8 @@ static HRESULT Compress(
   }
   
   //to gcx
-  clock_time = clock() - clock_time;
-  double duration = ((double)clock_time)/CLOCKS_PER_SEC;
-  UString reportPath1 = file_report_gcx; // Cria uma cópia mutável
-  if (reportPath1[0] == L'=') {
-    reportPath1.Delete(0); // Remove o '=' do início
-  }
-  AString reportPathAnsi = GetAnsiString(reportPath1);
-  const char *reportPath = reportPathAnsi.Ptr();
-  printf("\nGravando resultados em %s\n",reportPath);
-  FILE *report_gcx = fopen(reportPath, "a");
-  if(report_gcx == NULL){
-    printf("Error opening file %s\n",reportPath);
-    exit(1);
-  }
-  //long long int peak = malloc_count_peak();
-  // long long int stack = stack_count_usage(base);
-  fprintf(report_gcx, "0|0|%5.4lf|",duration);
-  printf("Time inserted into the DCX report: %5.4lf\n", duration);
-  fclose(report_gcx);
+  gcx_probe_stop(&probe);
+  Gcx_AppendReport(file_report_gcx, probe, "compression");
 
   return result;
 }
@@ -1966,3 +1949,117 @@ Z7_DIAGNOSTIC_IGNORE_CAST_FUNCTION
 
   return S_OK;
 }
+
+// chunked LZMA2 file (GcxChunked.h); the chunks are encoded one after another
+HRESULT GcxChunkedCompress(const UString &inPath, const UString &archivePath,
+    UInt64 chunkSize, const UString &file_report_gcx)
+{
+  gcx_probe probe;
+  gcx_probe_start(&probe);
+
+  const AString inPathAnsi = GetAnsiString(inPath);
+  const AString arcPathAnsi = GetAnsiString(archivePath);
+  FILE *in = fopen(inPathAnsi, "rb");
+  if (!in)
+  {
+    printf("Cannot open %s\n", inPathAnsi.Ptr());
+    return E_FAIL;
+  }
+  FILE *out = fopen(arcPathAnsi, "wb");
+  if (!out)
+  {
+    fclose(in);
+    printf("Cannot create %s\n", arcPathAnsi.Ptr());
+    return E_FAIL;
+  }
+
+  fseek(in, 0, SEEK_END);
+  const UInt64 plainSize = (UInt64)ftell(in);
+  fseek(in, 0, SEEK_SET);
+  const UInt64 numChunks64 = (plainSize + chunkSize - 1) / chunkSize;
+  if (numChunks64 > (UInt32)0xFFFFFFFF)
+  {
+    fclose(in);
+    fclose(out);
+    return E_INVALIDARG;
+  }
+  const UInt32 numChunks = (UInt32)numChunks64;
+
+  CByteBuffer props(numChunks);
+  CByteBuffer offsets(((size_t)numChunks + 1) * 8);
+  Byte header[kGcxChunkedHeaderSize];
+  memcpy(header, kGcxChunkedSignature, kGcxChunkedSignatureSize);
+  SetUi64(header + kGcxChunkedSignatureSize, chunkSize)
+  SetUi64(header + kGcxChunkedSignatureSize + 8, plainSize)
+  SetUi32(header + kGcxChunkedSignatureSize + 16, numChunks)
+
+  HRESULT res = S_OK;
+  // the tables are written again once the chunks are packed
+  if (fwrite(header, 1, kGcxChunkedHeaderSize, out) != kGcxChunkedHeaderSize
+      || fwrite(props, 1, props.Size(), out) != props.Size()
+      || fwrite(offsets, 1, offsets.Size(), out) != offsets.Size())
+    res = E_FAIL;
+
+  const size_t packCapacity = (size_t)(chunkSize + chunkSize / 16 + (1 << 16));
+  CByteBuffer chunk((size_t)chunkSize);
+  CByteBuffer packed(packCapacity);
+
+  // one encoder for all the chunks, with a dictionary no larger than a chunk
+  // (the level-5 default is 16 MiB); 4 KiB is the smallest LZMA dictionary
+  CLzma2EncProps encProps;
+  Lzma2EncProps_Init(&encProps);
+  encProps.numTotalThreads = 1;
+  Lzma2EncProps_Normalize(&encProps);
+  if (encProps.lzmaProps.dictSize > chunkSize)
+    encProps.lzmaProps.dictSize = (UInt32)MyMax(chunkSize, (UInt64)1 << 12);
+  CLzma2EncHandle enc = Lzma2Enc_Create(&g_AlignedAlloc, &g_BigAlloc);
+  if (!enc)
+    res = E_OUTOFMEMORY;
+  else if (Lzma2Enc_SetProps(enc, &encProps) != SZ_OK)
+    res = E_INVALIDARG;
+
+  UInt64 offset = 0;
+  for (UInt32 i = 0; i < numChunks && res == S_OK; i++)
+  {
+    const size_t size = (size_t)MyMin(chunkSize, plainSize - (UInt64)i * chunkSize);
+    if (fread(chunk, 1, size, in) != size)
+    {
+      res = E_FAIL;
+      break;
+    }
+    size_t packSize = packCapacity;
+    Lzma2Enc_SetDataSize(enc, size);
+    props[i] = Lzma2Enc_WriteProperties(enc);
+    const SRes sres = Lzma2Enc_Encode2(enc, NULL, packed, &packSize, NULL, chunk, size, NULL);
+    if (sres != SZ_OK)
+      res = (sres == SZ_ERROR_MEM ? E_OUTOFMEMORY : E_FAIL);
+    else if (fwrite(packed, 1, packSize, out) != packSize)
+      res = E_FAIL;
+    SetUi64(offsets + (size_t)i * 8, offset)
+    offset += packSize;
+  }
+  SetUi64(offsets + (size_t)numChunks * 8, offset)
+  if (enc)
+    Lzma2Enc_Destroy(enc);
+
+  if (res == S_OK)
+  {
+    fseek(out, kGcxChunkedHeaderSize, SEEK_SET);
+    if (fwrite(props, 1, props.Size(), out) != props.Size()
+        || fwrite(offsets, 1, offsets.Size(), out) != offsets.Size())
+      res = E_FAIL;
+  }
+  fclose(in);
+  if (fclose(out) != 0)
+    res = E_FAIL;
+  if (res != S_OK)
+    return res;
+
+  printf("%u chunks of %u bytes, %u bytes packed\n",
+      (unsigned)numChunks, (unsigned)chunkSize,
+      (unsigned)(kGcxChunkedHeaderSize + props.Size() + offsets.Size() + offset));
+
+  gcx_probe_stop(&probe);
+  Gcx_AppendReport(file_report_gcx, probe, "compression");
+  return S_OK;
+}
@@ -35,16 +35,21 @@ typedef PROCESS_MEMORY_COUNTERS *PPROCESS_MEMORY_COUNTERS;
 #else // _WIN32
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #endif // _WIN32
 
+#include "../../../../C/Alloc.h"
 #include "../../../../C/CpuArch.h"
+#include "../../../../C/Lzma2DecMt.h"
+#include "../../../../C/Lzma2Enc.h"
 
 #include "../../../Common/MyInitGuid.h"
 
 #include "../../../Common/CommandLineParser.h"
 #include "../../../Common/IntToString.h"
+#include "../../../Common/MyBuffer.h"
 #include "../../../Common/MyException.h"
 #include "../../../Common/StdInStream.h"
 #include "../../../Common/StdOutStream.h"
@@ -55,11 +60,13 @@ typedef PROCESS_MEMORY_COUNTERS *PPROCESS_MEMORY_COUNTERS;
 #include "../../../Windows/ErrorMsg.h"
 #include "../../../Windows/TimeUtils.h"
 #include "../../../Windows/FileDir.h"
+#include "../../../Windows/System.h"
 
 #include "../Common/ArchiveCommandLine.h"
 #include "../Common/Bench.h"
 #include "../Common/ExitCode.h"
 #include "../Common/Extract.h"
+#include "../Common/GcxChunked.h"
 
 #ifdef Z7_EXTERNAL_CODECS
 #include "../Common/LoadCodecs.h"
@@ -788,6 +795,375 @@ static void PrintStat(const UInt64 startTime)
 #endif // ! _WIN32
 
 
+// parses "1,2,4" or "1m,16m,64m" (k/m/g suffixes)
+static bool Gcx_ParseList(const UString &s, CRecordVector<UInt64> &values)
+{
+  UString list = s;
+  if (!list.IsEmpty() && list[0] == L'=')
+    list.Delete(0);
+  values.Clear();
+  const wchar_t *p = list.Ptr();
+  while (*p != 0)
+  {
+    const wchar_t *end;
+    UInt64 v = ConvertStringToUInt64(p, &end);
+    if (end == p)
+      return false;
+    p = end;
+    switch (MyCharLower_Ascii(*p))
+    {
+      case 'k': v <<= 10; p++; break;
+      case 'm': v <<= 20; p++; break;
+      case 'g': v <<= 30; p++; break;
+      default: break;
+    }
+    if (v == 0)
+      return false;
+    values.Add(v);
+    if (*p == ',')
+      p++;
+    else if (*p != 0)
+      return false;
+  }
+  return !values.IsEmpty();
+}
+
+// -gcx_chunk=<size> <input> <archive>
+// -gcx_unchunk <archive> <output>
+// -gcx_extract=<query file> <archive> [<output>]
+static int GcxChunked(const CArcCmdLineOptions &options)
+{
+  const UStringVector &args = options.GcxArgs;
+  HRESULT res;
+  if (!options.GcxChunkSize.IsEmpty())
+  {
+    CRecordVector<UInt64> chunkSize;
+    if (!Gcx_ParseList(options.GcxChunkSize, chunkSize) || chunkSize.Size() != 1
+        || chunkSize[0] > ((UInt64)1 << 31) || args.Size() != 2)
+      throw CArcCmdLineException("Usage: -gcx_chunk=<size> <input> <archive>");
+    res = GcxChunkedCompress(args[0], args[1], chunkSize[0], options.GcxReportPath);
+  }
+  else if (options.GcxUnchunk)
+  {
+    if (args.Size() != 2)
+      throw CArcCmdLineException("Usage: -gcx_unchunk <archive> <output>");
+    res = GcxChunkedDecompress(args[0], args[1], options.GcxReportPath);
+  }
+  else
+  {
+    UString queryPath = options.GcxExtractQuery;
+    if (queryPath[0] == L'=')
+      queryPath.Delete(0);
+    if (args.Size() != 1 && args.Size() != 2)
+      throw CArcCmdLineException("Usage: -gcx_extract=<query file> <archive> [<output>]");
+    res = GcxChunkedExtract(args[0], queryPath, args.Size() == 2 ? args[1] : UString(),
+        options.GcxReportPath);
+  }
+  if (res == S_FALSE)
+  {
+    if (g_ErrStream)
+      *g_ErrStream << "\nData ERROR in chunked 7z file\n";
+    return NExitCode::kFatalError;
+  }
+  if (res != S_OK)
+    throw CSystemException(res);
+  return 0;
+}
+
+
+#ifndef _WIN32
+
+// -gcx_bench: LZMA2 compression and decompression between memory buffers,
+// swept over thread counts (-mmt) and dictionary sizes, so that the 7zip
+// baseline is measured without the archive handler and the filesystem.
+// The peaks are the peak RSS above the RSS at the start of the operation, so
+// the input, packed and unpacked buffers of the harness are not counted.
+
+struct CGcxMemOutStream
+{
+  ISeqOutStream vt;
+  Byte *Buf;
+  size_t Size;
+  size_t Pos;
+};
+
+static size_t GcxMemOutStream_Write(ISeqOutStreamPtr pp, const void *data, size_t size)
+{
+  CGcxMemOutStream *p = (CGcxMemOutStream *)(void *)pp;
+  if (size > p->Size - p->Pos)
+    size = p->Size - p->Pos;
+  memcpy(p->Buf + p->Pos, data, size);
+  p->Pos += size;
+  return size;
+}
+
+struct CGcxMemInStream
+{
+  ISeqInStream vt;
+  const Byte *Buf;
+  size_t Size;
+  size_t Pos;
+};
+
+static SRes GcxMemInStream_Read(ISeqInStreamPtr pp, void *data, size_t *size)
+{
+  CGcxMemInStream *p = (CGcxMemInStream *)(void *)pp;
+  if (*size > p->Size - p->Pos)
+    *size = p->Size - p->Pos;
+  memcpy(data, p->Buf + p->Pos, *size);
+  p->Pos += *size;
+  return SZ_OK;
+}
+
+struct CGcxProbe
+{
+  UInt64 Wall_us;
+  UInt64 Cpu_us;
+  UInt64 Rss; // at the start
+};
+
+static UInt64 Gcx_Cpu_us()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (UInt64)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+      + (UInt64)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+// Resets the peak RSS (VmHWM) of the process, so that each configuration
+// gets its own peak. Linux only; elsewhere the peak stays cumulative.
+static void Gcx_ResetPeakRss()
+{
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+  if (f)
+  {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+static UInt64 Gcx_PeakRss()
+{
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f)
+  {
+    char line[256];
+    unsigned long long kb;
+    while (fgets(line, sizeof(line), f))
+      if (sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+      {
+        fclose(f);
+        return (UInt64)kb << 10;
+      }
+    fclose(f);
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (UInt64)ru.ru_maxrss << 10;
+}
+
+// Current RSS (VmRSS), 0 where /proc is missing.
+static UInt64 Gcx_Rss()
+{
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f)
+  {
+    char line[256];
+    unsigned long long kb;
+    while (fgets(line, sizeof(line), f))
+      if (sscanf(line, "VmRSS: %llu kB", &kb) == 1)
+      {
+        fclose(f);
+        return (UInt64)kb << 10;
+      }
+    fclose(f);
+  }
+  return 0;
+}
+
+// Peak RSS since Gcx_Start above the RSS at that point.
+static UInt64 Gcx_PeakRssAbove(const CGcxProbe &p)
+{
+  const UInt64 peak = Gcx_PeakRss();
+  return peak > p.Rss ? peak - p.Rss : 0;
+}
+
+static void Gcx_Start(CGcxProbe &p)
+{
+  Gcx_ResetPeakRss();
+  p.Rss = Gcx_Rss();
+  p.Cpu_us = Gcx_Cpu_us();
+  p.Wall_us = Get_timeofday_us();
+}
+
+static void Gcx_Stop(CGcxProbe &p)
+{
+  p.Wall_us = Get_timeofday_us() - p.Wall_us;
+  p.Cpu_us = Gcx_Cpu_us() - p.Cpu_us;
+}
+
+static int GcxBench(const CArcCmdLineOptions &options)
+{
+  UString inPath = options.GcxBenchPath;
+  if (inPath[0] == L'=')
+    inPath.Delete(0);
+  const AString inPathAnsi = GetAnsiString(inPath);
+
+  CRecordVector<UInt64> threads, dicts;
+  if (options.GcxBenchThreads.IsEmpty())
+  {
+    const UInt32 numCpus = NSystem::GetNumberOfProcessors();
+    for (UInt32 t = 1; t < numCpus; t <<= 1)
+      threads.Add(t);
+    threads.Add(numCpus);
+  }
+  else if (!Gcx_ParseList(options.GcxBenchThreads, threads))
+    throw CArcCmdLineException("Invalid -gcx_bench_mt list:", options.GcxBenchThreads);
+  if (options.GcxBenchDicts.IsEmpty())
+  {
+    dicts.Add((UInt64)1 << 20);
+    dicts.Add((UInt64)16 << 20);
+    dicts.Add((UInt64)64 << 20);
+  }
+  else if (!Gcx_ParseList(options.GcxBenchDicts, dicts))
+    throw CArcCmdLineException("Invalid -gcx_bench_md list:", options.GcxBenchDicts);
+
+  FILE *in = fopen(inPathAnsi.Ptr(), "rb");
+  if (!in)
+    throw CArcCmdLineException("Cannot open -gcx_bench input:", inPath);
+  fseek(in, 0, SEEK_END);
+  const size_t inSize = (size_t)ftell(in);
+  fseek(in, 0, SEEK_SET);
+  CByteBuffer inBuf(inSize);
+  if (fread(inBuf, 1, inSize, in) != inSize)
+  {
+    fclose(in);
+    throw CArcCmdLineException("Cannot read -gcx_bench input:", inPath);
+  }
+  fclose(in);
+
+  // LZMA2 adds 3 bytes per 64 KiB chunk to incompressible data
+  const size_t packCapacity = inSize + inSize / 16 + (1 << 16);
+  CByteBuffer packBuf(packCapacity);
+  CByteBuffer unpackBuf(inSize);
+  // resident before the first configuration, like in the ones after it
+  memset(packBuf, 0, packCapacity);
+  memset(unpackBuf, 0, inSize);
+
+  const char *label = inPathAnsi.Ptr();
+  {
+    const char *slash = strrchr(label, '/');
+    if (slash)
+      label = slash + 1;
+  }
+
+  FILE *report = NULL;
+  if (!options.GcxReportPath.IsEmpty())
+  {
+    UString reportPath = options.GcxReportPath;
+    if (reportPath[0] == L'=')
+      reportPath.Delete(0);
+    const AString reportPathAnsi = GetAnsiString(reportPath);
+    report = fopen(reportPathAnsi.Ptr(), "a");
+    if (!report)
+    {
+      printf("Error opening file %s\n", reportPathAnsi.Ptr());
+      exit(1);
+    }
+  }
+
+  printf("\n%s: %u bytes\n", label, (unsigned)inSize);
+  printf("%4s %8s | %9s %9s %10s | %9s %9s %10s | %10s\n",
+      "mt", "dict", "c_wall", "c_cpu", "c_peak", "d_wall", "d_cpu", "d_peak", "packed");
+
+  FOR_VECTOR (di, dicts)
+  FOR_VECTOR (ti, threads)
+  {
+    const UInt32 dictSize = (UInt32)dicts[di];
+    const unsigned numThreads = (unsigned)threads[ti];
+    CGcxProbe comp, decomp;
+    UInt64 compPeak, decompPeak;
+    size_t packSize = packCapacity;
+    Byte prop = 0;
+    SRes res;
+
+    {
+      CLzma2EncProps props;
+      Lzma2EncProps_Init(&props);
+      props.lzmaProps.dictSize = dictSize;
+      props.numTotalThreads = (int)numThreads;
+
+      Gcx_Start(comp);
+      CLzma2EncHandle enc = Lzma2Enc_Create(&g_AlignedAlloc, &g_BigAlloc);
+      if (!enc)
+        throw CSystemException(E_OUTOFMEMORY);
+      res = Lzma2Enc_SetProps(enc, &props);
+      if (res == SZ_OK)
+      {
+        Lzma2Enc_SetDataSize(enc, inSize);
+        prop = Lzma2Enc_WriteProperties(enc);
+        res = Lzma2Enc_Encode2(enc, NULL, packBuf, &packSize, NULL, inBuf, inSize, NULL);
+      }
+      Lzma2Enc_Destroy(enc);
+      Gcx_Stop(comp);
+      compPeak = Gcx_PeakRssAbove(comp);
+      if (res != SZ_OK)
+        throw CSystemException(res == SZ_ERROR_MEM ? E_OUTOFMEMORY : E_FAIL);
+    }
+
+    {
+      CLzma2DecMtProps props;
+      Lzma2DecMtProps_Init(&props);
+      #ifndef Z7_ST
+      props.numThreads = numThreads;
+      #endif
+      CGcxMemInStream inStream;
+      inStream.vt.Read = GcxMemInStream_Read;
+      inStream.Buf = packBuf;
+      inStream.Size = packSize;
+      inStream.Pos = 0;
+      CGcxMemOutStream outStream;
+      outStream.vt.Write = GcxMemOutStream_Write;
+      outStream.Buf = unpackBuf;
+      outStream.Size = inSize;
+      outStream.Pos = 0;
+      const UInt64 outSize = inSize;
+      UInt64 inProcessed = 0;
+      int isMT = 0;
+
+      Gcx_Start(decomp);
+      CLzma2DecMtHandle dec = Lzma2DecMt_Create(&g_AlignedAlloc, &g_MidAlloc);
+      if (!dec)
+        throw CSystemException(E_OUTOFMEMORY);
+      res = Lzma2DecMt_Decode(dec, prop, &props, &outStream.vt, &outSize, 1,
+          &inStream.vt, &inProcessed, &isMT, NULL);
+      Lzma2DecMt_Destroy(dec);
+      Gcx_Stop(decomp);
+      decompPeak = Gcx_PeakRssAbove(decomp);
+      if (res != SZ_OK || outStream.Pos != inSize || memcmp(unpackBuf, inBuf, inSize) != 0)
+        throw CSystemException(res == SZ_ERROR_MEM ? E_OUTOFMEMORY : E_FAIL);
+    }
+
+    printf("%4u %7um | %9.4f %9.4f %9.1fM | %9.4f %9.4f %9.1fM | %10u\n",
+        numThreads, (unsigned)(dictSize >> 20),
+        comp.Wall_us / 1e6, comp.Cpu_us / 1e6, compPeak / 1048576.0,
+        decomp.Wall_us / 1e6, decomp.Cpu_us / 1e6, decompPeak / 1048576.0,
+        (unsigned)packSize);
+    if (report)
+      fprintf(report, "%s|%u|%u|%5.4lf|%5.4lf|%llu|%5.4lf|%5.4lf|%llu|%llu|%llu\n",
+          label, numThreads, dictSize,
+          comp.Wall_us / 1e6, comp.Cpu_us / 1e6, (unsigned long long)compPeak,
+          decomp.Wall_us / 1e6, decomp.Cpu_us / 1e6, (unsigned long long)decompPeak,
+          (unsigned long long)packSize, (unsigned long long)inSize);
+  }
+
+  if (report)
+    fclose(report);
+  return 0;
+}
+
+#endif // ! _WIN32
+
 
 
 
@@ -915,6 +1291,14 @@ int Main2(
 
   parser.Parse2(options);
 
+  #ifndef _WIN32
+  if (!options.GcxBenchPath.IsEmpty()) //to gcx
+    return GcxBench(options);
+  #endif
+  if (!options.GcxChunkSize.IsEmpty() || options.GcxUnchunk
+      || !options.GcxExtractQuery.IsEmpty()) //to gcx
+    return GcxChunked(options);
+
   {
     int cp = options.ConsoleCodePage;
     
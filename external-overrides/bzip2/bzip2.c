@@ -33,7 +33,9 @@
 #include "bzlib.h"
 
 //to gcx
-#include <time.h>  
+#include <pthread.h>
+#define GCX_PROBE_NO_MALLOC_COUNT
+#include "../malloc_count/gcx_probe.h"
 
 #define ERROR_IF_EOF(i)       { if ((i) == EOF)  ioError(); }
 #define ERROR_IF_NOT_ZERO(i)  { if ((i) != 0)    ioError(); }
@@ -528,6 +530,797 @@ Bool uncompressStream ( FILE *zStream, FILE *stream )
 }
 
 
+/*---------------------------------------------------*/
+/*--- Multi-threaded block mode (--threads=N)     ---*/
+/*---------------------------------------------------*/
+
+/*--
+   bzip2 blocks are independent: each one carries its own
+   BWT, Huffman tables and CRC, and the stream CRC is just a
+   fold of the block CRCs.  So the compressor cuts the input
+   exactly where the serial library would (the initial
+   run-length coding is simulated for that), compresses every
+   piece as a one-block stream in a worker, and an ordered
+   writer splices the block bits into a single stream, which
+   is bit-identical to the serial output.  The decompressor
+   finds the block magic numbers, rebuilds a one-block stream
+   per block, decodes them in workers and writes them in order.
+--*/
+
+#define BZ_BLOCK_MAGIC  0x314159265359ULL
+#define BZ_EOS_MAGIC    0x177245385090ULL
+#define BZ_MAGIC_MASK   0xffffffffffffULL
+
+#define SLOT_EMPTY  0
+#define SLOT_FILLED 1
+#define SLOT_BUSY   2
+#define SLOT_DONE   3
+
+Int32   numThreads;
+Bool    indexBlocks;
+
+typedef unsigned long long BitPos;
+
+/*--
+   Block index (<file>.bz2.idx), written by --index: the magic
+   below, then one (bit offset, uncompressed offset) pair of
+   BitPos per block, the bit offset being that of the block
+   magic number in the .bz2 file, and a final pair for the
+   end-of-stream marker and the uncompressed size.
+--*/
+#define BZ_INDEX_MAGIC  "BZ2INDEX"
+
+
+/*---------------------------------------------*/
+/*--
+   Bit writer, MSB first like the library's bsW().
+   Full bytes go to a memory buffer, which is spilled
+   to f when f is not NULL.
+--*/
+typedef
+   struct {
+      UChar*  buf;
+      Int32   nBuf;
+      Int32   bufCap;
+      UChar   cur;
+      Int32   live;
+      FILE*   f;
+      BitPos  nBytes;     /* bytes produced so far */
+   }
+   BitWriter;
+
+
+static
+void bwInit ( BitWriter* bw, Int32 cap, FILE* f )
+{
+   bw->buf    = myMalloc ( cap );
+   bw->nBuf   = 0;
+   bw->bufCap = cap;
+   bw->cur    = 0;
+   bw->live   = 0;
+   bw->f      = f;
+   bw->nBytes = 0;
+}
+
+
+static
+void bwSpill ( BitWriter* bw )
+{
+   if (bw->f == NULL) {
+      bw->bufCap *= 2;
+      bw->buf = realloc ( bw->buf, bw->bufCap );
+      if (bw->buf == NULL) outOfMemory ();
+      return;
+   }
+   if (fwrite ( bw->buf, sizeof(UChar), bw->nBuf, bw->f ) != (size_t)bw->nBuf)
+      ioError ();
+   bw->nBuf = 0;
+}
+
+
+static
+void bwByte ( BitWriter* bw, UChar b )
+{
+   if (bw->nBuf == bw->bufCap) bwSpill ( bw );
+   bw->nBytes++;
+   if (bw->live == 0) {
+      bw->buf[bw->nBuf++] = b;
+   } else {
+      bw->buf[bw->nBuf++] = bw->cur | (b >> bw->live);
+      bw->cur = (UChar)(b << (8 - bw->live));
+   }
+}
+
+
+static
+void bwBits ( BitWriter* bw, Int32 n, BitPos v )
+{
+   while (n > 0) {
+      n--;
+      bw->cur |= (UChar)(((v >> n) & 1) << (7 - bw->live));
+      bw->live++;
+      if (bw->live == 8) {
+         UChar b = bw->cur;
+         bw->cur = 0;
+         bw->live = 0;
+         bwByte ( bw, b );
+      }
+   }
+}
+
+
+static
+BitPos getBits ( const UChar* src, BitPos pos, Int32 n )
+{
+   BitPos v = 0;
+   for (; n > 0; n--, pos++)
+      v = (v << 1) | ((src[pos >> 3] >> (7 - (pos & 7))) & 1);
+   return v;
+}
+
+
+/*-- appends src bits [start, start+n) --*/
+static
+void bwCopy ( BitWriter* bw, const UChar* src, BitPos start, BitPos n )
+{
+   const UChar* p = src + (start >> 3);
+   Int32        sh = start & 7;
+   BitPos       nBytes = n / 8;
+   for (; nBytes > 0; nBytes--, p++) {
+      if (sh == 0)
+         bwByte ( bw, *p );
+      else
+         bwByte ( bw, (UChar)((p[0] << sh) | (p[1] >> (8 - sh))) );
+   }
+   bwBits ( bw, n & 7, getBits ( src, start + (n & ~7ULL), n & 7 ) );
+}
+
+
+/*-- writes pending bits with zero padding --*/
+static
+void bwFinish ( BitWriter* bw )
+{
+   if (bw->live > 0) bwBits ( bw, 8 - bw->live, 0 );
+   if (bw->f != NULL) bwSpill ( bw );
+}
+
+
+/*---------------------------------------------*/
+typedef
+   struct {
+      UChar*  in;
+      Int32   nIn;
+      Int32   inCap;
+      char*   out;
+      UInt32  nOut;
+      Int32   err;
+      Int32   state;
+   }
+   ZSlot;
+
+typedef
+   struct {
+      FILE*            stream;
+      ZSlot*           slots;
+      Int32            nSlots;
+      BitPos           nextFill;
+      BitPos           nextWork;
+      Bool             readerDone;
+      Bool             readError;
+      pthread_mutex_t  lock;
+      pthread_cond_t   changed;
+   }
+   ZPipe;
+
+
+/*--
+   Fills the slots with the raw bytes of consecutive blocks.
+   Mirrors ADD_CHAR_TO_BLOCK of the library: nblock counts the
+   RLE1 bytes flushed so far, the run (ch, len) is pending, and
+   a block is closed when nblock reaches nblockMAX before the
+   next character is added, the pending run moving on to the
+   following block.
+--*/
+static
+void* zReader ( void* arg )
+{
+   ZPipe*  zp = (ZPipe*)arg;
+   UChar   ibuf[5000];
+   Int32   nIbuf = 0, iIbuf = 0;
+   Int32   nblockMAX = 100000 * blockSize100k - 19;
+   Int32   nblock, ch = 256, len = 0, runStart = 0;
+   UChar   carry[256];
+   Int32   nCarry = 0;
+   Bool    eof = False;
+   ZSlot*  s;
+
+   while (True) {
+      pthread_mutex_lock ( &zp->lock );
+      s = &zp->slots[zp->nextFill % zp->nSlots];
+      while (s->state != SLOT_EMPTY)
+         pthread_cond_wait ( &zp->changed, &zp->lock );
+      pthread_mutex_unlock ( &zp->lock );
+
+      memcpy ( s->in, carry, nCarry );
+      s->nIn = nCarry;
+      runStart = 0;
+      nblock = 0;
+      while (True) {
+         UChar c;
+         if (nblock >= nblockMAX) break;
+         if (iIbuf == nIbuf) {
+            if (eof || myfeof(zp->stream)) { eof = True; break; }
+            nIbuf = fread ( ibuf, sizeof(UChar), 5000, zp->stream );
+            iIbuf = 0;
+            if (ferror(zp->stream)) { zp->readError = True; eof = True; break; }
+            if (nIbuf == 0) continue;
+         }
+         c = ibuf[iIbuf++];
+         if (s->nIn == s->inCap) {
+            s->inCap *= 2;
+            s->in = realloc ( s->in, s->inCap );
+            if (s->in == NULL) outOfMemory ();
+         }
+         if (c != ch && len == 1) {
+            nblock++;
+            ch = c;
+            runStart = s->nIn;
+         } else if (c != ch || len == 255) {
+            if (ch < 256) nblock += (len < 4) ? len : 5;
+            ch = c;
+            len = 1;
+            runStart = s->nIn;
+         } else {
+            len++;
+         }
+         s->in[s->nIn++] = c;
+      }
+
+      /*-- a full block (also at EOF) leaves its pending run to the next --*/
+      if (nblock >= nblockMAX && len > 0) {
+         nCarry = s->nIn - runStart;
+         memcpy ( carry, s->in + runStart, nCarry );
+         s->nIn = runStart;
+      } else {
+         nCarry = 0;
+      }
+
+      pthread_mutex_lock ( &zp->lock );
+      if (s->nIn > 0) {
+         s->state = SLOT_FILLED;
+         zp->nextFill++;
+      }
+      if (eof && nCarry == 0) zp->readerDone = True;
+      pthread_cond_broadcast ( &zp->changed );
+      pthread_mutex_unlock ( &zp->lock );
+      if (eof && nCarry == 0) break;
+   }
+   return NULL;
+}
+
+
+static
+void* zWorker ( void* arg )
+{
+   ZPipe*  zp = (ZPipe*)arg;
+   ZSlot*  s;
+   UInt32  need;
+
+   while (True) {
+      pthread_mutex_lock ( &zp->lock );
+      while (zp->nextWork == zp->nextFill && !zp->readerDone)
+         pthread_cond_wait ( &zp->changed, &zp->lock );
+      if (zp->nextWork == zp->nextFill) {
+         pthread_mutex_unlock ( &zp->lock );
+         break;
+      }
+      s = &zp->slots[zp->nextWork % zp->nSlots];
+      s->state = SLOT_BUSY;
+      zp->nextWork++;
+      pthread_mutex_unlock ( &zp->lock );
+
+      /*-- the size bound given in the libbzip2 manual --*/
+      need = s->nIn + s->nIn / 100 + 600;
+      if (need > s->nOut) {
+         free ( s->out );
+         s->out = myMalloc ( need );
+      }
+      s->nOut = need;
+      s->err = BZ2_bzBuffToBuffCompress ( s->out, &s->nOut,
+                                          (char*)s->in, s->nIn,
+                                          blockSize100k, 0, workFactor );
+
+      pthread_mutex_lock ( &zp->lock );
+      s->state = SLOT_DONE;
+      pthread_cond_broadcast ( &zp->changed );
+      pthread_mutex_unlock ( &zp->lock );
+   }
+   return NULL;
+}
+
+
+/*--
+   Bit position of the end-of-stream marker of a one-block
+   stream: the stream ends with the 48-bit marker, the 32-bit
+   CRC and up to 7 zero padding bits.
+--*/
+static
+BitPos findEos ( const UChar* z, UInt32 nz, UInt32 blockCRC )
+{
+   BitPos total = (BitPos)nz * 8;
+   Int32  pad;
+   for (pad = 0; pad < 8; pad++) {
+      BitPos e = total - pad - 80;
+      if (getBits ( z, e, 48 ) == BZ_EOS_MAGIC
+          && getBits ( z, e + 48, 32 ) == blockCRC
+          && getBits ( z, e + 80, pad ) == 0)
+         return e;
+   }
+   panic ( "compress:end of block not found" );
+   return 0; /*notreached*/
+}
+
+
+static
+void compressStreamParallel ( FILE *stream, FILE *zStream, FILE *idxStream )
+{
+   ZPipe      zp;
+   BitWriter  bw;
+   pthread_t  reader;
+   pthread_t* workers;
+   BitPos     nextWrite = 0;
+   BitPos     nbytes_in = 0, nbytes_out;
+   BitPos     bitsOut = 32;
+   UInt32     combinedCRC = 0;
+   Int32      i, ret;
+
+   SET_BINARY_MODE(stream);
+   SET_BINARY_MODE(zStream);
+
+   if (ferror(stream)) ioError();
+   if (ferror(zStream)) ioError();
+
+   zp.stream     = stream;
+   zp.nSlots     = numThreads + 2;
+   zp.nextFill   = 0;
+   zp.nextWork   = 0;
+   zp.readerDone = False;
+   zp.readError  = False;
+   zp.slots      = myMalloc ( zp.nSlots * sizeof(ZSlot) );
+   for (i = 0; i < zp.nSlots; i++) {
+      zp.slots[i].inCap = 100000 * blockSize100k;
+      zp.slots[i].in    = myMalloc ( zp.slots[i].inCap );
+      zp.slots[i].out   = NULL;
+      zp.slots[i].nOut  = 0;
+      zp.slots[i].state = SLOT_EMPTY;
+   }
+   pthread_mutex_init ( &zp.lock, NULL );
+   pthread_cond_init ( &zp.changed, NULL );
+
+   if (verbosity >= 2) fprintf ( stderr, "\n    %d threads\n", numThreads );
+
+   if (idxStream != NULL
+       && fwrite ( BZ_INDEX_MAGIC, sizeof(Char), 8, idxStream ) != 8)
+      ioError();
+
+   bwInit ( &bw, 1 << 20, zStream );
+   bwBits ( &bw, 8, 'B' );
+   bwBits ( &bw, 8, 'Z' );
+   bwBits ( &bw, 8, 'h' );
+   bwBits ( &bw, 8, '0' + blockSize100k );
+
+   workers = myMalloc ( numThreads * sizeof(pthread_t) );
+   pthread_create ( &reader, NULL, zReader, &zp );
+   for (i = 0; i < numThreads; i++)
+      pthread_create ( &workers[i], NULL, zWorker, &zp );
+
+   /*-- ordered writer --*/
+   while (True) {
+      ZSlot*  s;
+      UInt32  blockCRC;
+      BitPos  eos;
+
+      pthread_mutex_lock ( &zp.lock );
+      s = &zp.slots[nextWrite % zp.nSlots];
+      while (!(nextWrite < zp.nextFill && s->state == SLOT_DONE)
+             && !(zp.readerDone && nextWrite == zp.nextFill))
+         pthread_cond_wait ( &zp.changed, &zp.lock );
+      if (nextWrite == zp.nextFill) {
+         pthread_mutex_unlock ( &zp.lock );
+         break;
+      }
+      pthread_mutex_unlock ( &zp.lock );
+
+      switch (s->err) {
+         case BZ_OK: break;
+         case BZ_CONFIG_ERROR: configError(); break;
+         case BZ_MEM_ERROR: outOfMemory(); break;
+         default: panic ( "compress:unexpected error" );
+      }
+
+      /*-- "BZh?", then the block from its magic number up to the EOS marker --*/
+      blockCRC = (UInt32)getBits ( (UChar*)s->out, 32 + 48, 32 );
+      eos = findEos ( (UChar*)s->out, s->nOut, blockCRC );
+      if (idxStream != NULL) {
+         BitPos entry[2] = { bitsOut, nbytes_in };
+         if (fwrite ( entry, sizeof(BitPos), 2, idxStream ) != 2) ioError();
+      }
+      bwCopy ( &bw, (UChar*)s->out, 32, eos - 32 );
+      bitsOut += eos - 32;
+      combinedCRC = (combinedCRC << 1) | (combinedCRC >> 31);
+      combinedCRC ^= blockCRC;
+      nbytes_in += s->nIn;
+
+      if (verbosity >= 2)
+         fprintf ( stderr, "    block %llu: crc = 0x%08x, "
+                   "%d bytes in, %llu bits out\n",
+                   nextWrite + 1, blockCRC, s->nIn, eos - 32 );
+
+      pthread_mutex_lock ( &zp.lock );
+      s->state = SLOT_EMPTY;
+      nextWrite++;
+      pthread_cond_broadcast ( &zp.changed );
+      pthread_mutex_unlock ( &zp.lock );
+   }
+
+   pthread_join ( reader, NULL );
+   for (i = 0; i < numThreads; i++)
+      pthread_join ( workers[i], NULL );
+   if (zp.readError) ioError();
+
+   if (idxStream != NULL) {
+      BitPos entry[2] = { bitsOut, nbytes_in };
+      if (fwrite ( entry, sizeof(BitPos), 2, idxStream ) != 2) ioError();
+      if (fclose ( idxStream ) == EOF) ioError();
+   }
+
+   bwBits ( &bw, 48, BZ_EOS_MAGIC );
+   bwBits ( &bw, 32, combinedCRC );
+   bwFinish ( &bw );
+   nbytes_out = bw.nBytes;
+
+   for (i = 0; i < zp.nSlots; i++) {
+      free ( zp.slots[i].in );
+      free ( zp.slots[i].out );
+   }
+   free ( zp.slots );
+   free ( workers );
+   free ( bw.buf );
+   pthread_mutex_destroy ( &zp.lock );
+   pthread_cond_destroy ( &zp.changed );
+
+   if (ferror(zStream)) ioError();
+   ret = fflush ( zStream );
+   if (ret == EOF) ioError();
+   if (zStream != stdout) {
+      Int32 fd = fileno ( zStream );
+      if (fd < 0) ioError();
+      applySavedFileAttrToOutputFile ( fd );
+      ret = fclose ( zStream );
+      outputHandleJustInCase = NULL;
+      if (ret == EOF) ioError();
+   }
+   outputHandleJustInCase = NULL;
+   if (ferror(stream)) ioError();
+   ret = fclose ( stream );
+   if (ret == EOF) ioError();
+
+   if (verbosity >= 1) {
+      if (nbytes_in == 0) {
+	 fprintf ( stderr, " no data compressed.\n");
+      } else {
+	 fprintf ( stderr, "%6.3f:1, %6.3f bits/byte, "
+		   "%5.2f%% saved, %llu in, %llu out.\n",
+		   (double)nbytes_in / (double)nbytes_out,
+		   (8.0 * nbytes_out) / nbytes_in,
+		   100.0 * (1.0 - (double)nbytes_out / (double)nbytes_in),
+		   nbytes_in,
+		   nbytes_out
+		 );
+      }
+   }
+}
+
+
+/*---------------------------------------------*/
+typedef
+   struct {
+      BitPos  start;      /* bit position of the block magic */
+      BitPos  end;        /* bit position of the next magic */
+      Int32   level;      /* blockSize100k of its stream */
+      char*   out;
+      UInt32  nOut;
+      Int32   err;
+      Bool    done;
+   }
+   UnzBlock;
+
+typedef
+   struct {
+      const UChar*     z;
+      UnzBlock*        blocks;
+      Int32            nBlocks;
+      Int32            nextWork;
+      Int32            nextWrite;
+      Int32            window;
+      pthread_mutex_t  lock;
+      pthread_cond_t   changed;
+   }
+   UnzPipe;
+
+
+/*--
+   Locates every block of every stream in z[0, nz).  Returns
+   False when the data is anything but a clean sequence of
+   streams whose block CRCs fold into the stream CRC (a magic
+   number inside the Huffman data, trailing garbage, truncation,
+   not bzip2 at all); the serial path then deals with it.
+--*/
+static
+Bool scanBlocks ( const UChar* z, BitPos nz, UnzBlock** blocksOut, Int32* nOut )
+{
+   UnzBlock*  blocks = NULL;
+   Int32      nBlocks = 0, cap = 0;
+   BitPos     pos = 0;
+
+   if (nz < 4) return False;
+   while (pos + 4 <= nz) {
+      BitPos  bit, from, total = nz * 8, w = 0;
+      Int32   level, firstBlock = nBlocks;
+      UInt32  combinedCRC = 0;
+      Bool    eosFound = False;
+
+      if (z[pos] != 'B' || z[pos+1] != 'Z' || z[pos+2] != 'h'
+          || z[pos+3] < '1' || z[pos+3] > '9') break;
+      level = z[pos+3] - '0';
+      from = (pos + 4) * 8;
+      for (bit = from; bit < total; bit++) {
+         BitPos at = bit - 47;
+         w = ((w << 1) | ((z[bit >> 3] >> (7 - (bit & 7))) & 1)) & BZ_MAGIC_MASK;
+         if (bit < from + 47) continue;
+         if (w != BZ_BLOCK_MAGIC && w != BZ_EOS_MAGIC) continue;
+         if (nBlocks == firstBlock && at != (pos + 4) * 8) goto fail;
+         if (nBlocks > firstBlock) blocks[nBlocks-1].end = at;
+         if (at + 80 > total) goto fail;
+         if (w == BZ_EOS_MAGIC) {
+            if ((UInt32)getBits ( z, at + 48, 32 ) != combinedCRC) goto fail;
+            pos = (at + 80 + 7) / 8;
+            eosFound = True;
+            break;
+         }
+         if (nBlocks == cap) {
+            cap = (cap == 0) ? 64 : 2 * cap;
+            blocks = realloc ( blocks, cap * sizeof(UnzBlock) );
+            if (blocks == NULL) outOfMemory ();
+         }
+         blocks[nBlocks].start = at;
+         blocks[nBlocks].level = level;
+         blocks[nBlocks].out   = NULL;
+         blocks[nBlocks].done  = False;
+         combinedCRC = (combinedCRC << 1) | (combinedCRC >> 31);
+         combinedCRC ^= (UInt32)getBits ( z, at + 48, 32 );
+         nBlocks++;
+         /*-- resume after the magic and the CRC --*/
+         from = at + 80;
+         bit = from - 1;
+         w = 0;
+      }
+      if (!eosFound) goto fail;
+   }
+   if (pos != nz) goto fail;
+
+   *blocksOut = blocks;
+   *nOut = nBlocks;
+   return True;
+
+   fail:
+   free ( blocks );
+   return False;
+}
+
+
+/*-- decodes one block as a stand-alone one-block stream --*/
+static
+void decodeBlock ( const UChar* z, UnzBlock* b )
+{
+   BitWriter  bw;
+   bz_stream  strm;
+   UInt32     cap;
+   Int32      ret;
+
+   bwInit ( &bw, (Int32)((b->end - b->start) / 8) + 16, NULL );
+   bwBits ( &bw, 8, 'B' );
+   bwBits ( &bw, 8, 'Z' );
+   bwBits ( &bw, 8, 'h' );
+   bwBits ( &bw, 8, '0' + b->level );
+   bwCopy ( &bw, z, b->start, b->end - b->start );
+   bwBits ( &bw, 48, BZ_EOS_MAGIC );
+   bwBits ( &bw, 32, getBits ( z, b->start + 48, 32 ) );
+   bwFinish ( &bw );
+
+   strm.bzalloc = NULL;
+   strm.bzfree  = NULL;
+   strm.opaque  = NULL;
+   ret = BZ2_bzDecompressInit ( &strm, 0, (int)smallMode );
+   if (ret != BZ_OK) { b->err = ret; free ( bw.buf ); return; }
+
+   cap = 100000 * b->level + 4096;
+   b->out = myMalloc ( cap );
+   strm.next_in   = (char*)bw.buf;
+   strm.avail_in  = bw.nBuf;
+   strm.next_out  = b->out;
+   strm.avail_out = cap;
+   while (True) {
+      ret = BZ2_bzDecompress ( &strm );
+      if (ret != BZ_OK) break;
+      if (strm.avail_out == 0) {
+         b->out = realloc ( b->out, 2 * cap );
+         if (b->out == NULL) outOfMemory ();
+         strm.next_out  = b->out + cap;
+         strm.avail_out = cap;
+         cap *= 2;
+      } else if (strm.avail_in == 0) {
+         ret = BZ_UNEXPECTED_EOF;
+         break;
+      }
+   }
+   b->nOut = cap - strm.avail_out;
+   b->err  = (ret == BZ_STREAM_END) ? BZ_OK : ret;
+   BZ2_bzDecompressEnd ( &strm );
+   free ( bw.buf );
+}
+
+
+static
+void* unzWorker ( void* arg )
+{
+   UnzPipe*  up = (UnzPipe*)arg;
+   Int32     i;
+
+   while (True) {
+      pthread_mutex_lock ( &up->lock );
+      while (up->nextWork < up->nBlocks
+             && up->nextWork >= up->nextWrite + up->window)
+         pthread_cond_wait ( &up->changed, &up->lock );
+      if (up->nextWork == up->nBlocks) {
+         pthread_mutex_unlock ( &up->lock );
+         break;
+      }
+      i = up->nextWork++;
+      pthread_mutex_unlock ( &up->lock );
+
+      decodeBlock ( up->z, &up->blocks[i] );
+
+      pthread_mutex_lock ( &up->lock );
+      up->blocks[i].done = True;
+      pthread_cond_broadcast ( &up->changed );
+      pthread_mutex_unlock ( &up->lock );
+   }
+   return NULL;
+}
+
+
+static
+UChar* readAll ( FILE *f, BitPos *n )
+{
+   BitPos  cap = 1 << 20;
+   UChar*  z = myMalloc ( cap );
+
+   *n = 0;
+   while (!myfeof(f)) {
+      if (*n == cap) {
+         cap *= 2;
+         z = realloc ( z, cap );
+         if (z == NULL) outOfMemory ();
+      }
+      *n += fread ( z + *n, sizeof(UChar), cap - *n, f );
+      if (ferror(f)) ioError();
+   }
+   return z;
+}
+
+
+static
+Bool uncompressStreamParallel ( FILE *zStream, FILE *stream )
+{
+   UChar*      z;
+   BitPos      nz;
+   UnzPipe     up;
+   pthread_t*  workers;
+   Int32       i, ret;
+
+   SET_BINARY_MODE(stream);
+   SET_BINARY_MODE(zStream);
+
+   if (ferror(stream)) ioError();
+   if (ferror(zStream)) ioError();
+
+   z = readAll ( zStream, &nz );
+
+   if (!scanBlocks ( z, nz, &up.blocks, &up.nBlocks )) {
+      /*-- let the serial decoder handle (or report) it --*/
+      if (verbosity >= 2)
+         fprintf ( stderr, "\n    no clean block layout, decoding serially" );
+      if (fseek ( zStream, 0, SEEK_SET ) != 0) {
+         FILE* tmp = tmpfile ();
+         if (tmp == NULL) ioError();
+         if (fwrite ( z, sizeof(UChar), nz, tmp ) != nz) ioError();
+         rewind ( tmp );
+         if (zStream != stdin) fclose ( zStream );
+         zStream = tmp;
+      }
+      free ( z );
+      return uncompressStream ( zStream, stream );
+   }
+
+   if (verbosity >= 2)
+      fprintf ( stderr, "\n    %d blocks, %d threads\n", up.nBlocks, numThreads );
+
+   up.z         = z;
+   up.nextWork  = 0;
+   up.nextWrite = 0;
+   up.window    = 2 * numThreads;
+   pthread_mutex_init ( &up.lock, NULL );
+   pthread_cond_init ( &up.changed, NULL );
+   workers = myMalloc ( numThreads * sizeof(pthread_t) );
+   for (i = 0; i < numThreads; i++)
+      pthread_create ( &workers[i], NULL, unzWorker, &up );
+
+   /*-- ordered writer --*/
+   for (; up.nextWrite < up.nBlocks; ) {
+      UnzBlock* b = &up.blocks[up.nextWrite];
+      pthread_mutex_lock ( &up.lock );
+      while (!b->done)
+         pthread_cond_wait ( &up.changed, &up.lock );
+      pthread_mutex_unlock ( &up.lock );
+
+      switch (b->err) {
+         case BZ_OK: break;
+         case BZ_CONFIG_ERROR: configError(); break;
+         case BZ_MEM_ERROR: outOfMemory(); break;
+         default: crcError();
+      }
+      if (fwrite ( b->out, sizeof(UChar), b->nOut, stream ) != b->nOut)
+         ioError();
+      free ( b->out );
+      b->out = NULL;
+
+      pthread_mutex_lock ( &up.lock );
+      up.nextWrite++;
+      pthread_cond_broadcast ( &up.changed );
+      pthread_mutex_unlock ( &up.lock );
+   }
+
+   for (i = 0; i < numThreads; i++)
+      pthread_join ( workers[i], NULL );
+   free ( workers );
+   free ( up.blocks );
+   free ( z );
+   pthread_mutex_destroy ( &up.lock );
+   pthread_cond_destroy ( &up.changed );
+
+   if (stream != stdout) {
+      Int32 fd = fileno ( stream );
+      if (fd < 0) ioError();
+      applySavedFileAttrToOutputFile ( fd );
+   }
+   ret = fclose ( zStream );
+   if (ret == EOF) ioError();
+
+   if (ferror(stream)) ioError();
+   ret = fflush ( stream );
+   if (ret != 0) ioError();
+   if (stream != stdout) {
+      ret = fclose ( stream );
+      outputHandleJustInCase = NULL;
+      if (ret == EOF) ioError();
+   }
+   outputHandleJustInCase = NULL;
+   if (verbosity >= 2) fprintf ( stderr, "\n    " );
+   return True;
+}
+
+
 /*---------------------------------------------*/
 static 
 Bool testStream ( FILE *zStream )
@@ -1111,11 +1904,12 @@ Bool mapSuffix ( Char* name,
 static 
 void compress ( Char *name, char *file_report_gcx)
 {
-   double duration =0.0; //gcx
-   clock_t clock_time; //gcx
+   gcx_probe probe; //gcx
 
    FILE  *inStr;
    FILE  *outStr;
+   FILE  *idxStr;
+   Char  idxName[FILE_NAME_LEN + 4];
    Int32 n, i;
    struct MY_STAT statBuf;
 
@@ -1271,23 +2065,43 @@ void compress ( Char *name, char *file_report_gcx)
       fflush ( stderr );
    }
 
+   idxStr = NULL;
+   if (indexBlocks) {
+      if (srcMode != SM_F2F) {
+         fprintf ( stderr, "%s: --index needs an output file, "
+                   "no index written.\n", progName );
+      } else {
+         copyFileName ( idxName, outName );
+         strcat ( idxName, ".idx" );
+         idxStr = fopen ( idxName, "wb" );
+         if (idxStr == NULL) {
+            fprintf ( stderr, "%s: Can't create index file %s: %s.\n",
+                      progName, idxName, strerror(errno) );
+            setExit(1);
+         }
+      }
+   }
+
    /*--- Now the input and output handles are sane.  Do the Biz. ---*/
    outputHandleJustInCase = outStr;
    deleteOutputOnInterrupt = True;
    
-   clock_time = clock(); //mede o tempo, relatório gcx
-   compressStream ( inStr, outStr );
+   gcx_probe_start ( &probe ); //mede o tempo, relatório gcx
+   /*-- the block pipeline also knows where every block lands, so
+        --index takes it even with one thread; without --index, one
+        thread is the stock compressStream --*/
+   if (numThreads > 1 || idxStr != NULL)
+      compressStreamParallel ( inStr, outStr, idxStr );
+   else
+      compressStream ( inStr, outStr );
    //gcx
-   clock_time = clock() - clock_time;
-   duration = ((double)clock_time)/CLOCKS_PER_SEC;
-   FILE *report_gcx = fopen(file_report_gcx, "a");
-   if(report_gcx == NULL){
+   gcx_probe_stop ( &probe );
+   if (!gcx_probe_report ( file_report_gcx, &probe )) {
       printf("Error opening file %s\n",file_report_gcx);
       exit(1);
    }
-   fprintf(report_gcx, "0|0|%5.4lf|",duration);
-   printf("Time inserted into the DCX report: %5.4lf\n", duration);
-   fclose(report_gcx);
+   gcx_probe_record ( &probe, "bzip2", "compression" );
+   printf("threads: %d\n", numThreads);
    //fim do relatório gcx
 
    outputHandleJustInCase = NULL;
@@ -1310,8 +2124,7 @@ void compress ( Char *name, char *file_report_gcx)
 static 
 void uncompress ( Char *name, char *file_report_gcx)
 {
-   double duration =0.0; //gcx
-   clock_t clock_time; //gcx
+   gcx_probe probe; //gcx
 
    FILE  *inStr;
    FILE  *outStr;
@@ -1466,12 +2279,15 @@ void uncompress ( Char *name, char *file_report_gcx)
       fflush ( stderr );
    }
 
-   clock_time = clock(); //mede o tempo, relatório gcx
+   gcx_probe_start ( &probe ); //mede o tempo, relatório gcx
 
    /*--- Now the input and output handles are sane.  Do the Biz. ---*/
    outputHandleJustInCase = outStr;
    deleteOutputOnInterrupt = True;
-   magicNumberOK = uncompressStream ( inStr, outStr );
+   if (numThreads > 1)
+      magicNumberOK = uncompressStreamParallel ( inStr, outStr );
+   else
+      magicNumberOK = uncompressStream ( inStr, outStr );
    outputHandleJustInCase = NULL;
 
    /*--- If there was an I/O error, we won't get here. ---*/
@@ -1508,21 +2324,193 @@ void uncompress ( Char *name, char *file_report_gcx)
 
 
    //gcx
-   clock_time = clock() - clock_time;
-   duration = ((double)clock_time)/CLOCKS_PER_SEC;
-   FILE *report_gcx = fopen(file_report_gcx, "a");
-   if(report_gcx == NULL){
+   gcx_probe_stop ( &probe );
+   if (!gcx_probe_report ( file_report_gcx, &probe )) {
       printf("Error opening file %s\n",file_report_gcx);
       exit(1);
    }
-   fprintf(report_gcx, "0|0|%5.4lf|",duration);
-   printf("Time inserted into the DCX report: %5.4lf\n", duration);
-   fclose(report_gcx);
+   gcx_probe_record ( &probe, "bzip2", "decompression" );
+   printf("threads: %d\n", numThreads);
    //fim do relatório gcx
 
 }
 
 
+/*---------------------------------------------*/
+/*--
+   Substring extraction (-e <query file>) on a .bz2 file
+   compressed with --index.  Every query is an inclusive
+   "l r" interval of the uncompressed text; only the blocks
+   covering it are decoded, and the last BZ_EXTRACT_CACHE
+   decoded blocks are kept around.
+--*/
+#define BZ_EXTRACT_CACHE 8
+
+typedef
+   struct {
+      Int32     block;
+      BitPos    lastUse;
+      UnzBlock  b;
+   }
+   CachedBlock;
+
+
+static
+CachedBlock* cachedBlock ( CachedBlock* cache, Int32 block, BitPos tick,
+                           const UChar* z, Int32 level,
+                           const BitPos* index, BitPos* nDecoded )
+{
+   Int32 i, victim = 0;
+
+   for (i = 0; i < BZ_EXTRACT_CACHE; i++) {
+      if (cache[i].block == block) {
+         cache[i].lastUse = tick;
+         return &cache[i];
+      }
+      if (cache[i].lastUse < cache[victim].lastUse) victim = i;
+   }
+
+   free ( cache[victim].b.out );
+   cache[victim].block   = block;
+   cache[victim].lastUse = tick;
+   cache[victim].b.start = index[2 * block];
+   cache[victim].b.end   = index[2 * block + 2];
+   cache[victim].b.level = level;
+   cache[victim].b.out   = NULL;
+   decodeBlock ( z, &cache[victim].b );
+   switch (cache[victim].b.err) {
+      case BZ_OK: break;
+      case BZ_CONFIG_ERROR: configError(); break;
+      case BZ_MEM_ERROR: outOfMemory(); break;
+      default: crcError();
+   }
+   if (cache[victim].b.nOut != index[2 * block + 3] - index[2 * block + 1])
+      panic ( "extract:index does not match the compressed file" );
+   (*nDecoded)++;
+   return &cache[victim];
+}
+
+
+static
+void extract ( Char *name, Char *queryName, Char *outputName,
+               char *file_report_gcx )
+{
+   gcx_probe    probe;
+   FILE         *zStr, *idxStr, *queryStr, *outStr = NULL;
+   Char         idxName[FILE_NAME_LEN + 4];
+   Char         magic[8];
+   UChar        *z;
+   BitPos       nz, *index, nIndex, total;
+   BitPos       l, r, tick = 0, nQueries = 0, nDecoded = 0;
+   Int32        nBlocks, level, i;
+   CachedBlock  cache[BZ_EXTRACT_CACHE];
+
+   copyFileName ( inName, name );
+   copyFileName ( idxName, name );
+   strcat ( idxName, ".idx" );
+
+   zStr = fopen ( name, "rb" );
+   idxStr = fopen ( idxName, "rb" );
+   queryStr = fopen ( queryName, "r" );
+   if (zStr == NULL || idxStr == NULL || queryStr == NULL) {
+      fprintf ( stderr, "%s: Can't open %s: %s.\n", progName,
+                zStr == NULL ? name : idxStr == NULL ? idxName : queryName,
+                strerror(errno) );
+      setExit(1);
+      exit(exitValue);
+   }
+   if (outputName != NULL) {
+      outStr = fopen ( outputName, "wb" );
+      if (outStr == NULL) {
+         fprintf ( stderr, "%s: Can't create output file %s: %s.\n",
+                   progName, outputName, strerror(errno) );
+         setExit(1);
+         exit(exitValue);
+      }
+   }
+
+   z = readAll ( zStr, &nz );
+   fclose ( zStr );
+   if (nz < 4 || z[0] != 'B' || z[1] != 'Z' || z[2] != 'h'
+       || z[3] < '1' || z[3] > '9') {
+      fprintf ( stderr, "%s: %s is not a bzip2 file.\n", progName, name );
+      setExit(2);
+      exit(exitValue);
+   }
+   level = z[3] - '0';
+
+   if (fread ( magic, sizeof(Char), 8, idxStr ) != 8
+       || memcmp ( magic, BZ_INDEX_MAGIC, 8 ) != 0) {
+      fprintf ( stderr, "%s: %s is not a bzip2 block index.\n",
+                progName, idxName );
+      setExit(2);
+      exit(exitValue);
+   }
+   index = (BitPos*)readAll ( idxStr, &nIndex );
+   fclose ( idxStr );
+   nIndex /= sizeof(BitPos);
+   if (nIndex < 2 || nIndex % 2 != 0)
+      panic ( "extract:truncated block index" );
+   nBlocks = (Int32)(nIndex / 2 - 1);
+   total = index[nIndex - 1];
+
+   for (i = 0; i < BZ_EXTRACT_CACHE; i++) {
+      cache[i].block   = -1;
+      cache[i].lastUse = 0;
+      cache[i].b.out   = NULL;
+   }
+
+   gcx_probe_start ( &probe ); //mede o tempo, relatório gcx
+   while (fscanf ( queryStr, "%llu %llu", &l, &r ) == 2) {
+      Int32 lo = 0, hi = nBlocks - 1;
+      if (l > r || r >= total) {
+         fprintf ( stderr, "%s: query [%llu,%llu] out of range "
+                   "(text length %llu).\n", progName, l, r, total );
+         setExit(1);
+         exit(exitValue);
+      }
+      /*-- last block starting at or before l --*/
+      while (lo < hi) {
+         Int32 mid = lo + (hi - lo + 1) / 2;
+         if (index[2 * mid + 1] <= l) lo = mid; else hi = mid - 1;
+      }
+      if (outStr != NULL) fprintf ( outStr, "[%llu,%llu]\n", l, r );
+      tick++;
+      for (i = lo; l <= r; i++) {
+         CachedBlock* c = cachedBlock ( cache, i, tick, z, level,
+                                        index, &nDecoded );
+         BitPos from = l - index[2 * i + 1];
+         BitPos to = (r < index[2 * i + 3] ? r + 1 : index[2 * i + 3])
+                     - index[2 * i + 1];
+         if (outStr != NULL
+             && fwrite ( c->b.out + from, sizeof(UChar), to - from, outStr )
+                != to - from)
+            ioError();
+         l = index[2 * i + 1] + to;
+      }
+      if (outStr != NULL) fputc ( '\n', outStr );
+      nQueries++;
+   }
+   gcx_probe_stop ( &probe );
+
+   if (outStr != NULL && fclose ( outStr ) == EOF) ioError();
+   fclose ( queryStr );
+   for (i = 0; i < BZ_EXTRACT_CACHE; i++) free ( cache[i].b.out );
+   free ( index );
+   free ( z );
+
+   printf ( "queries: %llu, blocks: %d, blocks decoded: %llu\n",
+            nQueries, nBlocks, nDecoded );
+   //gcx
+   if (!gcx_probe_report ( file_report_gcx, &probe )) {
+      printf("Error opening file %s\n",file_report_gcx);
+      exit(1);
+   }
+   gcx_probe_record ( &probe, "bzip2", "extraction" );
+   //fim do relatório gcx
+}
+
+
 /*---------------------------------------------*/
 static 
 void testf ( Char *name )
@@ -1662,6 +2650,11 @@ void usage ( Char *fullProgName )
       "   -1 .. -9            set block size to 100k .. 900k\n"
       "   --fast              alias for -1\n"
       "   --best              alias for -9\n"
+      "   --threads=N         compress/decompress blocks on N threads\n"
+      "   --index             also write a block index to <file>.bz2.idx\n"
+      "   -e <query file>     extract the \"l r\" intervals of the query\n"
+      "                       file from an indexed .bz2 file\n"
+      "   --extract_output=F  write the extracted substrings to F\n"
       "\n"
       "   If invoked as `bzip2', default action is to compress.\n"
       "              as `bunzip2',  default action is to decompress.\n"
@@ -1816,6 +2809,8 @@ IntNative main ( IntNative argc, Char *argv[] )
    numFileNames            = 0;
    numFilesProcessed       = 0;
    workFactor              = 30;
+   numThreads              = 1;
+   indexBlocks             = False;
    deleteOutputOnInterrupt = False;
    exitValue               = 0;
    i = j = 0; /* avoid bogus warning from egcs-1.1.X */
@@ -1853,6 +2848,37 @@ IntNative main ( IntNative argc, Char *argv[] )
       if (strncmp(aa->name, "--gcx_report=", 13) == 0) {
          report_gcx = aa->name + 13;
       }
+      if (strncmp(aa->name, "--threads=", 10) == 0) {
+         numThreads = atoi ( aa->name + 10 );
+         if (numThreads < 1) numThreads = 1;
+      }
+   }
+
+   /*-- extract mode: -e <query file> [--extract_output=F] file.bz2 --*/
+   for (aa = argList; aa != NULL; aa = aa->link) {
+      if (ISFLAG("-e")) {
+         Char *queryName = NULL, *outputName = NULL, *target = NULL;
+         Cell *bb;
+         if (aa->link == NULL) {
+            fprintf ( stderr, "%s: -e needs a query file\n", progName );
+            usage ( progName );
+            exit ( 1 );
+         }
+         queryName = aa->link->name;
+         for (bb = argList; bb != NULL; bb = bb->link) {
+            if (strncmp(bb->name, "--extract_output=", 17) == 0)
+               outputName = bb->name + 17;
+            else if (bb->name[0] != '-' && bb != aa->link && target == NULL)
+               target = bb->name;
+         }
+         if (target == NULL) {
+            fprintf ( stderr, "%s: -e needs an indexed .bz2 file\n", progName );
+            usage ( progName );
+            exit ( 1 );
+         }
+         extract ( target, queryName, outputName, report_gcx );
+         exit ( exitValue );
+      }
    }
 
    /*-- Find the length of the longest filename --*/
@@ -1952,6 +2978,8 @@ IntNative main ( IntNative argc, Char *argv[] )
       if (ISFLAG("--best"))              blockSize100k = 9;          else
       if (ISFLAG("--verbose"))           verbosity++;                else
       if (strncmp(aa->name, "--gcx_report=", 13) == 0) continue; //GCX
+      if (strncmp(aa->name, "--threads=", 10) == 0) continue;
+      if (ISFLAG("--index"))             { indexBlocks = True; continue; }
       if (ISFLAG("--help"))              { usage ( progName ); exit ( 0 ); }
          else
          if (strncmp ( aa->name, "--", 2) == 0) {
@@ -33,9 +33,7 @@ Chile. Blanco Encalada 2120, Santiago, Chile. gnavarro@dcc.uchile.cl
 #include "basics.h"
 
 // To gcx 
-#include "../../../malloc_count/malloc_count.h"
-#include "../../../malloc_count/stack_count.h"
-#include <time.h>
+#include "../../../malloc_count/gcx_probe.h"
 
 int u; // |text| and later current |C| with gaps
 
@@ -131,10 +129,8 @@ int main (int argc, char **argv)
 	}
 
   // To GCX
-	clock_t start, end;
-	double cpu_time_used;
-	void* base = stack_count_clear();
-	start = clock();
+	gcx_probe probe;
+	gcx_probe_start(&probe);
 
      u = 0; f = Tf; ff = argv[1];
      for (;len>0;len--)
@@ -151,19 +147,13 @@ int main (int argc, char **argv)
 	}
 
   	// To gcx
-	long long int peak = malloc_count_peak();
-	long long  int stack = stack_count_usage(base);
-	end = clock();
-	cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+	gcx_probe_stop(&probe);
 	char *gcx_report_filename = argv[2];
-	FILE *report_gcx = fopen(gcx_report_filename, "a");
-	if(report_gcx == NULL) {
+	if(!gcx_probe_report(gcx_report_filename, &probe)) {
 		printf("Ocorreu um erro ao abrir o arquivo de relatório!");
 		exit(1);
 	}
-	fprintf(report_gcx, "%lld|%lld|%5.6lf|", peak, stack, cpu_time_used);
-	printf("Time inserted into the GCX report: %5.4lf\n", cpu_time_used);
-	fclose(report_gcx);
+	gcx_probe_record(&probe, "despair-navarro", "decompression");
 
      fprintf (stderr,"DesPair succeeded\n\n");
      fprintf (stderr,"   Original chars: %i\n",u);
@@ -42,9 +42,7 @@ int PRNL = 0;  // print progress on text scan
 #include "heap.h"
 
 // To gcx 
-#include "../../../malloc_count/malloc_count.h"
-#include "../../../malloc_count/stack_count.h"
-#include <time.h>
+#include "../../../malloc_count/gcx_probe.h"
 
 
 float factor = 0.75; // 1/extra space overhead; set closer to 1 for smaller and
@@ -291,6 +289,17 @@ if (PRNC) prnC();
      return 0;
    }
 
+	// To gcx: frees what prepare() and repair() leave behind, so that
+	// gcis-bench can run repair several times in one process
+void repair_release (void)
+
+  { destroyHeap (&Heap);
+    destroyHash (&Hash);
+    destroyRecords (&Rec);
+    free (L);
+    free (C);
+  }
+
 int main (int argc, char **argv)
 
    { char fname[1024];
@@ -322,10 +331,8 @@ int main (int argc, char **argv)
      fclose(Tf);
 
 	// To GCX
-	clock_t start, end;
-	double cpu_time_used;
-	void* base = stack_count_clear();
-	start = clock();
+	gcx_probe probe;
+	gcx_probe_start(&probe);
 
      prepare (text,len);
      strcpy(fname,argv[1]);
@@ -364,19 +371,13 @@ int main (int argc, char **argv)
 	}
 
 	// To gcx
-	long long int peak = malloc_count_peak();
-	long long  int stack = stack_count_usage(base);
-	end = clock();
-	cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+	gcx_probe_stop(&probe);
 	char *gcx_report_filename = argv[2];
-	FILE *report_gcx = fopen(gcx_report_filename, "a");
-	if(report_gcx == NULL) {
+	if(!gcx_probe_report(gcx_report_filename, &probe)) {
 		printf("Ocorreu um erro ao abrir o arquivo de relatório! %s\n", gcx_report_filename);
 		exit(1);
 	}
-	fprintf(report_gcx, "%lld|%lld|%5.6lf|", peak, stack, cpu_time_used);
-	printf("Time inserted into the GCX report: %5.4lf\n", cpu_time_used);
-	fclose(report_gcx);
+	gcx_probe_record(&probe, "repair-navarro", "compression");
 		
      fprintf (stderr,"RePair succeeded\n\n");
      fprintf (stderr,"   Original chars: %i\n",len);
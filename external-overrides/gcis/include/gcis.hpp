@@ -4,6 +4,9 @@
 #include "gcis_eliasfano_codec.hpp"
 #include "gcis_s8b_codec.hpp"
 #include "gcis_unary_codec.hpp"
+#include "memory_timeline.hpp"
+#include "microbench.hpp"
+#include "perf_counters.hpp"
 #include "sdsl/bit_vectors.hpp"
 #include "sdsl/int_vector.hpp"
 #include "util.hpp"
@@ -62,6 +65,9 @@ void stack_push(t_pair *STACK, int_t *top, uint_t idx, int_t lcp) {
 }
 /**/
 
+// microbenchmark of the protected and private kernels (src/gcis-kernels.cpp)
+class gcis_kernels;
+
 class gcis_interface {
   public:
     virtual void encode(char *s, int_t n) = 0;
@@ -75,6 +81,8 @@ class gcis_interface {
 };
 
 template <class codec_t> class gcis_abstract : public gcis_interface {
+    friend class ::gcis_kernels;
+
   public:
     std::vector<codec_t> g;
     sdsl::int_vector<> reduced_string;
@@ -104,6 +112,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
 
     void encode(char *s, int_t n) {
         uint_t *SA = new uint_t[n];
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("encode SA");
+#endif
         int_t K = 256;
         int cs = sizeof(char);
         int level = 0;
@@ -259,6 +270,16 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
         mm.event("GC-IS Level " + to_string(level));
 #endif
 
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is", level);
+#endif
+
+#ifdef PERF_COUNTERS
+        // only the work of this level: the induce phases and the next level
+        // pause it while they run
+        gcis::perf::phase perf_level("gc_is", level);
+#endif
+
 #ifdef REPORT
         uint_t total_lcp = 0;
         uint_t total_rule_suffix_length = 0;
@@ -270,6 +291,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
 
         unsigned char *t =
             new unsigned char[n / 8 + 1]; // LS-type array in bits
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is t", level);
+#endif
         // stage 1: reduce the problem by at least 1/2
 
         // Classify the type of each character
@@ -282,6 +306,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
                         : 0);
 
         int_t *bkt = new int_t[K]; // bucket counters
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is bkt", level);
+#endif
 
         size_t first = n - 1;
 
@@ -531,6 +558,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
     void induceSAs(unsigned char *t, uint_t *SA, int_t *s, int_t *bkt, int_t n,
                    int_t K, int cs, int level) {
         int_t i, j;
+#ifdef PERF_COUNTERS
+        gcis::perf::phase perf_induce("induceSAs", level);
+#endif
         get_buckets(s, bkt, n, K, cs, true); // find ends of buckets
         for (i = n - 1; i >= 0; i--) {
             if (SA[i] != EMPTY) {
@@ -547,6 +577,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
     void induceSAl(unsigned char *t, uint_t *SA, int_t *s, int_t *bkt, int_t n,
                    int_t K, int cs, int level) {
         int_t i, j;
+#ifdef PERF_COUNTERS
+        gcis::perf::phase perf_induce("induceSAl", level);
+#endif
         // find heads of buckets
         get_buckets(s, bkt, n, K, cs, false);
 
@@ -609,6 +642,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
     void induceSAs(uint_t *SA, int_t *s, int_t *cnt, int_t *bkt, int_t n,
                    int_t K, int cs, int level) {
         int_t i, j;
+#ifdef PERF_COUNTERS
+        gcis::perf::phase perf_induce("induceSAs", level);
+#endif
         get_buckets(cnt, bkt, K, true);
         for (i = n - 1; i >= 0; i--) {
             if (SA[i] != EMPTY) {
@@ -763,6 +799,9 @@ template <class codec_t> class gcis_abstract : public gcis_interface {
     void induceSAl(uint_t *SA, int_t *s, int_t *cnt, int_t *bkt, int_t n,
                    int_t K, int cs, int level) {
         int_t i, j;
+#ifdef PERF_COUNTERS
+        gcis::perf::phase perf_induce("induceSAl", level);
+#endif
         // find heads of buckets
         get_buckets(cnt, bkt, K, false);
         SA[bkt[chr(n - 1)]++] = n - 1;
@@ -17,6 +17,7 @@ using timer = std::chrono::high_resolution_clock;
 template <>
 class gcis_dictionary<gcis_eliasfano_codec>
     : public gcis_abstract<gcis_eliasfano_codec> {
+    friend class ::gcis_kernels;
 
   public:
     void serialize(std::ostream &o) override {
@@ -52,13 +53,23 @@ class gcis_dictionary<gcis_eliasfano_codec>
         //                   : (query_length);
         sdsl::int_vector<> extracted_text(size);
         sdsl::int_vector<> tmp_text(size);
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("extract_batch buffers");
+#endif
         auto first = std::chrono::high_resolution_clock::now();
         auto total_time = std::chrono::high_resolution_clock::now();
         for (auto p : query) {
             // cout << "Extracting"
             //      << "[" << p.first << "," << p.second << "]" << endl;
             auto t0 = std::chrono::high_resolution_clock::now();
+#ifdef PERF_COUNTERS
+            // the printing of the substring is left out
+            gcis::perf::phase perf_extract("extract_batch");
+#endif
             extract(p.first, p.second, extracted_text, tmp_text);
+#ifdef PERF_COUNTERS
+            perf_extract.stop();
+#endif
             auto t1 = std::chrono::high_resolution_clock::now();
             total_time += t1 - t0;
             for (uint64_t i = p.first; i <= p.second; i++) {
@@ -95,10 +106,19 @@ class gcis_dictionary<gcis_eliasfano_codec>
         char *str;
         if (g.size()) {
             for (int64_t i = g.size() - 1; i >= 0; i--) {
+#ifdef PERF_COUNTERS
+                gcis::perf::phase perf_decode("decode", i);
+#endif
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode", i);
+#endif
                 vector<uint_t> next_r_string;
                 gcis_eliasfano_pointers_codec_level gd =
                     std::move(g[i].decompress());
                 next_r_string.resize(g[i].string_size);
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode next_r_string", i);
+#endif
                 uint_t l = 0;
                 if (i == 0) {
                     // Convert the reduced string in the original text
@@ -139,6 +159,9 @@ class gcis_dictionary<gcis_eliasfano_codec>
         unsigned char *str;
         uint_t n = g[0].string_size;
         uint_t *SA = new uint_t[n];
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("decode_saca SA");
+#endif
 
         int_t *s = (int_t *)SA + n / 2;
 
@@ -146,6 +169,12 @@ class gcis_dictionary<gcis_eliasfano_codec>
         if (g.size()) {
 
             for (int64_t level = g.size() - 1; level >= 0; level--) {
+#ifdef PERF_COUNTERS
+                gcis::perf::phase perf_decode("decode_saca", level);
+#endif
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode_saca", level);
+#endif
 #if TIME
                 auto start = timer::now();
 #endif
@@ -185,12 +214,18 @@ class gcis_dictionary<gcis_eliasfano_codec>
                 gcis_eliasfano_pointers_codec_level gd =
                     std::move(g[level].decompress());
                 next_r_string.resize(g[level].string_size);
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode_saca next_r_string", level);
+#endif
                 uint_t l = 0;
 
                 int_t K = g[level].alphabet_size; // alphabet
 
                 int_t *bkt = new int_t[K]; // bucket
                 int_t *cnt = new int_t[K]; // counters
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode_saca bkt", level);
+#endif
 
                 init_buckets(cnt, K);
 
@@ -394,6 +429,9 @@ class gcis_dictionary<gcis_eliasfano_codec>
         uint_t n = g[0].string_size;
         uint_t *SA = new uint_t[n];
         int_t *LCP = new int_t[n];
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("decode_saca_lcp SA");
+#endif
 
         uint_t i;
         for (i = 0; i < n; i++)
@@ -405,6 +443,12 @@ class gcis_dictionary<gcis_eliasfano_codec>
         if (g.size()) {
 
             for (int64_t level = g.size() - 1; level >= 0; level--) {
+#ifdef PERF_COUNTERS
+                gcis::perf::phase perf_decode("decode_saca_lcp", level);
+#endif
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode_saca_lcp", level);
+#endif
 #if TIME
                 auto start = timer::now();
 #endif
@@ -444,12 +488,18 @@ class gcis_dictionary<gcis_eliasfano_codec>
                 gcis_eliasfano_pointers_codec_level gd =
                     std::move(g[level].decompress());
                 next_r_string.resize(g[level].string_size);
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode_saca_lcp next_r_string", level);
+#endif
                 uint_t l = 0;
 
                 int_t K = g[level].alphabet_size; // alphabet
 
                 int_t *bkt = new int_t[K]; // bucket
                 int_t *cnt = new int_t[K]; // counters
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode_saca_lcp bkt", level);
+#endif
 
                 init_buckets(cnt, K);
 
@@ -701,6 +751,15 @@ class gcis_dictionary<gcis_eliasfano_codec>
         mm.event("GC-IS Level " + to_string(level));
 #endif
 
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is", level);
+#endif
+
+#ifdef PERF_COUNTERS
+        // lms_naming, the induce phases and the next level pause it
+        gcis::perf::phase perf_level("gc_is", level);
+#endif
+
 #ifdef REPORT
         uint_t total_lcp = 0;
         uint_t total_rule_suffix_length = 0;
@@ -712,6 +771,9 @@ class gcis_dictionary<gcis_eliasfano_codec>
 
         unsigned char *t =
             new unsigned char[n / 8 + 1]; // LS-type array in bits
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is t", level);
+#endif
         // stage 1: reduce the problem by at least 1/2
 
         // Classify the type of each character
@@ -724,6 +786,9 @@ class gcis_dictionary<gcis_eliasfano_codec>
                         : 0);
 
         int_t *bkt = new int_t[K]; // bucket counters
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is bkt", level);
+#endif
 
         size_t first = n - 1;
 
@@ -768,6 +833,13 @@ class gcis_dictionary<gcis_eliasfano_codec>
             SA[i] = EMPTY;
         }
 
+#ifdef PERF_COUNTERS
+        gcis::perf::phase perf_naming("lms_naming", level);
+#endif
+#ifdef MICROBENCH
+        gcis::microbench::stopwatch bench_naming(
+            gcis::microbench::lms_naming(), level);
+#endif
         // find the lexicographic names of all LMS-substrings by comparing the
         // consecutive ones
         int_t name = -1;
@@ -881,6 +953,12 @@ class gcis_dictionary<gcis_eliasfano_codec>
             pos = (pos % 2 == 0) ? pos / 2 : (pos - 1) / 2;
             SA[n1 + pos] = name;
         }
+#ifdef PERF_COUNTERS
+        perf_naming.stop();
+#endif
+#ifdef MICROBENCH
+        bench_naming.stop();
+#endif
 
         sdsl::util::bit_compress(g[level].rule);
         g[level].lcp.encode(lcp);
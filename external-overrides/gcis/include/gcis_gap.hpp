@@ -13,6 +13,7 @@ void print_text(sdsl::int_vector<> &v, size_t size) {
 }
 template <>
 class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
+    friend class ::gcis_kernels;
 
   public:
   private:
@@ -73,13 +74,23 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
         //                   : (query_length);
         sdsl::int_vector<> extracted_text(size);
         sdsl::int_vector<> tmp_text(size);
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("extract_batch buffers");
+#endif
         auto first = std::chrono::high_resolution_clock::now();
         auto total_time = std::chrono::high_resolution_clock::now();
         for (auto p : query) {
             cout << "Extracting"
                  << "[" << p.first << "," << p.second << "]" << endl;
             auto t0 = std::chrono::high_resolution_clock::now();
+#ifdef PERF_COUNTERS
+            // the printing of the substring is left out
+            gcis::perf::phase perf_extract("extract_batch");
+#endif
             extract(p.first, p.second, extracted_text, tmp_text);
+#ifdef PERF_COUNTERS
+            perf_extract.stop();
+#endif
             auto t1 = std::chrono::high_resolution_clock::now();
             total_time += t1 - t0;
             for (uint64_t i = p.first; i <= p.second; i++) {
@@ -97,10 +108,19 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
         char *str;
         if (g.size()) {
             for (int64_t i = g.size() - 1; i >= 0; i--) {
+#ifdef PERF_COUNTERS
+                gcis::perf::phase perf_decode("decode", i);
+#endif
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode", i);
+#endif
                 sdsl::int_vector<> next_r_string;
                 gcis_gap_codec_level gd = std::move(g[i].decompress());
                 next_r_string.width(sdsl::bits::hi(g[i].alphabet_size - 1) + 1);
                 next_r_string.resize(g[i].string_size);
+#ifdef MEM_TIMELINE
+                gcis::timeline::event("decode next_r_string", i);
+#endif
                 uint64_t l = 0;
                 if (i == 0) {
                     // Convert the reduced string in the original text
@@ -397,6 +417,15 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
         mm.event("GC-IS Level " + to_string(level));
 #endif
 
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is", level);
+#endif
+
+#ifdef PERF_COUNTERS
+        // lms_naming, the induce phases and the next level pause it
+        gcis::perf::phase perf_level("gc_is", level);
+#endif
+
 #ifdef REPORT
         uint_t total_lcp = 0;
         uint_t total_rule_suffix_length = 0;
@@ -408,6 +437,9 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
 
         unsigned char *t =
             new unsigned char[n / 8 + 1]; // LS-type array in bits
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is t", level);
+#endif
         // stage 1: reduce the problem by at least 1/2
 
         // Classify the type of each character
@@ -420,6 +452,9 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
                         : 0);
 
         int_t *bkt = new int_t[K]; // bucket counters
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("gc_is bkt", level);
+#endif
 
         size_t first = n - 1;
 
@@ -464,6 +499,13 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
             SA[i] = EMPTY;
         }
 
+#ifdef PERF_COUNTERS
+        gcis::perf::phase perf_naming("lms_naming", level);
+#endif
+#ifdef MICROBENCH
+        gcis::microbench::stopwatch bench_naming(
+            gcis::microbench::lms_naming(), level);
+#endif
         // find the lexicographic names of all LMS-substrings by comparing the
         // consecutive ones
         int_t name = -1;
@@ -583,6 +625,12 @@ class gcis_dictionary<gcis_gap_codec> : public gcis_abstract<gcis_gap_codec> {
             pos = (pos % 2 == 0) ? pos / 2 : (pos - 1) / 2;
             SA[n1 + pos] = name;
         }
+#ifdef PERF_COUNTERS
+        perf_naming.stop();
+#endif
+#ifdef MICROBENCH
+        bench_naming.stop();
+#endif
 
         sdsl::util::bit_compress(g[level].rule);
         g[level].lcp =
@@ -0,0 +1,185 @@
+#ifndef GCIS_MEMORY_TIMELINE_HPP
+#define GCIS_MEMORY_TIMELINE_HPP
+
+// Heap timeline (to gcx): the current heap at every event (gc_is level, its
+// t and bkt buffers, the SA of encode, each decode level and its
+// next_r_string...) and the highest heap reached until the next event, plus
+// samples of the heap taken from malloc_count's callback at most once per
+// resolution. The heap only changes inside malloc/free, so sampling on them
+// loses nothing between two samples.
+// Only compiled in with MEM_TIMELINE. The rows are kept in a static buffer,
+// out of the heap being measured; when it fills up the samples are merged in
+// pairs and the resolution doubles. Not thread safe, like GCIS itself.
+// The callback reads clock_gettime on every malloc and free, so the times of
+// the timeline are those of an instrumented run: use them to place the
+// events, not to compare with the times of the gcis binary.
+
+#include "../external/malloc_count/malloc_count.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <time.h>
+
+namespace gcis {
+namespace timeline {
+
+enum row_kind { EVENT, SAMPLE };
+
+struct row {
+    double time;
+    row_kind kind;
+    const char *name; // string literal of the event, or of the last event
+    int level;
+    uint64_t current;
+    // events: highest heap until the next event
+    // samples: highest heap since the previous sample
+    uint64_t peak;
+};
+
+class recorder {
+    static constexpr uint64_t CAPACITY = 1 << 16;
+    static constexpr double DEFAULT_RESOLUTION = 0.001; // seconds
+
+    row rows[CAPACITY];
+    uint64_t n_rows = 0;
+    uint64_t dropped = 0;
+    double resolution = DEFAULT_RESOLUTION;
+    double start;
+    double last_sample;
+    uint64_t sample_peak = 0;
+    uint64_t open_event = CAPACITY; // index of the last event, if any
+    const char *phase_name = "start";
+    int phase_level = -1;
+    bool recording = true;
+
+    static double now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    }
+
+    static void on_change(void *cookie, size_t current) {
+        ((recorder *)cookie)->changed(current);
+    }
+
+    recorder() {
+        start = last_sample = now();
+        malloc_count_set_callback(on_change, this);
+    }
+
+    void changed(uint64_t current) {
+        if (!recording) {
+            return;
+        }
+        if (current > sample_peak) {
+            sample_peak = current;
+        }
+        if (open_event != CAPACITY && current > rows[open_event].peak) {
+            rows[open_event].peak = current;
+        }
+        double t = now();
+        if (t - last_sample >= resolution) {
+            last_sample = t;
+            push(t, SAMPLE, phase_name, phase_level, current, sample_peak);
+            sample_peak = current;
+        }
+    }
+
+    // merges consecutive samples in pairs, the events are kept
+    void compact() {
+        uint64_t out = 0;
+        for (uint64_t i = 0; i < n_rows; i++) {
+            if (rows[i].kind == SAMPLE && i + 1 < n_rows &&
+                rows[i + 1].kind == SAMPLE) {
+                if (rows[i].peak > rows[i + 1].peak) {
+                    rows[i + 1].peak = rows[i].peak;
+                }
+                i++;
+            }
+            if (i == open_event) {
+                open_event = out;
+            }
+            rows[out++] = rows[i];
+        }
+        n_rows = out;
+        resolution *= 2;
+    }
+
+    bool push(double t, row_kind kind, const char *name, int level,
+              uint64_t current, uint64_t peak) {
+        if (n_rows == CAPACITY) {
+            compact();
+        }
+        if (n_rows == CAPACITY) {
+            dropped++;
+            return false;
+        }
+        row &r = rows[n_rows++];
+        r.time = t - start;
+        r.kind = kind;
+        r.name = name;
+        r.level = level;
+        r.current = current;
+        r.peak = peak;
+        return true;
+    }
+
+  public:
+    recorder(const recorder &) = delete;
+    recorder &operator=(const recorder &) = delete;
+
+    ~recorder() { malloc_count_set_callback(NULL, NULL); }
+
+    static recorder &instance() {
+        static recorder r;
+        return r;
+    }
+
+    void event(const char *name, int level) {
+        uint64_t current = malloc_count_current();
+        phase_name = name;
+        phase_level = level;
+        open_event = push(now(), EVENT, name, level, current, current)
+                         ? n_rows - 1
+                         : CAPACITY;
+    }
+
+    // Appends one row per event and sample:
+    // label|time|kind|name|level|current|peak
+    // Returns false if the report can not be opened.
+    bool write_report(const char *file, const std::string &label) {
+        // the report itself is not part of the timeline
+        recording = false;
+        FILE *report = fopen(file, "a");
+        if (report == NULL) {
+            return false;
+        }
+        for (uint64_t i = 0; i < n_rows; i++) {
+            const row &r = rows[i];
+            fprintf(report, "%s|%.6lf|%s|%s|%d|%llu|%llu\n", label.c_str(),
+                    r.time, r.kind == EVENT ? "event" : "sample", r.name,
+                    r.level, (unsigned long long)r.current,
+                    (unsigned long long)r.peak);
+        }
+        fclose(report);
+        if (dropped) {
+            printf("Memory timeline full, %llu events were dropped\n",
+                   (unsigned long long)dropped);
+        }
+        return true;
+    }
+};
+
+// Starts the timeline on the first call.
+inline void event(const char *name, int level = -1) {
+    recorder::instance().event(name, level);
+}
+
+inline bool write_report(const char *file, const std::string &label) {
+    return recorder::instance().write_report(file, label);
+}
+
+} // namespace timeline
+} // namespace gcis
+
+#endif // GCIS_MEMORY_TIMELINE_HPP
@@ -0,0 +1,58 @@
+#ifndef GCIS_MICROBENCH_HPP
+#define GCIS_MICROBENCH_HPP
+
+// Timers of gcis-kernels (to gcx): the wall time of kernels that only run
+// inside gc_is, like the LMS naming, per level. A steady_clock read at each
+// end and nothing else, so the kernel is timed as the gcis binary runs it,
+// without the counters of PERF_COUNTERS.
+// Only compiled in with MICROBENCH.
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace gcis {
+namespace microbench {
+
+// ns of the LMS naming of every level, summed until cleared
+inline std::vector<uint64_t> &lms_naming() {
+    static std::vector<uint64_t> ns;
+    return ns;
+}
+
+// Adds the time from its construction until stop() or the end of the scope
+// to total[level].
+class stopwatch {
+    std::vector<uint64_t> &total;
+    int level;
+    std::chrono::steady_clock::time_point start;
+    bool running = true;
+
+  public:
+    stopwatch(std::vector<uint64_t> &total, int level)
+        : total(total), level(level),
+          start(std::chrono::steady_clock::now()) {}
+    stopwatch(const stopwatch &) = delete;
+    stopwatch &operator=(const stopwatch &) = delete;
+
+    void stop() {
+        if (running) {
+            std::chrono::steady_clock::duration elapsed =
+                std::chrono::steady_clock::now() - start;
+            if ((uint64_t)level >= total.size()) {
+                total.resize(level + 1);
+            }
+            total[level] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count();
+            running = false;
+        }
+    }
+
+    ~stopwatch() { stop(); }
+};
+
+} // namespace microbench
+} // namespace gcis
+
+#endif // GCIS_MICROBENCH_HPP
@@ -0,0 +1,288 @@
+#ifndef GCIS_PERF_COUNTERS_HPP
+#define GCIS_PERF_COUNTERS_HPP
+
+// Hardware counters (to gcx): cycles, instructions, LLC misses, dTLB misses
+// and branch misses of the calling thread, accumulated per phase of the codec
+// (gc_is level, induceSAl/induceSAs, LMS naming, decode level,
+// extract_batch), next to the wall time of the phase.
+// Phases are exclusive: a phase started while another one runs (induceSAl in
+// gc_is, the next gc_is level) pauses it until it stops, so every cycle and
+// nanosecond is counted in exactly one row and the rows of a run add up.
+// When the kernel multiplexes the group the counts are scaled by
+// time_enabled / time_running; a phase during which the group never ran on
+// the PMU has no count and is written as NA, not 0.
+// Only compiled in with PERF_COUNTERS; where perf_event_open is missing or
+// not allowed (perf_event_paranoid, containers, macOS) every counter reads
+// as unavailable and is written as NA.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gcis {
+namespace perf {
+
+enum counter_id {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    DTLB_MISSES,
+    BRANCH_MISSES,
+    N_COUNTERS
+};
+
+// Layout of a read() of one counter with PERF_FORMAT_TOTAL_TIME_ENABLED |
+// PERF_FORMAT_TOTAL_TIME_RUNNING.
+struct reading {
+    uint64_t value[N_COUNTERS] = {};
+    uint64_t enabled[N_COUNTERS] = {};
+    uint64_t running[N_COUNTERS] = {};
+};
+
+// Counts between readings, scaled when the group was multiplexed.
+struct counts {
+    uint64_t value[N_COUNTERS] = {};
+    uint64_t running[N_COUNTERS] = {}; // 0 if the group never ran
+
+    void add(const reading &begin, const reading &end) {
+        for (int i = 0; i < N_COUNTERS; i++) {
+            uint64_t enabled = end.enabled[i] - begin.enabled[i];
+            uint64_t ran = end.running[i] - begin.running[i];
+            uint64_t delta = end.value[i] - begin.value[i];
+            if (ran == 0) {
+                continue;
+            }
+            if (ran < enabled) {
+                delta = (uint64_t)((double)delta * enabled / ran);
+            }
+            value[i] += delta;
+            running[i] += ran;
+        }
+    }
+
+    void add(const counts &c) {
+        for (int i = 0; i < N_COUNTERS; i++) {
+            value[i] += c.value[i];
+            running[i] += c.running[i];
+        }
+    }
+};
+
+// One group of counters, opened once per process and kept running.
+class counters {
+    int fd[N_COUNTERS];
+
+    counters() {
+        for (int i = 0; i < N_COUNTERS; i++) {
+            fd[i] = -1;
+        }
+#ifdef __linux__
+        const uint64_t cache_read_miss =
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const std::pair<uint32_t, uint64_t> events[N_COUNTERS] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache_read_miss},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cache_read_miss},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+        int leader = -1;
+        for (int i = 0; i < N_COUNTERS; i++) {
+            struct perf_event_attr attr = {};
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = leader == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd[i] != -1 && leader == -1) {
+                leader = fd[i];
+            }
+        }
+        if (leader != -1) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+  public:
+    counters(const counters &) = delete;
+    counters &operator=(const counters &) = delete;
+
+    ~counters() {
+#ifdef __linux__
+        for (int i = N_COUNTERS - 1; i >= 0; i--) {
+            if (fd[i] != -1) {
+                close(fd[i]);
+            }
+        }
+#endif
+    }
+
+    static counters &instance() {
+        static counters c;
+        return c;
+    }
+
+    bool available(int i) const { return fd[i] != -1; }
+
+    // A counter that can not be read has running 0 and is not counted.
+    reading read() const {
+        reading r;
+#ifdef __linux__
+        for (int i = 0; i < N_COUNTERS; i++) {
+            uint64_t buffer[3];
+            if (fd[i] != -1 &&
+                ::read(fd[i], buffer, sizeof(buffer)) == sizeof(buffer)) {
+                r.value[i] = buffer[0];
+                r.enabled[i] = buffer[1];
+                r.running[i] = buffer[2];
+            }
+        }
+#endif
+        return r;
+    }
+};
+
+struct phase_total {
+    std::string name;
+    int level;
+    uint64_t calls = 0;
+    uint64_t ns = 0; // wall time
+    counts total;
+};
+
+// Totals of every phase, in the order they were first seen.
+inline std::vector<phase_total> &phases() {
+    static std::vector<phase_total> p;
+    return p;
+}
+
+inline void add(const std::string &name, int level, uint64_t ns,
+                const counts &c) {
+    std::vector<phase_total> &p = phases();
+    uint64_t i = 0;
+    while (i < p.size() && (p[i].level != level || p[i].name != name)) {
+        i++;
+    }
+    if (i == p.size()) {
+        p.push_back(phase_total());
+        p[i].name = name;
+        p[i].level = level;
+    }
+    p[i].calls++;
+    p[i].ns += ns;
+    p[i].total.add(c);
+}
+
+class phase;
+
+// The innermost running phase, paused by the next one started.
+inline phase *&current() {
+    static phase *p = NULL;
+    return p;
+}
+
+// Counts from its construction until stop() or the end of the scope, except
+// while a phase started after it runs. Phases must stop in reverse order.
+class phase {
+    typedef std::chrono::steady_clock clock;
+
+    const char *name;
+    int level;
+    phase *parent;
+    counts own;
+    clock::duration elapsed = clock::duration::zero();
+    reading begin;
+    clock::time_point start;
+    bool running = true;
+
+    void pause(const reading &now, clock::time_point t) {
+        own.add(begin, now);
+        elapsed += t - start;
+    }
+
+    void resume(const reading &now, clock::time_point t) {
+        begin = now;
+        start = t;
+    }
+
+  public:
+    phase(const char *name, int level = -1)
+        : name(name), level(level), parent(current()) {
+        // one reading ends the parent's segment and starts this one
+        reading now = counters::instance().read();
+        clock::time_point t = clock::now();
+        if (parent != NULL) {
+            parent->pause(now, t);
+        }
+        current() = this;
+        resume(now, t);
+    }
+    phase(const phase &) = delete;
+    phase &operator=(const phase &) = delete;
+
+    void stop() {
+        if (running) {
+            reading now = counters::instance().read();
+            clock::time_point t = clock::now();
+            pause(now, t);
+            add(name, level,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count(),
+                own);
+            running = false;
+            current() = parent;
+            if (parent != NULL) {
+                parent->resume(now, t);
+            }
+        }
+    }
+
+    ~phase() { stop(); }
+};
+
+// Appends one row per phase: label|phase|level|calls|time|<counters>
+// (exclusive time in seconds; NA for a counter that is not available or
+// never ran during the phase)
+// Returns false if the report can not be opened.
+inline bool write_report(const char *file, const std::string &label) {
+    FILE *report = fopen(file, "a");
+    if (report == NULL) {
+        return false;
+    }
+    const counters &c = counters::instance();
+    for (const phase_total &p : phases()) {
+        fprintf(report, "%s|%s|%d|%llu|%.6lf", label.c_str(), p.name.c_str(),
+                p.level, (unsigned long long)p.calls, (double)p.ns / 1e9);
+        for (int i = 0; i < N_COUNTERS; i++) {
+            if (c.available(i) && p.total.running[i] != 0) {
+                fprintf(report, "|%llu", (unsigned long long)p.total.value[i]);
+            } else {
+                fprintf(report, "|NA");
+            }
+        }
+        fprintf(report, "\n");
+    }
+    fclose(report);
+    return true;
+}
+
+} // namespace perf
+} // namespace gcis
+
+#endif // GCIS_PERF_COUNTERS_HPP
@@ -0,0 +1,230 @@
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Ground truth and check of the extract outputs.
+ *
+ * -g maps the plain text and writes one "l r hash" line per query of a
+ * query file, hash being the XXH64 of T[l,r]. -v reads an extract output
+ * (the "[l,r]\n<substring>\n" records of scripts/extract.py) as a stream,
+ * one record at a time, and compares each one with the next line of the
+ * hashes; it stops at the first record that differs and prints it.
+ *
+ * This replaces writing every substring with scripts/extract.py and
+ * comparing whole files with cmp.
+ */
+
+// XXH64, seed 0 (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md)
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v; // little endian
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t lane) {
+    acc += lane * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t v) {
+    acc ^= xxh64_round(0, v);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t xxh64(const void *data, uint64_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    uint64_t h;
+    if (len >= 32) {
+        uint64_t v1 = PRIME64_1 + PRIME64_2, v2 = PRIME64_2, v3 = 0,
+                 v4 = 0 - PRIME64_1;
+        const unsigned char *limit = end - 32;
+        do {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = PRIME64_5;
+    }
+    h += len;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+FILE *open_or_die(const char *path, const char *mode) {
+    FILE *f = strcmp(path, "-") == 0 ? (mode[0] == 'r' ? stdin : stdout)
+                                     : fopen(path, mode);
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    return f;
+}
+
+int generate(const char *plain, const char *query_path, const char *hash_path) {
+    int fd = open(plain, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot open %s\n", plain);
+        return EXIT_FAILURE;
+    }
+    const uint64_t text_len = st.st_size;
+    const char *text = text_len == 0 ? NULL
+                                     : (const char *)mmap(NULL, text_len, PROT_READ,
+                                                          MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s\n", plain);
+        return EXIT_FAILURE;
+    }
+    madvise((void *)text, text_len, MADV_RANDOM);
+
+    FILE *queries = open_or_die(query_path, "r");
+    FILE *hashes = open_or_die(hash_path, "w");
+    uint64_t l, r, n = 0;
+    while (fscanf(queries, "%" SCNu64 " %" SCNu64, &l, &r) == 2) {
+        if (l > r || r >= text_len) {
+            fprintf(stderr, "query %" PRIu64 " [%" PRIu64 ",%" PRIu64
+                            "] is out of %s\n",
+                    n, l, r, plain);
+            return EXIT_FAILURE;
+        }
+        fprintf(hashes, "%" PRIu64 " %" PRIu64 " %016" PRIx64 "\n", l, r,
+                xxh64(text + l, r - l + 1));
+        n++;
+    }
+    fclose(queries);
+    if (fclose(hashes) != 0) {
+        fprintf(stderr, "Cannot write %s\n", hash_path);
+        return EXIT_FAILURE;
+    }
+    munmap((void *)text, text_len);
+    close(fd);
+    return EXIT_SUCCESS;
+}
+
+int verify(const char *hash_path, const char *output_path) {
+    FILE *hashes = open_or_die(hash_path, "r");
+    FILE *output = open_or_die(output_path, "r");
+    static char buffer[1 << 20];
+    setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+
+    std::vector<char> substring;
+    uint64_t l, r, expected, n = 0;
+    while (fscanf(hashes, "%" SCNu64 " %" SCNu64 " %" SCNx64, &l, &r,
+                  &expected) == 3) {
+        uint64_t out_l, out_r;
+        int c;
+        if (fscanf(output, "[%" SCNu64 ",%" SCNu64 "]", &out_l, &out_r) != 2 ||
+            getc(output) != '\n') {
+            printf("query %" PRIu64 " [%" PRIu64 ",%" PRIu64
+                   "]: missing or malformed header\n",
+                   n, l, r);
+            return EXIT_FAILURE;
+        }
+        if (out_l != l || out_r != r) {
+            printf("query %" PRIu64 " [%" PRIu64 ",%" PRIu64
+                   "]: the output has [%" PRIu64 ",%" PRIu64 "]\n",
+                   n, l, r, out_l, out_r);
+            return EXIT_FAILURE;
+        }
+        const uint64_t len = r - l + 1;
+        if (substring.size() < len) {
+            substring.resize(len);
+        }
+        if (fread(substring.data(), 1, len, output) != len ||
+            (c = getc(output)) != '\n') {
+            printf("query %" PRIu64 " [%" PRIu64 ",%" PRIu64
+                   "]: the substring is truncated or longer than %" PRIu64
+                   " bytes\n",
+                   n, l, r, len);
+            return EXIT_FAILURE;
+        }
+        if (xxh64(substring.data(), len) != expected) {
+            printf("query %" PRIu64 " [%" PRIu64 ",%" PRIu64
+                   "]: the substring differs\n",
+                   n, l, r);
+            return EXIT_FAILURE;
+        }
+        n++;
+    }
+    if (getc(output) != EOF) {
+        printf("the output has more than the %" PRIu64 " expected queries\n",
+               n);
+        return EXIT_FAILURE;
+    }
+    fclose(hashes);
+    fclose(output);
+    return EXIT_SUCCESS;
+}
+
+void usage(char *prog) {
+    fprintf(stderr,
+            "Usage: \n"
+            "%s -g <plain> <query file> <hashes>\n"
+            "%s -v <hashes> <extract output>\n"
+            "(- is stdin/stdout); -v exits with 1 and prints the first "
+            "differing query\n",
+            prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 5 && strcmp(argv[1], "-g") == 0) {
+        return generate(argv[2], argv[3], argv[4]);
+    }
+    if (argc == 4 && strcmp(argv[1], "-v") == 0) {
+        return verify(argv[2], argv[3]);
+    }
+    usage(argv[0]);
+}
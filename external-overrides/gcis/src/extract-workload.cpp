@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Query workloads for the extract experiments.
+ *
+ * Writes files in the format of scripts/generate_extract_input.py, one
+ * "l r" interval per line, for access patterns other than uniform:
+ *
+ *   uniform     positions uniform over the text (the format and names of
+ *               generate_extract_input.py: <prefix>.<length>_extract, but
+ *               not its queries, which come from Python's random.seed(42))
+ *   zipf        hot spots: the text is split in blocks, a block is drawn
+ *               with Zipf probability (the ranks are shuffled over the
+ *               text) and the position is uniform inside it
+ *   sequential  a scan from a random position, each query starting where the
+ *               previous one ended, wrapping at the end of the text
+ *   clustered   positions normally distributed around a few random centers
+ *   readahead   random seeks, each followed by a run of consecutive queries
+ *   mixed       log-uniform lengths between the smallest and the largest
+ *               length, positions uniform
+ *
+ * Fixed-length workloads are written to <prefix>.<workload>.<length>_extract
+ * for every length, mixed to <prefix>.mixed_extract.
+ */
+
+using namespace std;
+
+typedef pair<uint64_t, uint64_t> interval;
+
+struct workload_options {
+    uint64_t queries = 10000;
+    double zipf_exponent = 0.99;
+    uint64_t block_size = 4096;
+    uint64_t clusters = 16;
+    double cluster_spread = 65536;
+    uint64_t run_length = 16;
+};
+
+// first position of a query of length len (the text has at least len + 1
+// symbols)
+uint64_t random_start(mt19937_64 &rng, uint64_t text_len, uint64_t len) {
+    return uniform_int_distribution<uint64_t>(0, text_len - len - 1)(rng);
+}
+
+vector<interval> uniform(mt19937_64 &rng, uint64_t text_len, uint64_t len,
+                         const workload_options &o) {
+    vector<interval> q;
+    for (uint64_t i = 0; i < o.queries; i++) {
+        uint64_t x = random_start(rng, text_len, len);
+        q.push_back(make_pair(x, x + len - 1));
+    }
+    return q;
+}
+
+vector<interval> zipf(mt19937_64 &rng, uint64_t text_len, uint64_t len,
+                      const workload_options &o) {
+    const uint64_t last = text_len - len - 1;
+    const uint64_t blocks = last / o.block_size + 1;
+    // cumulative probability of the ranks
+    vector<double> cdf(blocks);
+    double total = 0;
+    for (uint64_t i = 0; i < blocks; i++) {
+        total += 1.0 / pow((double)(i + 1), o.zipf_exponent);
+        cdf[i] = total;
+    }
+    // rank -> block, so the hot blocks are spread over the text
+    vector<uint64_t> block(blocks);
+    for (uint64_t i = 0; i < blocks; i++) {
+        block[i] = i;
+    }
+    shuffle(block.begin(), block.end(), rng);
+
+    uniform_real_distribution<double> u(0, total);
+    vector<interval> q;
+    for (uint64_t i = 0; i < o.queries; i++) {
+        uint64_t rank = lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        uint64_t begin = block[min(rank, blocks - 1)] * o.block_size;
+        uint64_t end = min(begin + o.block_size - 1, last);
+        uint64_t x = uniform_int_distribution<uint64_t>(begin, end)(rng);
+        q.push_back(make_pair(x, x + len - 1));
+    }
+    return q;
+}
+
+vector<interval> sequential(mt19937_64 &rng, uint64_t text_len, uint64_t len,
+                            const workload_options &o) {
+    vector<interval> q;
+    uint64_t x = random_start(rng, text_len, len);
+    for (uint64_t i = 0; i < o.queries; i++) {
+        if (x + len > text_len - 1) {
+            x = 0;
+        }
+        q.push_back(make_pair(x, x + len - 1));
+        x += len;
+    }
+    return q;
+}
+
+vector<interval> clustered(mt19937_64 &rng, uint64_t text_len, uint64_t len,
+                           const workload_options &o) {
+    const uint64_t last = text_len - len - 1;
+    vector<uint64_t> centers;
+    for (uint64_t i = 0; i < max<uint64_t>(1, o.clusters); i++) {
+        centers.push_back(random_start(rng, text_len, len));
+    }
+    uniform_int_distribution<uint64_t> pick(0, centers.size() - 1);
+    normal_distribution<double> offset(0, o.cluster_spread);
+    vector<interval> q;
+    for (uint64_t i = 0; i < o.queries; i++) {
+        double x = (double)centers[pick(rng)] + offset(rng);
+        uint64_t start = x < 0 ? 0 : min<uint64_t>((uint64_t)x, last);
+        q.push_back(make_pair(start, start + len - 1));
+    }
+    return q;
+}
+
+vector<interval> readahead(mt19937_64 &rng, uint64_t text_len, uint64_t len,
+                           const workload_options &o) {
+    vector<interval> q;
+    uint64_t x = 0, left = 0;
+    for (uint64_t i = 0; i < o.queries; i++) {
+        if (left == 0 || x + len > text_len - 1) {
+            x = random_start(rng, text_len, len);
+            left = max<uint64_t>(1, o.run_length);
+        }
+        q.push_back(make_pair(x, x + len - 1));
+        x += len;
+        left--;
+    }
+    return q;
+}
+
+vector<interval> mixed(mt19937_64 &rng, uint64_t text_len, uint64_t min_len,
+                       uint64_t max_len, const workload_options &o) {
+    uniform_real_distribution<double> u(log((double)min_len),
+                                        log((double)max_len + 1));
+    vector<interval> q;
+    for (uint64_t i = 0; i < o.queries; i++) {
+        uint64_t len = (uint64_t)exp(u(rng));
+        len = max(min_len, min(len, max_len));
+        uint64_t x = random_start(rng, text_len, len);
+        q.push_back(make_pair(x, x + len - 1));
+    }
+    return q;
+}
+
+void write_queries(const string &path, const vector<interval> &q) {
+    ofstream out(path);
+    if (!out) {
+        cerr << "Cannot write " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+    for (auto &i : q) {
+        out << i.first << " " << i.second << "\n";
+    }
+    cout << path << ": " << q.size() << " queries" << endl;
+}
+
+vector<string> split(const string &s) {
+    vector<string> v;
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        size_t end = s.find(',', begin);
+        if (end == string::npos) {
+            end = s.size();
+        }
+        if (end > begin) {
+            v.push_back(s.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return v;
+}
+
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// seed of the stream of one file, from the seed, the workload (FNV-1a of its
+// name) and the length
+uint64_t stream_seed(uint64_t seed, const string &workload, uint64_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : workload) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    return splitmix64(splitmix64(seed ^ h) ^ len);
+}
+
+void usage(char *prog) {
+    cerr << "Usage: \n"
+         << prog << " <input> <output prefix> [options]\n"
+         << "  -w <workloads>  comma-separated, of uniform,zipf,sequential,"
+            "clustered,readahead,mixed (default: all)\n"
+         << "  -s <lengths>    comma-separated substring lengths (default "
+            "1,10,100,1000,10000)\n"
+         << "  -n <queries>    queries per file (default 10000)\n"
+         << "  -r <seed>       random seed (default 42)\n"
+         << "  -z <exponent>   Zipf exponent (default 0.99)\n"
+         << "  -b <bytes>      block of a zipf hot spot (default 4096)\n"
+         << "  -c <clusters>   centers of clustered (default 16)\n"
+         << "  -d <bytes>      standard deviation around a center (default "
+            "65536)\n"
+         << "  -k <queries>    consecutive queries after a readahead seek "
+            "(default 16)\n";
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    workload_options o;
+    string workloads = "uniform,zipf,sequential,clustered,readahead,mixed";
+    string lengths = "1,10,100,1000,10000";
+    uint64_t seed = 42;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:s:n:r:z:b:c:d:k:")) != -1) {
+        switch (opt) {
+        case 'w':
+            workloads = optarg;
+            break;
+        case 's':
+            lengths = optarg;
+            break;
+        case 'n':
+            o.queries = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'z':
+            o.zipf_exponent = strtod(optarg, NULL);
+            break;
+        case 'b':
+            o.block_size = max<uint64_t>(1, strtoull(optarg, NULL, 10));
+            break;
+        case 'c':
+            o.clusters = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            o.cluster_spread = strtod(optarg, NULL);
+            break;
+        case 'k':
+            o.run_length = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+    }
+    const string input(argv[optind]);
+    const string prefix(argv[optind + 1]);
+
+    struct stat st;
+    if (stat(input.c_str(), &st) != 0) {
+        cerr << "Cannot open " << input << endl;
+        exit(EXIT_FAILURE);
+    }
+    const uint64_t text_len = st.st_size;
+
+    vector<uint64_t> lens;
+    for (auto &l : split(lengths)) {
+        uint64_t len = strtoull(l.c_str(), NULL, 10);
+        // same bound as generate_extract_input.py
+        if (len == 0 || len + 1 > text_len) {
+            cerr << "warning: length " << l << " does not fit in " << input
+                 << ", skipping it" << endl;
+            continue;
+        }
+        lens.push_back(len);
+    }
+    if (lens.empty()) {
+        exit(EXIT_FAILURE);
+    }
+
+    typedef vector<interval> (*generator)(mt19937_64 &, uint64_t, uint64_t,
+                                          const workload_options &);
+    const vector<pair<string, generator>> fixed_length = {
+        {"uniform", uniform},     {"zipf", zipf},
+        {"sequential", sequential}, {"clustered", clustered},
+        {"readahead", readahead}};
+
+    for (auto &w : split(workloads)) {
+        // every file has its own stream, so adding a workload or a length
+        // does not change the others
+        mt19937_64 rng(stream_seed(seed, w, 0));
+        if (w == "mixed") {
+            write_queries(prefix + ".mixed_extract",
+                          mixed(rng, text_len,
+                                *min_element(lens.begin(), lens.end()),
+                                *max_element(lens.begin(), lens.end()), o));
+            continue;
+        }
+        auto g = find_if(fixed_length.begin(), fixed_length.end(),
+                         [&](const pair<string, generator> &f) {
+                             return f.first == w;
+                         });
+        if (g == fixed_length.end()) {
+            cerr << "Unknown workload " << w << endl;
+            usage(argv[0]);
+        }
+        for (uint64_t len : lens) {
+            rng.seed(stream_seed(seed, w, len));
+            string path = w == "uniform"
+                              ? prefix + "." + to_string(len) + "_extract"
+                              : prefix + "." + w + "." + to_string(len) +
+                                    "_extract";
+            write_queries(path, g->second(rng, text_len, len, o));
+        }
+    }
+    return 0;
+}
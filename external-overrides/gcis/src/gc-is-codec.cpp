@@ -1,4 +1,5 @@
 #include "../external/malloc_count/malloc_count.h"
+#include "../../malloc_count/gcx_probe.h" // before gcis.hpp and its macros
 #include "gcis.hpp"
 #include "gcis_eliasfano.hpp"
 #include "gcis_eliasfano_no_lcp.hpp"
@@ -12,7 +13,6 @@
 #include <iostream>
 //to gcx
 #include "../external/malloc_count/stack_count.h"
-#include <ctime>
 
 using namespace std::chrono;
 using timer = std::chrono::high_resolution_clock;
@@ -32,8 +32,15 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
     mm.event("GC-IS Init");
 #endif
+#ifdef MEM_TIMELINE
+    gcis::timeline::event("init");
+#endif
 
+#if defined(PERF_COUNTERS) || defined(MEM_TIMELINE)
+    if (argc != 6 && argc != 7) { // 1 more optional argument for the hardware counters or memory timeline report
+#else
     if (argc != 6) { //adiciona 1 argumento para o report do gcx
+#endif
         std::cerr << "Usage: \n"
                   << argv[0]
                   << " -c <file_to_be_encoded> <output> <codec flag>\n"
@@ -45,6 +52,12 @@ int main(int argc, char *argv[]) {
                   << " -l <file_to_be_decoded> <output> <codec flag>\n"
                   << argv[0]
                   << " -e <encoded_file> <query file> <codec flag>\n";
+#ifdef PERF_COUNTERS
+        std::cerr << "followed by <gcx report> [<hardware counters report>]\n";
+#endif
+#ifdef MEM_TIMELINE
+        std::cerr << "followed by <gcx report> [<memory timeline report>]\n";
+#endif
 
         exit(EXIT_FAILURE);
     }
@@ -55,9 +68,13 @@ int main(int argc, char *argv[]) {
 
     //To GCX
     char * file_dcx = argv[5];
-    void* base = stack_count_clear();
-    double duration = 0.0;
-    clock_t clock_time;
+    gcx_probe probe;
+#ifdef PERF_COUNTERS
+    char *file_perf = argc == 7 ? argv[6] : NULL;
+#endif
+#ifdef MEM_TIMELINE
+    char *file_timeline = argc == 7 ? argv[6] : NULL;
+#endif
 
     if (codec_flag == "-s8b") {
         d = new gcis_s8b_pointers;
@@ -80,20 +97,24 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
         mm.event("GC-IS Compress");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("compress");
+#endif
 
         auto start = timer::now();
-        clock_time = clock(); //gcx
+        gcx_probe_start(&probe); //gcx
 
         d->encode(str, n);
 
-        clock_time = clock() - clock_time; //gcx
-        duration = ((double)clock_time)/CLOCKS_PER_SEC; //gcx
-
+        gcx_probe_stop(&probe); //gcx
         auto stop = timer::now();
 
 #ifdef MEM_MONITOR
         mm.event("GC-IS Save");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("save");
+#endif
 
         cout << "input:\t" << n << " bytes" << endl;
         cout << "output:\t" << d->size_in_bytes() << " bytes" << endl;
@@ -110,20 +131,25 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
         mm.event("GC-IS Load");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("load");
+#endif
 
         d->load(input);
 
 #ifdef MEM_MONITOR
         mm.event("GC-IS Decompress");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("decompress");
+#endif
 
         auto start = timer::now();
         char *str;
         int_t n;
-        clock_time = clock(); //gcx
+        gcx_probe_start(&probe); //gcx
         tie(str, n) = d->decode();
-        clock_time = clock() - clock_time; //gcx
-        duration = ((double)clock_time)/CLOCKS_PER_SEC; //gcx
+        gcx_probe_stop(&probe); //gcx
         auto stop = timer::now();
 
         cout << "input:\t" << d->size_in_bytes() << " bytes" << endl;
@@ -147,19 +173,27 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
         mm.event("GC-IS/SACA Load");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("load");
+#endif
 
         d->load(input);
 
 #ifdef MEM_MONITOR
         mm.event("GC-IS/SACA Decompress");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("decode_saca");
+#endif
 
         uint_t *SA;
         std::cout << "Building SA under decoding." << std::endl;
         auto start = timer::now();
         char *str;
         int_t n;
+        gcx_probe_start(&probe); //gcx
         tie(str, n) = d->decode_saca(&SA);
+        gcx_probe_stop(&probe); //gcx
         auto stop = timer::now();
 
 #if CHECK
@@ -195,12 +229,18 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
         mm.event("GC-IS/SACA+LCP Load");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("load");
+#endif
 
         d->load(input);
 
 #ifdef MEM_MONITOR
         mm.event("GC-IS/SACA_LCP Decompress");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("decode_saca_lcp");
+#endif
 
         uint_t *SA;
         int_t *LCP;
@@ -208,7 +248,9 @@ int main(int argc, char *argv[]) {
         auto start = timer::now();
         int_t n = 0;
         char *str = nullptr;
+        gcx_probe_start(&probe); //gcx
         tie(str, n) = d->decode_saca_lcp(&SA, &LCP);
+        gcx_probe_stop(&probe); //gcx
         auto stop = timer::now();
 
 #if CHECK
@@ -265,18 +307,28 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
         mm.event("GC-IS Load");
 #endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("load");
+#endif
 
         d->load(input);
 
 #ifdef MEM_MONITOR
         mm.event("GC-IS Extract");
+#endif
+#ifdef MEM_TIMELINE
+        gcis::timeline::event("extract");
 #endif
         vector<pair<int, int>> v_query;
         uint64_t l, r;
         while (query >> l >> r) {
             v_query.push_back(make_pair(l, r));
         }
-        duration = d->extract_batch(v_query); //duration to gcx
+        // wall and cpu both cover the printing of the substrings inside
+        // extract_batch; its own total, printed on stdout, leaves it out
+        gcx_probe_start(&probe); //gcx
+        d->extract_batch(v_query);
+        gcx_probe_stop(&probe); //gcx
     } else {
         std::cerr << "Invalid mode, use: " << endl
                   << "-c for compression;" << endl
@@ -291,19 +343,49 @@ int main(int argc, char *argv[]) {
 #ifdef MEM_MONITOR
     mm.event("GC-IS Finish");
 #endif
+#ifdef MEM_TIMELINE
+    gcis::timeline::event("finish");
+#endif
 
     //To GCX
     printf("Gerando relatório para o GCX\n");
-    FILE *report_dcx = fopen(file_dcx, "a");
-    if(report_dcx == NULL) {
+    if(!gcx_probe_report(file_dcx, &probe)) {
 	printf("Erro ao abrir arquivo de relatório %s\n",file_dcx);
 	exit(1);
     }
-    long long int peak = malloc_count_peak();
-    long long int stack = stack_count_usage(base);
-    fprintf(report_dcx, "%lld|%lld|%5.4lf|", peak,stack,duration);
-    printf("Time inserted into the GCX report: %5.4lf\n", duration);
-    fclose(report_dcx);
+    // -s and -l decompress too
+    gcx_probe_record(&probe, "gcis",
+                     strcmp(mode, "-c") == 0   ? "compression"
+                     : strcmp(mode, "-e") == 0 ? "extraction"
+                                               : "decompression");
+
+#if defined(PERF_COUNTERS) || defined(MEM_TIMELINE)
+    const char *mode_name = strcmp(mode, "-c") == 0   ? "compress"
+                            : strcmp(mode, "-d") == 0 ? "decompress"
+                            : strcmp(mode, "-e") == 0 ? "extract"
+                            : strcmp(mode, "-s") == 0 ? "decode_saca"
+                                                      : "decode_saca_lcp";
+#endif
+
+#ifdef PERF_COUNTERS
+    // rows: mode|phase|level|calls|time|cycles|instructions|llc_misses|dtlb_misses|branch_misses
+    if (file_perf != NULL) {
+        if (!gcis::perf::write_report(file_perf, mode_name)) {
+            printf("Erro ao abrir arquivo de relatório %s\n", file_perf);
+            exit(1);
+        }
+    }
+#endif
+
+#ifdef MEM_TIMELINE
+    // rows: mode|time|kind|name|level|current|peak
+    if (file_timeline != NULL) {
+        if (!gcis::timeline::write_report(file_timeline, mode_name)) {
+            printf("Erro ao abrir arquivo de relatório %s\n", file_timeline);
+            exit(1);
+        }
+    }
+#endif
 
     return 0;
 }
@@ -0,0 +1,819 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#ifdef BENCH_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef BENCH_LZMA
+#include <lzma.h>
+#endif
+#ifdef BENCH_SHAPEDSLP
+#include "Common.hpp"
+#include "DirectAccessibleGammaCode.hpp"
+#include "FixedBitLenCode.hpp"
+#include "IncBitLenCode.hpp"
+#include "PlainSlp.hpp"
+#include "PoSlp.hpp"
+#include "SelectType.hpp"
+#include "SelfShapedSlp.hpp"
+#include "SelfShapedSlpV2.hpp"
+#include "ShapedSlp.hpp"
+#include "ShapedSlpV2.hpp"
+#endif
+#include "../external/malloc_count/malloc_count.h"
+#include "../external/malloc_count/stack_count.h"
+#include "../../malloc_count/gcx_probe.h"
+// gcis.hpp defines a max() macro, so every other header comes first
+#include "gcis.hpp"
+#include "gcis_eliasfano.hpp"
+#include "gcis_s8b.hpp"
+
+/**
+ * In-process benchmark of every codec of the experiments.
+ *
+ * The input is mapped once and each codec compresses it, decompresses it
+ * and, with -q, extracts the [l,r] intervals of the query files, all in
+ * memory. Every operation runs <warmup> untimed and <repetitions> timed
+ * times and is measured with gcx_probe; the median wall and CPU times are
+ * reported, and the peak, stack and peak RSS are the largest of the timed
+ * runs. Results are checked against the input with a
+ * checksum instead of files and cmp, and every row is written with a single
+ * append, so a row is either complete or absent.
+ *
+ * Rows follow COMPRESSION_HEADER and EXTRACTION_HEADER of
+ * measure_compression.sh; each one also goes to $GCX_RECORDS as records of
+ * gcx_record.h, with the parameter report=native.
+ */
+
+extern "C" {
+// Navarro's Re-Pair (external/repair-navarro/repair.c), linked with its main
+// renamed so that prepare() and repair() can be called on a buffer.
+extern int u, c, alph, n, *C;
+extern char map[256];
+void prepare(char *text, int len);
+int repair(FILE *R);
+void repair_release(void);
+}
+
+// a rule as written in the .R file (Tpair of repair-navarro)
+struct repair_rule {
+    int left, right;
+};
+
+/**
+ * Codec under benchmark. Buffers returned by decompress() are new[]'d and
+ * owned by the caller.
+ */
+class bench_codec {
+  public:
+    std::string name;
+
+    explicit bench_codec(const std::string &name) : name(name) {}
+    virtual ~bench_codec() {}
+
+    /**
+     * Builds the compressed representation of s[0,len). Returns false for
+     * codecs whose representation is built by another tool and loaded.
+     */
+    virtual bool compress(const char *s, uint64_t len) = 0;
+    virtual std::pair<char *, uint64_t> decompress() = 0;
+    virtual uint64_t size_in_bytes() = 0;
+
+    /**
+     * Prepares the extraction of intervals of at most max_len symbols.
+     * Returns false if the codec has no random access.
+     */
+    virtual bool extract_init(uint64_t max_len) { return false; }
+    virtual void extract(uint64_t l, uint64_t r, char *out) {}
+};
+
+/**
+ * GCIS through gcis_interface, with the extraction of the Elias-Fano codec.
+ */
+template <class dict_t> class gcis_codec : public bench_codec {
+  public:
+    explicit gcis_codec(const std::string &name) : bench_codec(name) {}
+
+    bool compress(const char *s, uint64_t len) override {
+        // gc_is() works on a writable copy
+        std::vector<char> str(s, s + len);
+        d.reset(new dict_t);
+        d->encode(str.data(), (int_t)len);
+        return true;
+    }
+
+    std::pair<char *, uint64_t> decompress() override {
+        char *str;
+        int_t len;
+        tie(str, len) = d->decode();
+        return make_pair(str, (uint64_t)len);
+    }
+
+    uint64_t size_in_bytes() override { return d->size_in_bytes(); }
+
+    bool extract_init(uint64_t max_len) override;
+    void extract(uint64_t l, uint64_t r, char *out) override;
+
+  private:
+    std::unique_ptr<dict_t> d;
+    sdsl::int_vector<> extracted_text;
+    sdsl::int_vector<> tmp_text;
+};
+
+template <class dict_t> bool gcis_codec<dict_t>::extract_init(uint64_t) {
+    return false;
+}
+
+template <class dict_t>
+void gcis_codec<dict_t>::extract(uint64_t, uint64_t, char *) {}
+
+template <>
+bool gcis_codec<gcis_dictionary<gcis_eliasfano_codec>>::extract_init(
+    uint64_t max_len) {
+    // same bound as gcis_dictionary::extract(l, r)
+    uint64_t size = d->g.size()
+                        ? 4 * (d->g.back().fully_decoded_tail_len + max_len)
+                        : max_len;
+    extracted_text.resize(size);
+    tmp_text.resize(size);
+    return true;
+}
+
+template <>
+void gcis_codec<gcis_dictionary<gcis_eliasfano_codec>>::extract(uint64_t l,
+                                                                uint64_t r,
+                                                                char *out) {
+    d->extract(l, r, extracted_text, tmp_text);
+    for (uint64_t i = 0; i <= r - l; i++) {
+        out[i] = extracted_text[i];
+    }
+}
+
+/**
+ * Navarro's Re-Pair. The rules (.R) are kept in memory and the final
+ * sequence (.C) is compacted, so size_in_bytes() is the size of both files.
+ */
+class repair_codec : public bench_codec {
+  public:
+    repair_codec() : bench_codec("REPAIR") {}
+
+    bool compress(const char *s, uint64_t len) override {
+        if (len > (uint64_t)INT32_MAX) {
+            std::cerr << "Re-Pair is limited to 2GB inputs." << endl;
+            exit(EXIT_FAILURE);
+        }
+        // prepare() takes ownership of the text
+        char *text = (char *)malloc(len);
+        memcpy(text, s, len);
+        prepare(text, (int)len);
+
+        char *rules_buf = NULL;
+        size_t rules_size = 0;
+        FILE *R = open_memstream(&rules_buf, &rules_size);
+        if (R == NULL || repair(R) != 0) {
+            std::cerr << "Re-Pair failed." << endl;
+            exit(EXIT_FAILURE);
+        }
+        fclose(R);
+
+        // the same walk over the gaps of C as repair.c's main()
+        seq.clear();
+        int i = 0;
+        while (i < u) {
+            seq.push_back(C[i]);
+            i++;
+            if ((i < u) && (C[i] < 0)) {
+                i = -C[i] - 1;
+            }
+        }
+
+        sigma = alph;
+        memcpy(symbols, map, sizeof(symbols));
+        rules.resize((rules_size - sizeof(int) - alph) / sizeof(repair_rule));
+        memcpy(rules.data(), rules_buf + sizeof(int) + alph,
+               rules.size() * sizeof(repair_rule));
+        free(rules_buf);
+        repair_release();
+        rules_bytes = rules_size;
+        plain_size = len;
+        return true;
+    }
+
+    std::pair<char *, uint64_t> decompress() override {
+        char *str = new char[plain_size];
+        uint64_t pos = 0;
+        for (int s : seq) {
+            expand(s, str, pos);
+        }
+        return make_pair(str, plain_size);
+    }
+
+    uint64_t size_in_bytes() override {
+        return rules_bytes + seq.size() * sizeof(int);
+    }
+
+    bool extract_init(uint64_t) override {
+        // expanded length of every symbol and prefix sums over C
+        len.resize(sigma + rules.size());
+        for (int a = 0; a < sigma; a++) {
+            len[a] = 1;
+        }
+        for (uint64_t r = 0; r < rules.size(); r++) {
+            len[sigma + r] = len[rules[r].left] + len[rules[r].right];
+        }
+        start.resize(seq.size() + 1);
+        start[0] = 0;
+        for (uint64_t i = 0; i < seq.size(); i++) {
+            start[i + 1] = start[i] + len[seq[i]];
+        }
+        return true;
+    }
+
+    void extract(uint64_t l, uint64_t r, char *out) override {
+        uint64_t i = std::upper_bound(start.begin(), start.end(), l) -
+                     start.begin() - 1;
+        uint64_t pos = 0;
+        for (; start[i] <= r; i++) {
+            extract_symbol(seq[i], start[i], l, r, out, pos);
+        }
+    }
+
+  private:
+    int sigma = 0;
+    char symbols[256];
+    std::vector<repair_rule> rules;
+    std::vector<int> seq;
+    uint64_t rules_bytes = 0;
+    uint64_t plain_size = 0;
+    std::vector<uint64_t> len;
+    std::vector<uint64_t> start;
+
+    void expand(int s, char *str, uint64_t &pos) {
+        while (s >= sigma) {
+            expand(rules[s - sigma].left, str, pos);
+            s = rules[s - sigma].right;
+        }
+        str[pos++] = symbols[s];
+    }
+
+    // writes the part of symbol s (starting at text position p) inside [l,r]
+    void extract_symbol(int s, uint64_t p, uint64_t l, uint64_t r, char *out,
+                        uint64_t &pos) {
+        while (s >= sigma) {
+            int left = rules[s - sigma].left;
+            if (p + len[left] > l) {
+                if (p + len[s] - 1 <= r && p >= l) {
+                    expand(s, out, pos);
+                    return;
+                }
+                extract_symbol(left, p, l, r, out, pos);
+            }
+            p += len[left];
+            if (p > r) {
+                return;
+            }
+            s = rules[s - sigma].right;
+        }
+        if (p >= l && p <= r) {
+            out[pos++] = symbols[s];
+        }
+    }
+};
+
+#ifdef BENCH_BZIP2
+/**
+ * bzip2 through libbz2, with 900k blocks as the bzip2 tool.
+ */
+class bzip2_codec : public bench_codec {
+  public:
+    bzip2_codec() : bench_codec("bzip2") {}
+
+    bool compress(const char *s, uint64_t len) override {
+        // worst case of BZ2_bzBuffToBuffCompress: 1% + 600 bytes
+        unsigned int dest_len = len + len / 100 + 600;
+        packed.resize(dest_len);
+        int ret = BZ2_bzBuffToBuffCompress(packed.data(), &dest_len,
+                                           const_cast<char *>(s), len, 9, 0, 0);
+        if (ret != BZ_OK) {
+            std::cerr << "BZ2_bzBuffToBuffCompress failed: " << ret << endl;
+            exit(EXIT_FAILURE);
+        }
+        packed.resize(dest_len);
+        plain_size = len;
+        return true;
+    }
+
+    std::pair<char *, uint64_t> decompress() override {
+        char *str = new char[plain_size];
+        unsigned int dest_len = plain_size;
+        int ret = BZ2_bzBuffToBuffDecompress(str, &dest_len, packed.data(),
+                                             packed.size(), 0, 0);
+        if (ret != BZ_OK) {
+            std::cerr << "BZ2_bzBuffToBuffDecompress failed: " << ret << endl;
+            exit(EXIT_FAILURE);
+        }
+        return make_pair(str, (uint64_t)dest_len);
+    }
+
+    uint64_t size_in_bytes() override { return packed.size(); }
+
+  private:
+    std::vector<char> packed;
+    uint64_t plain_size = 0;
+};
+#endif
+
+#ifdef BENCH_LZMA
+/**
+ * LZMA2 (.xz) through liblzma, with the default preset.
+ */
+class lzma_codec : public bench_codec {
+  public:
+    lzma_codec() : bench_codec("lzma") {}
+
+    bool compress(const char *s, uint64_t len) override {
+        packed.resize(lzma_stream_buffer_bound(len));
+        size_t out_pos = 0;
+        lzma_ret ret = lzma_easy_buffer_encode(
+            LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64, NULL, (const uint8_t *)s,
+            len, packed.data(), &out_pos, packed.size());
+        if (ret != LZMA_OK) {
+            std::cerr << "lzma_easy_buffer_encode failed: " << ret << endl;
+            exit(EXIT_FAILURE);
+        }
+        packed.resize(out_pos);
+        plain_size = len;
+        return true;
+    }
+
+    std::pair<char *, uint64_t> decompress() override {
+        char *str = new char[plain_size];
+        uint64_t memlimit = UINT64_MAX;
+        size_t in_pos = 0, out_pos = 0;
+        lzma_ret ret = lzma_stream_buffer_decode(
+            &memlimit, 0, NULL, packed.data(), &in_pos, packed.size(),
+            (uint8_t *)str, &out_pos, plain_size);
+        if (ret != LZMA_OK) {
+            std::cerr << "lzma_stream_buffer_decode failed: " << ret << endl;
+            exit(EXIT_FAILURE);
+        }
+        return make_pair(str, (uint64_t)out_pos);
+    }
+
+    uint64_t size_in_bytes() override { return packed.size(); }
+
+  private:
+    std::vector<uint8_t> packed;
+    uint64_t plain_size = 0;
+};
+#endif
+
+#ifdef BENCH_SHAPEDSLP
+/**
+ * A ShapedSlp encoding of the Re-Pair grammar. The encoding is built by
+ * SlpEncBuild, so it is loaded from <prefix><encoding> instead of compressed;
+ * its rows take the compression columns of the Re-Pair run, as
+ * compress_and_decompress_with_repair does.
+ */
+class slp_codec_base : public bench_codec {
+  public:
+    std::string path;
+
+    slp_codec_base(const std::string &encoding, const std::string &path)
+        : bench_codec("REPAIR-" + encoding), path(path) {}
+};
+
+template <class SlpT> class slp_codec : public slp_codec_base {
+  public:
+    slp_codec(const std::string &encoding, const std::string &path)
+        : slp_codec_base(encoding, path) {}
+
+    bool compress(const char *, uint64_t) override {
+        std::ifstream fs(path);
+        if (!fs) {
+            std::cerr << "Cannot open " << path << endl;
+            exit(EXIT_FAILURE);
+        }
+        slp.reset(new SlpT);
+        slp->load(fs);
+        encoded_size = fs.tellg();
+        return false;
+    }
+
+    std::pair<char *, uint64_t> decompress() override {
+        uint64_t len = slp->getLen();
+        char *str = new char[len];
+        slp->expandSubstr(0, len, str);
+        return make_pair(str, len);
+    }
+
+    uint64_t size_in_bytes() override { return encoded_size; }
+
+    bool extract_init(uint64_t) override { return true; }
+
+    void extract(uint64_t l, uint64_t r, char *out) override {
+        slp->expandSubstr(l, r - l + 1, out);
+    }
+
+  private:
+    std::unique_ptr<SlpT> slp;
+    uint64_t encoded_size = 0;
+};
+
+using var_t = uint32_t;
+using Fblc = FixedBitLenCode<>;
+using SelSd = SelectSdvec<>;
+using SelMcl = SelectMcl<>;
+using DagcSd = DirectAccessibleGammaCode<SelSd>;
+using DagcMcl = DirectAccessibleGammaCode<SelMcl>;
+
+// the encodings of EXTRACT_ENCODING in measure_compression.sh
+void add_slp_codecs(std::vector<std::unique_ptr<bench_codec>> &codecs,
+                    const std::string &prefix) {
+    auto add = [&](slp_codec_base *codec) {
+        if (std::ifstream(codec->path)) {
+            codecs.emplace_back(codec);
+        } else {
+            std::cerr << "warning: " << codec->path << " not found, skipping "
+                      << codec->name << endl;
+            delete codec;
+        }
+    };
+    add(new slp_codec<PlainSlp<var_t, Fblc, Fblc>>(
+        "PlainSlp_FblcFblc", prefix + "PlainSlp_FblcFblc"));
+    add(new slp_codec<PlainSlp<var_t, IncBitLenCode, Fblc>>(
+        "PlainSlp_IblcFblc", prefix + "PlainSlp_IblcFblc"));
+    add(new slp_codec<PlainSlp<var_t, FixedBitLenCode<32>, Fblc>>(
+        "PlainSlp_32Fblc", prefix + "PlainSlp_32Fblc"));
+    add(new slp_codec<PoSlp<var_t, IncBitLenCode>>("PoSlp_Iblc",
+                                                   prefix + "PoSlp_Iblc"));
+    add(new slp_codec<PoSlp<var_t, DagcSd>>("PoSlp_Sd", prefix + "PoSlp_Sd"));
+    add(new slp_codec<ShapedSlp<var_t, DagcSd, DagcMcl, DagcSd, SelSd, SelMcl>>(
+        "ShapedSlp_SdMclSd_SdMcl", prefix + "ShapedSlp_SdMclSd_SdMcl"));
+    add(new slp_codec<ShapedSlp<var_t, DagcSd, DagcSd, DagcSd, SelSd, SelMcl>>(
+        "ShapedSlp_SdSdSd_SdMcl", prefix + "ShapedSlp_SdSdSd_SdMcl"));
+    add(new slp_codec<ShapedSlpV2<var_t, DagcSd, SelSd, SelMcl>>(
+        "ShapedSlpV2_Sd_SdMcl", prefix + "ShapedSlpV2_Sd_SdMcl"));
+    add(new slp_codec<SelfShapedSlp<var_t, DagcSd, DagcSd, SelSd>>(
+        "SelfShapedSlp_SdSd_Sd", prefix + "SelfShapedSlp_SdSd_Sd"));
+    add(new slp_codec<SelfShapedSlp<var_t, DagcSd, DagcSd, SelMcl>>(
+        "SelfShapedSlp_SdSd_Mcl", prefix + "SelfShapedSlp_SdSd_Mcl"));
+    add(new slp_codec<SelfShapedSlpV2<var_t, DagcSd, DagcSd, SelSd>>(
+        "SelfShapedSlpV2_SdSd_Sd", prefix + "SelfShapedSlpV2_SdSd_Sd"));
+}
+#endif
+
+/**
+ * FNV-1a, chained over the pieces of a text.
+ */
+uint64_t checksum(const char *s, uint64_t len,
+                  uint64_t h = 14695981039346656037ULL) {
+    for (uint64_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+struct measurement {
+    double time = 0.0; // seconds, median of the timed runs
+    double cpu = 0.0;  // seconds, median of the timed runs
+    long long int peak = 0;
+    long long int stack = 0;
+    long long int peak_rss = 0;
+};
+
+/**
+ * Runs op warmup + repetitions times.
+ */
+template <class op_t>
+measurement measure(op_t op, uint64_t warmup, uint64_t repetitions) {
+    for (uint64_t i = 0; i < warmup; i++) {
+        op();
+    }
+    measurement m;
+    std::vector<double> times, cpu_times;
+    for (uint64_t i = 0; i < repetitions; i++) {
+        gcx_probe probe;
+        gcx_probe_start(&probe);
+        op();
+        gcx_probe_stop(&probe);
+        m.peak = std::max<long long int>(m.peak, probe.peak);
+        m.stack = std::max<long long int>(m.stack, probe.stack);
+        m.peak_rss = std::max<long long int>(m.peak_rss, probe.peak_rss);
+        times.push_back(probe.wall);
+        cpu_times.push_back(probe.cpu);
+    }
+    std::sort(times.begin(), times.end());
+    std::sort(cpu_times.begin(), cpu_times.end());
+    m.time = times[times.size() / 2];
+    m.cpu = cpu_times[cpu_times.size() / 2];
+    return m;
+}
+
+/**
+ * Appends a complete row with one write().
+ */
+void append_row(const std::string &file, const std::string &row) {
+    int fd = open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0 || write(fd, row.data(), row.size()) != (ssize_t)row.size()) {
+        std::cerr << "Cannot append to " << file << endl;
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+/**
+ * Appends a record of m (gcx_record.h) for the phase of a codec.
+ */
+void record_measurement(const std::string &label, const std::string &codec,
+                        const char *phase, const std::string &params,
+                        const measurement &m) {
+    gcx_record r;
+    gcx_record_begin(&r, "gcis-bench", phase, label.c_str(), codec.c_str(),
+                     params.c_str());
+    gcx_record_double(&r, "wall", m.time);
+    gcx_record_double(&r, "cpu", m.cpu);
+    gcx_record_int(&r, "peak", m.peak);
+    gcx_record_int(&r, "stack", m.stack);
+    gcx_record_int(&r, "peak_rss", m.peak_rss);
+    gcx_record_write(&r);
+}
+
+void record_size(const std::string &label, const std::string &codec,
+                 uint64_t size, uint64_t plain_size) {
+    gcx_record r;
+    gcx_record_begin(&r, "gcis-bench", "size", label.c_str(), codec.c_str(),
+                     "report=native");
+    gcx_record_int(&r, "compressed_size", size);
+    gcx_record_int(&r, "plain_size", plain_size);
+    gcx_record_write(&r);
+}
+
+std::string format_measurement(const measurement &m) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%lld|%lld|%5.4lf|%5.4lf|%lld|", m.peak, m.stack,
+             m.time, m.cpu, m.peak_rss);
+    return buf;
+}
+
+struct query_file {
+    std::string path;
+    std::vector<std::pair<uint64_t, uint64_t>> queries;
+    uint64_t max_len = 0;
+    uint64_t total_len = 0;
+    uint64_t expected = 0; // checksum of the substrings, in order
+};
+
+query_file load_queries(const std::string &path, const char *text,
+                        uint64_t text_len) {
+    query_file q;
+    q.path = path;
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+    uint64_t l, r;
+    q.expected = checksum(NULL, 0);
+    while (in >> l >> r) {
+        if (l > r || r >= text_len) {
+            std::cerr << "query [" << l << "," << r << "] of " << path
+                      << " is out of the text" << endl;
+            exit(EXIT_FAILURE);
+        }
+        q.queries.push_back(make_pair(l, r));
+        q.max_len = std::max<uint64_t>(q.max_len, r - l + 1);
+        q.total_len += r - l + 1;
+        q.expected = checksum(text + l, r - l + 1, q.expected);
+    }
+    return q;
+}
+
+void usage(char *prog) {
+    std::cerr << "Usage: \n"
+              << prog << " <input> <report> [options]\n"
+              << "  -a <codecs>   comma-separated codecs (default: all), of "
+                 "GCIS-ef,GCIS-s8b,REPAIR"
+#ifdef BENCH_BZIP2
+              << ",bzip2"
+#endif
+#ifdef BENCH_LZMA
+              << ",lzma"
+#endif
+#ifdef BENCH_SHAPEDSLP
+              << ",REPAIR-<encoding> (needs REPAIR)"
+#endif
+              << "\n"
+              << "  -n <runs>     timed runs of every operation (default 5)\n"
+              << "  -w <runs>     untimed runs before them (default 1)\n"
+              << "  -l <label>    file column of the rows (default: input "
+                 "basename)\n"
+              << "  -q <queries>  extract the [l,r] intervals of this file "
+                 "(repeatable)\n"
+              << "  -x <report>   report of the extract rows (required by "
+                 "-q)\n"
+#ifdef BENCH_SHAPEDSLP
+              << "  -p <prefix>   ShapedSlp encodings are <prefix><encoding> "
+                 "(default: <input>-)\n"
+#endif
+        ;
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t repetitions = 5, warmup = 1;
+    std::string label, only, extract_report, slp_prefix;
+    std::vector<std::string> query_paths;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:n:w:l:q:x:p:")) != -1) {
+        switch (opt) {
+        case 'a':
+            only = "," + std::string(optarg) + ",";
+            break;
+        case 'n':
+            repetitions = std::max<uint64_t>(1, strtoull(optarg, NULL, 10));
+            break;
+        case 'w':
+            warmup = strtoull(optarg, NULL, 10);
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        case 'q':
+            query_paths.push_back(optarg);
+            break;
+        case 'x':
+            extract_report = optarg;
+            break;
+        case 'p':
+            slp_prefix = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2 || (!query_paths.empty() && extract_report.empty())) {
+        usage(argv[0]);
+    }
+    const std::string input(argv[optind]);
+    const std::string report(argv[optind + 1]);
+    if (label.empty()) {
+        label = input.substr(input.find_last_of('/') + 1);
+    }
+    if (slp_prefix.empty()) {
+        slp_prefix = input + "-";
+    }
+
+    // the input is mapped once and shared by every codec
+    int fd = open(input.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Cannot open " << input << endl;
+        exit(EXIT_FAILURE);
+    }
+    const uint64_t text_len = st.st_size;
+    const char *text =
+        (const char *)mmap(NULL, text_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+        std::cerr << "Cannot map " << input << endl;
+        exit(EXIT_FAILURE);
+    }
+    const uint64_t text_checksum = checksum(text, text_len);
+
+    std::vector<query_file> query_files;
+    for (auto &path : query_paths) {
+        query_files.push_back(load_queries(path, text, text_len));
+    }
+
+    std::vector<std::unique_ptr<bench_codec>> codecs;
+    codecs.emplace_back(
+        new gcis_codec<gcis_dictionary<gcis_eliasfano_codec>>("GCIS-ef"));
+    codecs.emplace_back(new gcis_codec<gcis_s8b_pointers>("GCIS-s8b"));
+    codecs.emplace_back(new repair_codec);
+#ifdef BENCH_BZIP2
+    codecs.emplace_back(new bzip2_codec);
+#endif
+#ifdef BENCH_LZMA
+    codecs.emplace_back(new lzma_codec);
+#endif
+#ifdef BENCH_SHAPEDSLP
+    add_slp_codecs(codecs, slp_prefix);
+#endif
+
+    auto selected = [&](const std::string &name) {
+        return only.empty() || only.find("," + name + ",") != string::npos;
+    };
+    // the ShapedSlp rows (REPAIR-<encoding>) take the compression columns of
+    // the REPAIR run, which is added before them
+    for (auto &codec : codecs) {
+        if (codec->name.compare(0, 7, "REPAIR-") == 0 &&
+            selected(codec->name) && !selected("REPAIR")) {
+            std::cerr << codec->name << " needs REPAIR in -a, for its "
+                                        "compression columns"
+                      << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    bool failed = false;
+    measurement repair_comp;
+    uint64_t repair_size = 0;
+    for (auto &codec : codecs) {
+        if (!selected(codec->name)) {
+            continue;
+        }
+        cout << codec->name << ": BEGIN" << endl;
+
+        bool compressed = true;
+        measurement comp = measure(
+            [&]() { compressed = codec->compress(text, text_len); }, warmup,
+            repetitions);
+        uint64_t size = codec->size_in_bytes();
+        if (codec->name == "REPAIR") {
+            repair_comp = comp;
+            repair_size = size;
+        }
+        if (!compressed) {
+            comp = repair_comp;
+            size += repair_size;
+        }
+
+        uint64_t decoded_checksum = 0, decoded_len = 0;
+        measurement decomp = measure(
+            [&]() {
+                char *str;
+                tie(str, decoded_len) = codec->decompress();
+                decoded_checksum = checksum(str, decoded_len);
+                delete[] str;
+            },
+            warmup, repetitions);
+        if (decoded_len != text_len || decoded_checksum != text_checksum) {
+            std::cerr << codec->name << ": the decompressed text differs from "
+                      << input << endl;
+            failed = true;
+            continue;
+        }
+        append_row(report, label + "|" + codec->name + "|" +
+                               format_measurement(comp) +
+                               format_measurement(decomp) +
+                               std::to_string(size) + "|" +
+                               std::to_string(text_len) + "\n");
+        record_measurement(label, codec->name, "compression", "report=native",
+                           comp);
+        record_measurement(label, codec->name, "decompression",
+                           "report=native", decomp);
+        record_size(label, codec->name, size, text_len);
+        cout << "compression: " << comp.time
+             << " s, decompression: " << decomp.time << " s, " << size
+             << " bytes" << endl;
+
+        for (auto &q : query_files) {
+            if (q.queries.empty() || !codec->extract_init(q.max_len)) {
+                continue;
+            }
+            std::vector<char> out(q.max_len);
+            uint64_t extracted = 0;
+            measurement ext = measure(
+                [&]() {
+                    extracted = checksum(NULL, 0);
+                    for (auto &p : q.queries) {
+                        codec->extract(p.first, p.second, out.data());
+                        extracted = checksum(out.data(), p.second - p.first + 1,
+                                             extracted);
+                    }
+                },
+                warmup, repetitions);
+            if (extracted != q.expected) {
+                std::cerr << codec->name << ": wrong substrings for "
+                          << q.path << endl;
+                failed = true;
+                continue;
+            }
+            append_row(extract_report, label + "|" + codec->name + "|" +
+                                           format_measurement(ext) +
+                                           std::to_string(q.max_len) + "\n");
+            record_measurement(label, codec->name, "extraction",
+                               "report=native,substring_size=" +
+                                   std::to_string(q.max_len),
+                               ext);
+            cout << q.path << ": " << ext.time << " s, "
+                 << q.queries.size() / ext.time << " queries/s" << endl;
+        }
+        cout << codec->name << ": END" << endl;
+    }
+
+    munmap((void *)text, text_len);
+    close(fd);
+    return failed ? EXIT_FAILURE : 0;
+}
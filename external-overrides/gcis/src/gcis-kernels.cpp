@@ -0,0 +1,596 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+// gcis.hpp defines a max() macro, so every other header comes first
+#include "gcis.hpp"
+#include "gcis_eliasfano.hpp"
+#include "gcis_gap.hpp"
+
+/**
+ * Microbenchmark of the GCIS kernels, one row per kernel, codec and level:
+ *
+ *   induceSAl, induceSAs     level 0 of encode, from the LMS-suffixes in
+ *                            place, per symbol
+ *   lms_naming               naming of the sorted LMS-substrings inside gc_is,
+ *                            per symbol of the level (read from the
+ *                            MICROBENCH stopwatch of microbench.hpp)
+ *   encode                   the whole encode, per symbol of the text
+ *   bsearch_upperbound,      on partial_sum, per query
+ *   bsearch_lowerbound
+ *   sequential_upperbound,   on windows of the reduced string and the top
+ *   sequential_lowerbound    level, per query
+ *   extract_rule             random rules of every level, per rule
+ *   decompress               every level, per rule, freeing included
+ *   bit_compress             sdsl::util::bit_compress of the text and of the
+ *                            reduced string, per symbol
+ *
+ * The inputs are synthetic (random: uniform over ACGT; versions: a random
+ * base and mutated copies of it, each copy of the previous one, like the
+ * versioned files of the repcorpus) or prefixes of files given with -i.
+ * Everything random comes from a fixed seed, so two builds measure the
+ * same work and their rows can be compared.
+ *
+ * Each kernel runs <warmup> untimed and <repetitions> timed rounds; a round
+ * repeats the kernel until it adds up to <min time>. The median, minimum and
+ * maximum time per item of the rounds are reported, in nanoseconds.
+ *
+ * Rows follow GCIS_KERNELS_HEADER of measure_compression.sh.
+ */
+
+struct kernel_options {
+    uint64_t repetitions = 5;
+    uint64_t warmup = 1;
+    double min_time = 0.1; // seconds per round
+    uint64_t queries = 4096;
+    uint64_t window = 256; // symbols of a sequential_* window
+    uint64_t seed = 42;
+    std::string only; // ",kernel,...," or empty
+};
+
+struct timing {
+    uint64_t rounds = 0;
+    double median = 0.0; // ns per item
+    double min = 0.0;
+    double max = 0.0;
+};
+
+typedef std::chrono::steady_clock kernel_clock;
+
+// keeps the results of the timed calls alive
+static volatile uint64_t sink;
+
+/**
+ * Runs setup() untimed and op() timed, op() doing items operations.
+ */
+template <class setup_t, class op_t>
+timing measure(setup_t setup, op_t op, uint64_t items,
+               const kernel_options &o) {
+    std::vector<double> rounds;
+    for (uint64_t r = 0; r < o.warmup + o.repetitions; r++) {
+        double ns = 0;
+        uint64_t it = 0;
+        do {
+            setup();
+            kernel_clock::time_point t0 = kernel_clock::now();
+            op();
+            kernel_clock::time_point t1 = kernel_clock::now();
+            ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+            it++;
+        } while (ns < o.min_time * 1e9);
+        if (r >= o.warmup) {
+            rounds.push_back(ns / (double)(it * std::max<uint64_t>(1, items)));
+        }
+    }
+    timing t;
+    t.rounds = rounds.size();
+    std::sort(rounds.begin(), rounds.end());
+    t.median = rounds[rounds.size() / 2];
+    t.min = rounds.front();
+    t.max = rounds.back();
+    return t;
+}
+
+template <class op_t>
+timing measure(op_t op, uint64_t items, const kernel_options &o) {
+    return measure([]() {}, op, items, o);
+}
+
+/**
+ * Appends a complete row with one write().
+ */
+void append_row(const std::string &file, const std::string &row) {
+    int fd = open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0 || write(fd, row.data(), row.size()) != (ssize_t)row.size()) {
+        std::cerr << "Cannot append to " << file << endl;
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+class gcis_kernels {
+  public:
+    gcis_kernels(const std::string &report, const std::string &label,
+                 const kernel_options &o)
+        : report(report), label(label), o(o) {}
+
+    bool wanted(const std::string &kernel) const {
+        return o.only.empty() ||
+               o.only.find("," + kernel + ",") != std::string::npos;
+    }
+
+    void row(const std::string &kernel, const std::string &codec, int level,
+             uint64_t n, uint64_t items, const timing &t) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%llu|%.3lf|%.3lf|%.3lf\n",
+                 (unsigned long long)t.rounds, t.median, t.min, t.max);
+        append_row(report, label + "|" + input + "|" + kernel + "|" + codec +
+                               "|" + std::to_string(level) + "|" +
+                               std::to_string(n) + "|" + std::to_string(items) +
+                               "|" + buf);
+        cout << input << " " << kernel << " " << codec << " " << level << ": "
+             << t.median << " ns" << endl;
+    }
+
+    /**
+     * induceSAl and induceSAs of level 0, with the classification and the
+     * LMS placement of gcis_dictionary<gcis_eliasfano_codec>::gc_is.
+     */
+    void induce(std::vector<char> &text) {
+        if (!wanted("induceSAl") && !wanted("induceSAs")) {
+            return;
+        }
+        gcis_dictionary<gcis_eliasfano_codec> d;
+        int_t *s = (int_t *)text.data();
+        int_t n = text.size(), K = 256, i;
+        int cs = sizeof(char);
+        std::vector<unsigned char> types(n / 8 + 1);
+        unsigned char *t = types.data();
+        tset(n - 1, 0);
+        for (i = n - 2; i >= 0; i--)
+            tset(i, (chr(i) < chr(i + 1) ||
+                     (chr(i) == chr(i + 1) && tget(i + 1) == 1))
+                        ? 1
+                        : 0);
+        std::vector<int_t> bkt(K);
+        std::vector<uint_t> lms(n, EMPTY), SA(n);
+        d.get_buckets(s, bkt.data(), n, K, cs, true);
+        for (i = n - 2; i >= 0; i--) {
+            if (isLMS(i)) {
+                lms[bkt[chr(i)]--] = i;
+            }
+        }
+
+        timing l = measure(
+            [&]() { std::copy(lms.begin(), lms.end(), SA.begin()); },
+            [&]() { d.induceSAl(t, SA.data(), s, bkt.data(), n, K, cs, 0); },
+            n, o);
+        // the L-suffixes in place, as induceSAs finds them
+        std::vector<uint_t> l_induced(SA);
+        timing r = measure(
+            [&]() { std::copy(l_induced.begin(), l_induced.end(), SA.begin()); },
+            [&]() { d.induceSAs(t, SA.data(), s, bkt.data(), n, K, cs, 0); },
+            n, o);
+        if (wanted("induceSAl")) {
+            row("induceSAl", "-", 0, n, n, l);
+        }
+        if (wanted("induceSAs")) {
+            row("induceSAs", "-", 0, n, n, r);
+        }
+    }
+
+    /**
+     * Encodes the text, with the time of encode and of the LMS naming of
+     * every level, and leaves the grammar in d.
+     */
+    template <class dict_t>
+    void encode(std::unique_ptr<dict_t> &d, const std::vector<char> &text,
+                const std::string &codec) {
+        std::vector<char> str;
+        std::vector<std::vector<double>> naming; // ns of every level
+        std::vector<double> total;
+        for (uint64_t r = 0; r < o.warmup + o.repetitions; r++) {
+            // gc_is() works on a writable copy
+            str = text;
+            d.reset(new dict_t);
+            gcis::microbench::lms_naming().clear();
+            kernel_clock::time_point t0 = kernel_clock::now();
+            d->encode(str.data(), (int_t)str.size());
+            kernel_clock::time_point t1 = kernel_clock::now();
+            if (r < o.warmup) {
+                continue;
+            }
+            total.push_back(
+                std::chrono::duration<double, std::nano>(t1 - t0).count());
+            const std::vector<uint64_t> &ns = gcis::microbench::lms_naming();
+            if (ns.size() > naming.size()) {
+                naming.resize(ns.size());
+            }
+            for (uint64_t level = 0; level < ns.size(); level++) {
+                naming[level].push_back((double)ns[level]);
+            }
+        }
+        if (wanted("encode")) {
+            row("encode", codec, -1, text.size(), text.size(),
+                summary(total, text.size()));
+        }
+        if (!wanted("lms_naming")) {
+            return;
+        }
+        for (uint64_t level = 0; level < naming.size(); level++) {
+            // the last level is dropped when its names are unique, its
+            // string is then the reduced string
+            uint64_t n = level < d->g.size() ? d->g[level].string_size
+                                             : d->reduced_string.size();
+            row("lms_naming", codec, level, n, n, summary(naming[level], n));
+        }
+    }
+
+    /**
+     * bsearch_* and sequential_* of extract, on the top level.
+     */
+    template <class dict_t>
+    void search(dict_t &d, const std::string &codec) {
+        if (d.g.empty() || d.partial_sum.empty()) {
+            return;
+        }
+        auto &top = d.g.back();
+        const uint64_t m = d.partial_sum.size();
+        const uint64_t covered =
+            d.partial_sum.back() +
+            top.fully_decoded_rule_len[d.reduced_string[m - 1]];
+        std::mt19937_64 rng(o.seed);
+        std::uniform_int_distribution<uint64_t> position(0, covered - 1);
+        std::vector<uint64_t> sz(o.queries);
+        for (auto &x : sz) {
+            x = position(rng);
+        }
+        if (wanted("bsearch_upperbound")) {
+            row("bsearch_upperbound", codec, d.g.size(), m, o.queries,
+                measure(
+                    [&]() {
+                        uint64_t sum = 0;
+                        for (uint64_t x : sz) {
+                            sum += d.bsearch_upperbound(d.partial_sum, x);
+                        }
+                        sink = sum;
+                    },
+                    o.queries, o));
+        }
+        if (wanted("bsearch_lowerbound")) {
+            row("bsearch_lowerbound", codec, d.g.size(), m, o.queries,
+                measure(
+                    [&]() {
+                        uint64_t sum = 0;
+                        for (uint64_t x : sz) {
+                            sum += d.bsearch_lowerbound(d.partial_sum, x);
+                        }
+                        sink = sum;
+                    },
+                    o.queries, o));
+        }
+
+        if (!wanted("sequential_upperbound") &&
+            !wanted("sequential_lowerbound")) {
+            return;
+        }
+        // windows of the reduced string, as extract finds them one level
+        // down, and a position inside each one
+        const uint64_t w = std::min<uint64_t>(o.window, m);
+        std::uniform_int_distribution<uint64_t> start(0, m - w);
+        std::vector<sdsl::int_vector<>> windows(o.queries);
+        std::vector<int64_t> text_l(o.queries), text_r(o.queries),
+            target(o.queries);
+        for (uint64_t q = 0; q < o.queries; q++) {
+            uint64_t k = start(rng);
+            windows[q] = sdsl::int_vector<>(w);
+            for (uint64_t i = 0; i < w; i++) {
+                windows[q][i] = d.reduced_string[k + i];
+            }
+            text_l[q] = top.fully_decoded_tail_len + d.partial_sum[k];
+            text_r[q] = top.fully_decoded_tail_len + d.partial_sum[k + w - 1] +
+                        top.fully_decoded_rule_len[d.reduced_string[k + w - 1]];
+            target[q] = std::uniform_int_distribution<int64_t>(
+                text_l[q], text_r[q] - 1)(rng);
+        }
+        if (wanted("sequential_upperbound")) {
+            row("sequential_upperbound", codec, d.g.size() - 1, w, o.queries,
+                measure(
+                    [&]() {
+                        uint64_t sum = 0;
+                        for (uint64_t q = 0; q < o.queries; q++) {
+                            int64_t r = text_r[q];
+                            sum += d.sequential_upperbound(top, windows[q], w,
+                                                           target[q], r);
+                        }
+                        sink = sum;
+                    },
+                    o.queries, o));
+        }
+        if (wanted("sequential_lowerbound")) {
+            row("sequential_lowerbound", codec, d.g.size() - 1, w, o.queries,
+                measure(
+                    [&]() {
+                        uint64_t sum = 0;
+                        for (uint64_t q = 0; q < o.queries; q++) {
+                            int64_t l = text_l[q];
+                            sum += d.sequential_lowerbound(top, windows[q], w,
+                                                           target[q], l);
+                        }
+                        sink = sum;
+                    },
+                    o.queries, o));
+        }
+    }
+
+    /**
+     * extract_rule of random rules and decompress() of every level.
+     */
+    template <class dict_t>
+    void levels(dict_t &d, const std::string &codec) {
+        std::mt19937_64 rng(o.seed);
+        for (uint64_t level = 0; level < d.g.size(); level++) {
+            auto &g = d.g[level];
+            const uint64_t rules = g.fully_decoded_rule_len.size();
+            if (rules == 0) {
+                continue;
+            }
+            if (wanted("extract_rule")) {
+                std::uniform_int_distribution<uint64_t> pick(0, rules - 1);
+                std::vector<uint64_t> rule(o.queries);
+                for (auto &x : rule) {
+                    x = pick(rng);
+                }
+                // a rule is never longer than the string it was taken from
+                sdsl::int_vector<> tmp_text(g.string_size);
+                row("extract_rule", codec, level, rules, o.queries,
+                    measure(
+                        [&]() {
+                            uint64_t sum = 0;
+                            for (uint64_t x : rule) {
+                                uint64_t idx = 0;
+                                g.extract_rule(x, tmp_text, idx);
+                                sum += idx;
+                            }
+                            sink = sum;
+                        },
+                        o.queries, o));
+            }
+            if (wanted("decompress")) {
+                row("decompress", codec, level, rules, rules,
+                    measure([&]() { g.decompress(); }, rules, o));
+            }
+        }
+    }
+
+    /**
+     * sdsl::util::bit_compress of a copy of wide.
+     */
+    void bit_compress(const sdsl::int_vector<> &wide, const std::string &codec,
+                      int level) {
+        if (!wanted("bit_compress") || wide.size() == 0) {
+            return;
+        }
+        sdsl::int_vector<> copy;
+        row("bit_compress", codec, level, wide.size(), wide.size(),
+            measure([&]() { copy = wide; },
+                    [&]() { sdsl::util::bit_compress(copy); }, wide.size(),
+                    o));
+    }
+
+    template <class dict_t>
+    void run_codec(const std::vector<char> &text, const std::string &codec) {
+        std::unique_ptr<dict_t> d;
+        encode(d, text, codec);
+        search(*d, codec);
+        levels(*d, codec);
+        sdsl::int_vector<> reduced(d->reduced_string.size(), 0, 64);
+        for (uint64_t i = 0; i < reduced.size(); i++) {
+            reduced[i] = d->reduced_string[i];
+        }
+        bit_compress(reduced, codec, d->g.size());
+    }
+
+    void run(const std::string &name, std::vector<char> &text,
+             const std::string &codecs) {
+        input = name;
+        induce(text);
+        if (wanted("bit_compress")) {
+            sdsl::int_vector<> wide(text.size(), 0, 64);
+            for (uint64_t i = 0; i < text.size(); i++) {
+                wide[i] = (unsigned char)text[i];
+            }
+            bit_compress(wide, "-", 0);
+        }
+        if (codecs.find(",ef,") != std::string::npos) {
+            run_codec<gcis_dictionary<gcis_eliasfano_codec>>(text, "ef");
+        }
+        if (codecs.find(",gap,") != std::string::npos) {
+            run_codec<gcis_dictionary<gcis_gap_codec>>(text, "gap");
+        }
+    }
+
+  private:
+    std::string report;
+    std::string label;
+    std::string input;
+    kernel_options o;
+
+    timing summary(std::vector<double> &ns, uint64_t items) {
+        timing t;
+        t.rounds = ns.size();
+        if (ns.empty()) {
+            return t;
+        }
+        std::sort(ns.begin(), ns.end());
+        const double per_item = (double)std::max<uint64_t>(1, items);
+        t.median = ns[ns.size() / 2] / per_item;
+        t.min = ns.front() / per_item;
+        t.max = ns.back() / per_item;
+        return t;
+    }
+};
+
+std::vector<char> random_text(uint64_t n, uint64_t seed) {
+    static const char dna[] = "ACGT";
+    std::mt19937_64 rng(seed);
+    std::vector<char> text(n);
+    for (auto &c : text) {
+        c = dna[rng() & 3];
+    }
+    return text;
+}
+
+/**
+ * A random base of 64 KiB followed by copies of the previous copy with a
+ * mutation every 1000 symbols on average.
+ */
+std::vector<char> versions_text(uint64_t n, uint64_t seed) {
+    static const char dna[] = "ACGT";
+    const uint64_t base = std::min<uint64_t>(n, 1 << 16);
+    std::mt19937_64 rng(seed);
+    std::vector<char> text = random_text(base, seed);
+    text.resize(n);
+    std::bernoulli_distribution mutate(0.001);
+    for (uint64_t i = base; i < n; i++) {
+        text[i] = mutate(rng) ? dna[rng() & 3] : text[i - base];
+    }
+    return text;
+}
+
+std::vector<char> load_prefix(const std::string &path, uint64_t n) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+    std::vector<char> text(n);
+    in.read(text.data(), n);
+    text.resize(in.gcount());
+    return text;
+}
+
+std::vector<std::string> split(const std::string &s) {
+    std::vector<std::string> v;
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        size_t end = s.find(',', begin);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        if (end > begin) {
+            v.push_back(s.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return v;
+}
+
+void usage(char *prog) {
+    std::cerr
+        << "Usage: \n"
+        << prog << " <report> [options]\n"
+        << "  -i <file>     input, its first <size> bytes (repeatable)\n"
+        << "  -g <inputs>   comma-separated synthetic inputs, of "
+           "random,versions (default: both without -i)\n"
+        << "  -s <bytes>    size of the inputs (default 4194304)\n"
+        << "  -c <codecs>   comma-separated codecs, of ef,gap (default: both)\n"
+        << "  -k <kernels>  comma-separated kernels (default: all), of "
+           "induceSAl,induceSAs,lms_naming,encode,bsearch_upperbound,"
+           "bsearch_lowerbound,sequential_upperbound,sequential_lowerbound,"
+           "extract_rule,decompress,bit_compress\n"
+        << "  -n <rounds>   timed rounds of every kernel (default 5)\n"
+        << "  -w <rounds>   untimed rounds before them (default 1)\n"
+        << "  -t <seconds>  least time of a round (default 0.1)\n"
+        << "  -q <queries>  queries and rules per call (default 4096)\n"
+        << "  -r <seed>     random seed (default 42)\n"
+        << "  -l <label>    label column of the rows, e.g. the commit "
+           "(default: kernels)\n";
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    kernel_options o;
+    std::string label = "kernels", synthetic, codecs = "ef,gap";
+    std::vector<std::string> files;
+    uint64_t size = 1 << 22;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:g:s:c:k:n:w:t:q:r:l:")) != -1) {
+        switch (opt) {
+        case 'i':
+            files.push_back(optarg);
+            break;
+        case 'g':
+            synthetic = optarg;
+            break;
+        case 's':
+            size = std::max<uint64_t>(2, strtoull(optarg, NULL, 10));
+            break;
+        case 'c':
+            codecs = optarg;
+            break;
+        case 'k':
+            o.only = "," + std::string(optarg) + ",";
+            break;
+        case 'n':
+            o.repetitions = std::max<uint64_t>(1, strtoull(optarg, NULL, 10));
+            break;
+        case 'w':
+            o.warmup = strtoull(optarg, NULL, 10);
+            break;
+        case 't':
+            o.min_time = strtod(optarg, NULL);
+            break;
+        case 'q':
+            o.queries = std::max<uint64_t>(1, strtoull(optarg, NULL, 10));
+            break;
+        case 'r':
+            o.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 1) {
+        usage(argv[0]);
+    }
+    if (synthetic.empty() && files.empty()) {
+        synthetic = "random,versions";
+    }
+    codecs = "," + codecs + ",";
+
+    gcis_kernels kernels(argv[optind], label, o);
+    for (auto &g : split(synthetic)) {
+        std::vector<char> text;
+        if (g == "random") {
+            text = random_text(size, o.seed);
+        } else if (g == "versions") {
+            text = versions_text(size, o.seed);
+        } else {
+            std::cerr << "Unknown input " << g << endl;
+            usage(argv[0]);
+        }
+        kernels.run(g, text, codecs);
+    }
+    for (auto &path : files) {
+        std::vector<char> text = load_prefix(path, size);
+        if (text.size() < 2) {
+            std::cerr << path << " is too short" << endl;
+            exit(EXIT_FAILURE);
+        }
+        kernels.run(path.substr(path.find_last_of('/') + 1), text, codecs);
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+// gcis.hpp defines a max() macro, so the standard headers come first
+#include "gcis.hpp"
+#include "gcis_eliasfano.hpp"
+
+/**
+ * Converts a GCIS grammar into a straight-line program written in the
+ * Navarro Re-Pair format (<output>.R and <output>.C), so that ShapedSlp's
+ * SlpEncBuild can encode it with -f NavarroRepair.
+ *
+ * A GCIS level i stores a tail and one rule per symbol of level i+1, each
+ * rule being a sequence of level i symbols, and the text is
+ *   tail_0 exp_0(tail_1 exp_1(tail_2 ... exp_{L-1}(reduced_string)))
+ * Every rule becomes a balanced binary tree of pairs (shared subtrees are
+ * emitted once), and the tails plus the reduced string become the C sequence.
+ */
+
+using slp_pair = std::pair<uint32_t, uint32_t>;
+
+class slp_builder {
+  public:
+    uint32_t alph = 0;
+    char map[256];
+    uint32_t terminal[256];
+    std::vector<slp_pair> rules;
+
+    slp_builder() {
+        for (int c = 0; c < 256; c++) {
+            terminal[c] = UINT32_MAX;
+        }
+    }
+
+    void add_terminal(unsigned char c) {
+        if (terminal[c] == UINT32_MAX) {
+            map[alph] = c;
+            terminal[c] = alph++;
+        }
+    }
+
+    /**
+     * Returns the SLP symbol deriving body[lo,hi), creating the pairs needed.
+     */
+    uint32_t binarize(const std::vector<uint32_t> &body, uint64_t lo,
+                      uint64_t hi) {
+        if (hi - lo == 1) {
+            return body[lo];
+        }
+        uint64_t mid = lo + (hi - lo) / 2;
+        uint32_t left = binarize(body, lo, mid);
+        uint32_t right = binarize(body, mid, hi);
+        uint64_t key = ((uint64_t)left << 32) | right;
+        auto it = known.find(key);
+        if (it != known.end()) {
+            return it->second;
+        }
+        uint64_t id = (uint64_t)alph + rules.size();
+        if (id > (uint64_t)INT32_MAX) {
+            std::cerr << "Grammar too large for the Navarro format." << endl;
+            exit(EXIT_FAILURE);
+        }
+        rules.push_back(make_pair(left, right));
+        known[key] = id;
+        return id;
+    }
+
+    void write(const string &basename, const std::vector<uint32_t> &C) {
+        FILE *R = fopen((basename + ".R").c_str(), "w");
+        FILE *Cf = fopen((basename + ".C").c_str(), "w");
+        if (R == NULL || Cf == NULL) {
+            std::cerr << "Cannot open " << basename << ".R/.C for writing."
+                      << endl;
+            exit(EXIT_FAILURE);
+        }
+        int a = alph;
+        if (fwrite(&a, sizeof(int), 1, R) != 1 ||
+            fwrite(map, sizeof(char), alph, R) != alph) {
+            std::cerr << "Cannot write " << basename << ".R" << endl;
+            exit(EXIT_FAILURE);
+        }
+        for (auto &p : rules) {
+            int pair[2] = {(int)p.first, (int)p.second};
+            if (fwrite(pair, sizeof(int), 2, R) != 2) {
+                std::cerr << "Cannot write " << basename << ".R" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (fwrite(C.data(), sizeof(uint32_t), C.size(), Cf) != C.size()) {
+            std::cerr << "Cannot write " << basename << ".C" << endl;
+            exit(EXIT_FAILURE);
+        }
+        fclose(R);
+        fclose(Cf);
+    }
+
+  private:
+    std::unordered_map<uint64_t, uint32_t> known;
+};
+
+template <class dict_t>
+void gcis_to_slp(dict_t &d, const string &basename) {
+    slp_builder slp;
+    std::vector<uint32_t> C;
+    uint64_t levels = d.g.size();
+
+    if (levels == 0) {
+        for (uint64_t i = 0; i < d.reduced_string.size(); i++) {
+            slp.add_terminal(d.reduced_string[i]);
+        }
+        for (uint64_t i = 0; i < d.reduced_string.size(); i++) {
+            C.push_back(slp.terminal[(unsigned char)d.reduced_string[i]]);
+        }
+        slp.write(basename, C);
+        return;
+    }
+
+    // Top-down: the rules of level i are the symbols used at level i+1, so
+    // their number is known once level i+1 has been expanded.
+    std::vector<std::vector<std::vector<uint32_t>>> body(levels);
+    uint64_t num_rules = 0;
+    for (uint64_t i = 0; i < d.reduced_string.size(); i++) {
+        num_rules = std::max<uint64_t>(num_rules, d.reduced_string[i] + 1);
+    }
+    std::vector<uint_t> scratch;
+    for (int64_t level = levels - 1; level >= 0; level--) {
+        auto gd = std::move(d.g[level].decompress());
+        scratch.resize(d.g[level].string_size);
+        body[level].resize(num_rules);
+        uint64_t next_num_rules = 0;
+        for (uint64_t r = 0; r < num_rules; r++) {
+            uint_t l = 0;
+            gd.expand_rule(r, scratch, l);
+            body[level][r].assign(scratch.begin(), scratch.begin() + l);
+            for (uint_t j = 0; j < l; j++) {
+                next_num_rules =
+                    std::max<uint64_t>(next_num_rules, scratch[j] + 1);
+            }
+        }
+        for (uint64_t j = 0; j < d.g[level].tail.size(); j++) {
+            next_num_rules =
+                std::max<uint64_t>(next_num_rules, d.g[level].tail[j] + 1);
+        }
+        num_rules = next_num_rules;
+    }
+    std::vector<uint_t>().swap(scratch);
+
+    // Bottom-up: level 0 symbols are characters, level i>0 symbols are the
+    // rules of level i-1.
+    for (uint64_t j = 0; j < d.g[0].tail.size(); j++) {
+        slp.add_terminal(d.g[0].tail[j]);
+    }
+    for (auto &b : body[0]) {
+        for (auto c : b) {
+            slp.add_terminal(c);
+        }
+    }
+    std::vector<uint32_t> below(256);
+    for (int c = 0; c < 256; c++) {
+        below[c] = slp.terminal[c];
+    }
+    for (uint64_t j = 0; j < d.g[0].tail.size(); j++) {
+        C.push_back(below[d.g[0].tail[j]]);
+    }
+    for (uint64_t level = 0; level < levels; level++) {
+        std::vector<uint32_t> current(body[level].size());
+        for (uint64_t r = 0; r < body[level].size(); r++) {
+            std::vector<uint32_t> &b = body[level][r];
+            if (b.empty()) {
+                continue; // symbol not used by the grammar
+            }
+            for (auto &c : b) {
+                c = below[c];
+            }
+            current[r] = slp.binarize(b, 0, b.size());
+            std::vector<uint32_t>().swap(b);
+        }
+        below = std::move(current);
+        if (level + 1 < levels) {
+            for (uint64_t j = 0; j < d.g[level + 1].tail.size(); j++) {
+                C.push_back(below[d.g[level + 1].tail[j]]);
+            }
+        }
+    }
+    for (uint64_t i = 0; i < d.reduced_string.size(); i++) {
+        C.push_back(below[d.reduced_string[i]]);
+    }
+
+    cout << "levels:\t" << levels << endl;
+    cout << "terminals:\t" << slp.alph << endl;
+    cout << "rules:\t" << slp.rules.size() << endl;
+    cout << "C length:\t" << C.size() << endl;
+    slp.write(basename, C);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        std::cerr << "Usage: \n"
+                  << argv[0] << " <encoded_file> <output> <codec flag>\n"
+                  << "Writes <output>.R and <output>.C (Navarro Re-Pair "
+                     "format), to be encoded with SlpEncBuild -f "
+                     "NavarroRepair.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    string codec_flag(argv[3]);
+    if (codec_flag != "-ef") {
+        cerr << "Invalid CODEC." << endl;
+        cerr << "Only -ef (Elias-Fano) grammars can be converted" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    gcis_dictionary<gcis_eliasfano_codec> d;
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        std::cerr << "Cannot open " << argv[1] << endl;
+        exit(EXIT_FAILURE);
+    }
+    d.load(input);
+    input.close();
+
+    auto start = timer::now();
+    gcis_to_slp(d, string(argv[2]));
+    auto stop = timer::now();
+    cout << "time: "
+         << (double)duration_cast<milliseconds>(stop - start).count() / 1000.0
+         << " seconds" << endl;
+    return 0;
+}
@@ -25,11 +25,17 @@ limitations under the License.
 //        with a unique (define) symbol marker at the start of the string
 //
 // Usage:
-//   GLZAcompress [-m#] [-p#] [-r#] [-w0] <infilename> <outfilename>, where
+//   GLZAcompress [-m#] [-p#] [-r#] [-t#] [-w0] <infilename> <outfilename>, where
 //       -m# sets the production cost, default 6.0
 //       -p# sets the profit ratio weighting power, default 2.0 for capital encoded or UTF8 compliant files, 0.5 otherwise
 //       -r# sets the approximate RAM usage in millions of bytes
+//       -t# sets the number of threads used by the overlap check (at most 8) and substitution search (at most 6),
+//           default is the number of online processors.  The output does not depend on it.
 //       -w0 disables the first cycle word only search
+//       --gcx_report=<file> appends "peak|stack|wall|cpu|peak_rss|" to <file>
+//       --gcx_phase_report=<file> appends a "file|phase|wall|cpu|peak|stack|peak_rss" line per phase of the cycles to <file>
+//       The peak heap includes the available_RAM block (-r) allocated up front, so it is the reservation; the
+//       memory actually touched is peak_rss.
 
 #include <inttypes.h>
 #include <math.h>
@@ -37,7 +43,10 @@ limitations under the License.
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include "../malloc_count/gcx_probe.h"
 
 const uint8_t INSERT_SYMBOL_CHAR = 0xFE;
 const uint8_t DEFINE_SYMBOL_CHAR = 0xFF;
@@ -50,6 +59,9 @@ const uint32_t NUM_PRECALCULATED_INSTANCE_LOGS = 10000;
 const uint32_t NUM_PRECALCULATED_MATCH_RATIO_LOGS = 2000;
 const uint32_t MAX_SCORES = 30000;
 const uint32_t MAX_SYMBOLS_DEFINED = 0x00900000;
+const uint32_t NUM_OVERLAP_CHECK_CHUNKS = 8;
+const uint32_t MAX_FIND_SUBSTITUTIONS_THREADS = 6;
+const uint32_t FIND_SUBSTITUTIONS_SEGMENTS_PER_THREAD = 4;
 
 static struct string_node {
   uint32_t symbol;
@@ -98,11 +110,19 @@ struct score_data {
   uint8_t next_sibling;
 } node_data[20000];
 
+// The overlap check splits the data into the 8 chunks of the original main thread + 7 threads, whatever the thread
+// count, so the candidates invalidated at chunk boundaries (and thus the output) are those of the original code and
+// do not change with -t.  Up to 8 threads take the next chunk when done.
 struct overlap_check_data {
   uint32_t *start_symbol_ptr;
   uint32_t *stop_symbol_ptr;
-} overlap_check_data[7];
+} overlap_check_data[8];
+atomic_uint_least32_t overlap_check_next_chunk;
 
+// The substitution search threads take the next segment when done and write its results into the ring buffer
+// (slot) segment % num_find_substitutions_threads.  The main thread copies the segments out in order and frees
+// each slot for segment + num_find_substitutions_threads.  A slot holds 16 MiB of results, so there are at most
+// MAX_FIND_SUBSTITUTIONS_THREADS (the original 6) whatever -t, and the slots do not grow with the core count.
 struct find_substitutions_data {
   uint32_t *stop_symbol_ptr;
   uint32_t extra_match_symbols;
@@ -111,7 +131,24 @@ struct find_substitutions_data {
   atomic_uchar done;
   atomic_uint_least32_t write_index;
   atomic_uint_least32_t read_index;
-} find_substitutions_data[6];
+  atomic_uint_least32_t free_segment;
+  atomic_uint_least32_t active_segment; // segment + 1 once the slot is set up for it
+} *find_substitutions_data;
+uint32_t **find_substitutions_segment_ptrs;
+uint32_t num_find_substitutions_threads, num_find_substitutions_segments;
+atomic_uint_least32_t find_substitutions_next_segment;
+
+// wall time, CPU time, peak heap, main thread stack and peak RSS of each phase of the compression cycles, summed
+// (times) or maximized (memory) over the cycles.  The stack is only measured for the gcx reports.  The peak RSS is
+// reset at the start of each phase on Linux; elsewhere it is the peak of the process so far.
+enum { TREE_PHASE, SCORING_PHASE, CANDIDATES_PHASE, OVERLAP_CHECK_PHASE, SUBSTITUTION_PHASE, NUM_PHASES };
+const char * phase_names[NUM_PHASES] = { "suffix tree", "scoring", "candidates", "overlap check", "substitution" };
+double phase_time[NUM_PHASES], phase_cpu_time[NUM_PHASES], phase_start_time;
+double phase_start_cpu_time;
+size_t phase_peak[NUM_PHASES], phase_stack[NUM_PHASES], max_peak;
+long long phase_peak_rss[NUM_PHASES], max_peak_rss;
+void * phase_stack_base;
+uint8_t measure_stack;
 
 uint32_t this_symbol, max_string_length, max_scores, i1;
 uint32_t num_simple_symbols, node_instances, num_match_nodes, best_score_num_symbols, sibling_node_number;
@@ -134,6 +171,35 @@ atomic_uintptr_t max_symbol_ptr, scan_symbol_ptr;
 volatile uint32_t * old_data_ptr;
 
 
+void start_phase() {
+  if (malloc_count_peak() > max_peak)
+    max_peak = malloc_count_peak();
+  long long peak_rss = gcx_probe_peak_rss();
+  if (peak_rss > max_peak_rss)
+    max_peak_rss = peak_rss;
+  gcx_probe_reset_peak_rss();
+  malloc_count_reset_peak();
+  if (measure_stack)
+    phase_stack_base = stack_count_clear();
+  phase_start_cpu_time = gcx_probe_cpu();
+  phase_start_time = gcx_probe_wall();
+}
+
+
+void end_phase(uint8_t phase) {
+  phase_time[phase] += gcx_probe_wall() - phase_start_time;
+  phase_cpu_time[phase] += gcx_probe_cpu() - phase_start_cpu_time;
+  if (malloc_count_peak() > phase_peak[phase])
+    phase_peak[phase] = malloc_count_peak();
+  long long peak_rss = gcx_probe_peak_rss();
+  if (peak_rss > phase_peak_rss[phase])
+    phase_peak_rss[phase] = peak_rss;
+  if (measure_stack && (stack_count_usage(phase_stack_base) > phase_stack[phase]))
+    phase_stack[phase] = stack_count_usage(phase_stack_base);
+  start_phase();
+}
+
+
 uint32_t * init_best_score_ptrs() {
   best_score_last_match_ptr = candidates[candidates_index[i1]].last_match_index1 + start_symbol_ptr;
   return(best_score_last_match_ptr - candidates[candidates_index[i1]].num_symbols + 1);
@@ -1169,6 +1235,16 @@ thread_overlap_check_loop_match:
 }
 
 
+void *overlap_check_worker(void *arg) {
+  uint32_t chunk;
+
+  while ((chunk = atomic_fetch_add_explicit(&overlap_check_next_chunk, 1, memory_order_relaxed))
+      < NUM_OVERLAP_CHECK_CHUNKS)
+    overlap_check_thread(&overlap_check_data[chunk]);
+  return(0);
+}
+
+
 void *find_substitutions_thread(void *arg) {
   struct match_node *match_node_ptr;
   uint32_t this_symbol, node_score_number;
@@ -1389,6 +1465,26 @@ thread_symbol_substitution_loop_end:
 }
 
 
+void *find_substitutions_worker(void *arg) {
+  struct find_substitutions_data * thread_data_ptr;
+  uint32_t segment;
+
+  while ((segment = atomic_fetch_add_explicit(&find_substitutions_next_segment, 1, memory_order_relaxed))
+      < num_find_substitutions_segments) {
+    thread_data_ptr = &find_substitutions_data[segment % num_find_substitutions_threads];
+    while (atomic_load_explicit(&thread_data_ptr->free_segment, memory_order_acquire) != segment) /* wait */ ;
+    thread_data_ptr->start_symbol_ptr = find_substitutions_segment_ptrs[segment];
+    thread_data_ptr->stop_symbol_ptr = find_substitutions_segment_ptrs[segment + 1];
+    atomic_store_explicit(&thread_data_ptr->done, 0, memory_order_relaxed);
+    atomic_store_explicit(&thread_data_ptr->write_index, 0, memory_order_relaxed);
+    atomic_store_explicit(&thread_data_ptr->read_index, 0, memory_order_relaxed);
+    atomic_store_explicit(&thread_data_ptr->active_segment, segment + 1, memory_order_release);
+    find_substitutions_thread(thread_data_ptr);
+  }
+  return(0);
+}
+
+
 void *substitute_thread(void *arg) {
   uint32_t * end_data_ptr;
   uint32_t * near_end_data_ptr;
@@ -1452,12 +1548,15 @@ void *substitute_thread(void *arg) {
 
 
 void print_usage() {
-  fprintf(stderr,"Invalid format - Use GLZAcompress [-c#] [-p#] [-r#] [-w0] <infile> <outfile>\n");
+  fprintf(stderr,"Invalid format - Use GLZAcompress [-c#] [-p#] [-r#] [-t#] [-w0] <infile> <outfile>\n");
   fprintf(stderr," where -c# sets the grammar production cost in bits\n");
   fprintf(stderr,"       -p# sets the profit power ratio.  0.0 is most compressive, larger\n");
   fprintf(stderr,"           values favor longer strings\n");
   fprintf(stderr,"       -r# sets memory usage in millions of bytes\n");
+  fprintf(stderr,"       -t# sets the number of threads, default is the number of processors\n");
   fprintf(stderr,"       -w0 disables first cycle \"word\" only deduplication\n");
+  fprintf(stderr,"       --gcx_report=<file> appends peak heap (with the -r reservation), stack, times and peak RSS to <file>\n");
+  fprintf(stderr,"       --gcx_phase_report=<file> appends the time and memory of each phase to <file>\n");
   return;
 }
 
@@ -1477,12 +1576,15 @@ int main(int argc, char* argv[]) {
   float prior_cycle_start_ratio, prior_cycle_end_ratio;
 
   pthread_t build_lcp_thread1, build_lcp_thread2, build_lcp_thread3, build_lcp_thread4, build_lcp_thread5, build_lcp_thread6;
-  pthread_t rank_scores_thread1, substitute_thread1;
-  pthread_t overlap_check_threads[7];
-  pthread_t find_substitutions_threads[7];
+  pthread_t rank_scores_thread1, substitute_thread1, find_substitutions_restart_thread;
+  pthread_t *overlap_check_threads, *find_substitutions_threads;
+  uint32_t num_threads, num_overlap_check_threads;
+  char *file_report_gcx = 0, *file_phase_report_gcx = 0, *in_file_name;
 
 
   clock_t start_time = clock();
+  gcx_probe probe;
+  gcx_probe_start(&probe);
 
   for (i1 = 0 ; i1 < MAX_SCORES ; i1++)
     candidate_bad[i1] = 0;
@@ -1490,13 +1592,20 @@ int main(int argc, char* argv[]) {
   user_set_profit_ratio_power = 0;
   user_set_production_cost = 0;
   create_words = 1;
+  num_threads = 1;
+  if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+    num_threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
   arg_num = 1;
   if (argc < 3) {
     print_usage();
     exit(EXIT_FAILURE);
   }
   while (*argv[arg_num] ==  '-') {
-    if (*(argv[arg_num]+1) == 'c') {
+    if (strncmp(argv[arg_num], "--gcx_report=", 13) == 0)
+      file_report_gcx = argv[arg_num++] + 13;
+    else if (strncmp(argv[arg_num], "--gcx_phase_report=", 19) == 0)
+      file_phase_report_gcx = argv[arg_num++] + 19;
+    else if (*(argv[arg_num]+1) == 'c') {
       production_cost = (double)atof(argv[arg_num++]+2);
       user_set_production_cost = 1;
     }
@@ -1512,6 +1621,13 @@ int main(int argc, char* argv[]) {
         exit(EXIT_FAILURE);
       }
     }
+    else if (*(argv[arg_num]+1) == 't') {
+      num_threads = (uint32_t)atoi(argv[arg_num++]+2);
+      if (num_threads == 0) {
+        fprintf(stderr,"ERROR: -t value must be >= 1\n");
+        exit(EXIT_FAILURE);
+      }
+    }
     else if (*(argv[arg_num]+1) == 'w') {
       if (*(argv[arg_num++]+2) == '0')
         create_words = 0;
@@ -1521,7 +1637,7 @@ int main(int argc, char* argv[]) {
       }
     }
     else {
-      fprintf(stderr,"ERROR - Invalid '-' format.  Only -m<value>, -p<value> and -r<value> allowed\n");
+      fprintf(stderr,"ERROR - Invalid '-' format.  Only -m<value>, -p<value>, -r<value>, -t<value> and -w0 allowed\n");
       exit(EXIT_FAILURE);
     }
     if (argc < arg_num + 2) {
@@ -1530,6 +1646,33 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  // the main thread also checks overlaps; the substitution search runs beside the main and substitute threads
+  num_find_substitutions_threads = 0;
+  if (num_threads > 2)
+    num_find_substitutions_threads = num_threads - 2;
+  if (num_find_substitutions_threads > MAX_FIND_SUBSTITUTIONS_THREADS)
+    num_find_substitutions_threads = MAX_FIND_SUBSTITUTIONS_THREADS;
+  num_overlap_check_threads = num_threads;
+  if (num_overlap_check_threads > NUM_OVERLAP_CHECK_CHUNKS)
+    num_overlap_check_threads = NUM_OVERLAP_CHECK_CHUNKS;
+  overlap_check_threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+  find_substitutions_threads = (pthread_t *)malloc(sizeof(pthread_t) * (num_find_substitutions_threads + 1));
+  find_substitutions_data = (struct find_substitutions_data *)malloc(sizeof(struct find_substitutions_data)
+      * (num_find_substitutions_threads + 1));
+  find_substitutions_segment_ptrs = (uint32_t **)malloc(sizeof(uint32_t *)
+      * (FIND_SUBSTITUTIONS_SEGMENTS_PER_THREAD * num_find_substitutions_threads + 1));
+  if ((overlap_check_threads == 0) || (find_substitutions_threads == 0) || (find_substitutions_data == 0)
+      || (find_substitutions_segment_ptrs == 0)) {
+    fprintf(stderr,"ERROR - Insufficient RAM to compress - unable to allocate thread data for %u threads\n",
+        (unsigned int)num_threads);
+    exit(EXIT_FAILURE);
+  }
+
+  measure_stack = (file_report_gcx != 0) || (file_phase_report_gcx != 0);
+  in_file_name = argv[arg_num];
+  if (strrchr(in_file_name, '/') != 0)
+    in_file_name = strrchr(in_file_name, '/') + 1;
+
   if ((fd_in=fopen(argv[arg_num],"rb")) == NULL) {
     fprintf(stderr,"Error - unable to open input file '%s'\n",argv[arg_num]);
     exit(EXIT_FAILURE);
@@ -1768,6 +1911,7 @@ int main(int argc, char* argv[]) {
   prior_cycle_end_ratio = 1.0;
 
   do {
+    start_phase();
     next_new_symbol_number = num_simple_symbols + num_compound_symbols;
     num_file_symbols = end_symbol_ptr - start_symbol_ptr;
     d_file_symbols = (double)num_file_symbols;
@@ -1901,6 +2045,7 @@ int main(int argc, char* argv[]) {
         }
       }
 
+      end_phase(TREE_PHASE);
       node_ptrs_num = 0;
       atomic_store_explicit(&rank_scores_write_index, node_ptrs_num, memory_order_release);
       pthread_create(&rank_scores_thread1, NULL, rank_scores_thread, (void *)&rank_scores_buffer[0]);
@@ -2095,6 +2240,7 @@ int main(int argc, char* argv[]) {
 done_building_lcp_tree:
     atomic_store_explicit(&scan_symbol_ptr, (uintptr_t)in_symbol_ptr, memory_order_release);
     atomic_store_explicit(&max_symbol_ptr, (uintptr_t)in_symbol_ptr, memory_order_release);
+    end_phase(TREE_PHASE);
 
     node_ptrs_num = 0;
     atomic_store_explicit(&rank_scores_write_index, node_ptrs_num, memory_order_release);
@@ -2188,6 +2334,7 @@ done_building_lcp_tree:
     prior_cycle_end_ratio = (float)(in_symbol_ptr-start_symbol_ptr)/(float)(end_symbol_ptr-start_symbol_ptr);
 
 jump_loc:
+    end_phase(SCORING_PHASE);
 
     if (num_candidates) {
       fprintf(stderr,"Common prefix scan 0 - %x, score[0 - %hu] = %.5f - %.5f\n",
@@ -2371,128 +2518,25 @@ jump_loc:
       }
 
       // scan the data, following prefix tree
+      end_phase(CANDIDATES_PHASE);
       fprintf(stderr,"Overlap search\r");
 
-      uint32_t prior_match_score_number[MAX_PRIOR_MATCHES];
-      uint32_t *prior_match_end_ptr[MAX_PRIOR_MATCHES]; 
-      uint32_t num_prior_matches = 0;
-      in_symbol_ptr = start_symbol_ptr;
-      size_t block_size = (end_symbol_ptr - start_symbol_ptr) / 8;
-      uint32_t * block_ptr = start_symbol_ptr + block_size;
-      stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-
-      if (stop_symbol_ptr > end_symbol_ptr)
-        stop_symbol_ptr = end_symbol_ptr;
-      overlap_check_data[0].start_symbol_ptr = block_ptr;
-      block_ptr += block_size;
-      overlap_check_data[0].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-      overlap_check_data[1].start_symbol_ptr = block_ptr;
-      block_ptr += block_size;
-      overlap_check_data[1].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-      overlap_check_data[2].start_symbol_ptr = block_ptr;
-      block_ptr += block_size;
-      overlap_check_data[2].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-      overlap_check_data[3].start_symbol_ptr = block_ptr;
-      block_ptr += block_size;
-      overlap_check_data[3].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-      overlap_check_data[4].start_symbol_ptr = block_ptr;
-      block_ptr += block_size;
-      overlap_check_data[4].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-      overlap_check_data[5].start_symbol_ptr = block_ptr;
-      block_ptr += block_size;
-      overlap_check_data[5].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
-      overlap_check_data[6].start_symbol_ptr = block_ptr;
-      overlap_check_data[6].stop_symbol_ptr = end_symbol_ptr;
-      i1 = 5;
-      while (overlap_check_data[i1].stop_symbol_ptr > end_symbol_ptr) {
-        overlap_check_data[i1].stop_symbol_ptr = end_symbol_ptr;
-        if (i1-- == 0)
-          break;
-      }
-
-      for (i1 = 0 ; i1 < 7 ; i1++)
-        pthread_create(&overlap_check_threads[i1],NULL,overlap_check_thread,(char *)&overlap_check_data[i1]);
-
-      uint8_t found_same_score_prior_match;
-      uint32_t prior_match_number;
-
-main_overlap_check_loop_no_match:
-      if (in_symbol_ptr == stop_symbol_ptr)
-        goto main_overlap_check_loop_end;
-      this_symbol = *in_symbol_ptr++;
-      if ((int)this_symbol < 0)
-        goto main_overlap_check_loop_no_match;
-      if (match_nodes[this_symbol].num_symbols == 0)
-        goto main_overlap_check_loop_no_match;
-      match_node_ptr = &match_nodes[this_symbol];
-
-main_overlap_check_loop_match:
-      if (in_symbol_ptr == stop_symbol_ptr)
-        goto main_overlap_check_loop_end;
-      this_symbol = *in_symbol_ptr++;
-      if ((int)this_symbol < 0)
-        goto main_overlap_check_loop_no_match;
-
-      match_node_ptr = match_node_ptr->child_ptr;
-      if (this_symbol != match_node_ptr->symbol) {
-        uint32_t shifted_symbol = this_symbol;
-        do {
-          if (match_node_ptr->sibling_node_num[shifted_symbol & 0xF] != 0) {
-            match_node_ptr = &match_nodes[match_node_ptr->sibling_node_num[shifted_symbol & 0xF]];
-            shifted_symbol = shifted_symbol >> 4;
-          }
-          else {
-            if (match_node_ptr->miss_ptr == 0) {
-              if (match_nodes[this_symbol].num_symbols == 0)
-                goto main_overlap_check_loop_no_match;
-              match_node_ptr = &match_nodes[this_symbol];
-              goto main_overlap_check_loop_match;
-            }
-            else {
-              match_node_ptr = match_node_ptr->miss_ptr;
-              shifted_symbol = this_symbol;
-            }
-          }
-        } while (this_symbol != match_node_ptr->symbol);
-      }
-      if (match_node_ptr->child_ptr)
-        goto main_overlap_check_loop_match;
-
-      // no child, so found a match - check for overlaps
-      found_same_score_prior_match = 0;
-      prior_match_number = 0;
-      node_score_number = match_node_ptr->score_number;
-      while (prior_match_number < num_prior_matches) {
-        if (in_symbol_ptr - candidates[candidates_index[node_score_number]].num_symbols
-            > prior_match_end_ptr[prior_match_number]) {
-          num_prior_matches--;
-          for (i2 = prior_match_number ; i2 < num_prior_matches ; i2++) {
-            prior_match_end_ptr[i2] = prior_match_end_ptr[i2+1];
-            prior_match_score_number[i2] = prior_match_score_number[i2+1];
-          }
-        }
-        else { // overlapping symbol substitution strings, so invalidate the lower score
-          if (prior_match_score_number[prior_match_number] > node_score_number)
-            candidate_bad[prior_match_score_number[prior_match_number]] = 1;
-          else if (prior_match_score_number[prior_match_number] != node_score_number)
-            candidate_bad[node_score_number] = 1;
-          else
-            found_same_score_prior_match = 1;
-          prior_match_number++;
-        }
-      }
-      match_node_ptr = match_node_ptr->hit_ptr;
-      if (found_same_score_prior_match == 0) {
-        prior_match_end_ptr[num_prior_matches] = in_symbol_ptr - 1;
-        prior_match_score_number[num_prior_matches++] = node_score_number;
+      size_t block_size = (end_symbol_ptr - start_symbol_ptr) / NUM_OVERLAP_CHECK_CHUNKS;
+      uint32_t * block_ptr = start_symbol_ptr;
+      for (i1 = 0 ; i1 < NUM_OVERLAP_CHECK_CHUNKS ; i1++) {
+        overlap_check_data[i1].start_symbol_ptr = block_ptr;
+        block_ptr += block_size;
+        overlap_check_data[i1].stop_symbol_ptr = block_ptr + MAX_STRING_LENGTH;
+        if (overlap_check_data[i1].stop_symbol_ptr > end_symbol_ptr)
+          overlap_check_data[i1].stop_symbol_ptr = end_symbol_ptr;
       }
-      if (match_node_ptr == 0)
-        goto main_overlap_check_loop_no_match;
-      else
-        goto main_overlap_check_loop_match;
+      overlap_check_data[NUM_OVERLAP_CHECK_CHUNKS - 1].stop_symbol_ptr = end_symbol_ptr;
 
-main_overlap_check_loop_end:
-      for (i1 = 0 ; i1 < 7 ; i1++)
+      atomic_store_explicit(&overlap_check_next_chunk, 0, memory_order_relaxed);
+      for (i1 = 1 ; i1 < num_overlap_check_threads ; i1++)
+        pthread_create(&overlap_check_threads[i1],NULL,overlap_check_worker,NULL);
+      overlap_check_worker(NULL);
+      for (i1 = 1 ; i1 < num_overlap_check_threads ; i1++)
         pthread_join(overlap_check_threads[i1],NULL);
 
       max_string_length = 0;
@@ -2600,36 +2644,31 @@ main_overlap_check_loop_end:
         i1++;
       }
 
+      end_phase(OVERLAP_CHECK_PHASE);
       fprintf(stderr,"Replacing data with new dictionary symbols\r");
       // scan the data following the prefix tree and substitute new symbols on end matches (child is 0)
-      if (end_symbol_ptr - start_symbol_ptr >= 1000000) {
-        stop_symbol_ptr = start_symbol_ptr + ((end_symbol_ptr - start_symbol_ptr) >> 3);
-        find_substitutions_data[0].start_symbol_ptr = stop_symbol_ptr;
-        block_size = (end_symbol_ptr - start_symbol_ptr) / 7;
-        block_ptr = stop_symbol_ptr + block_size;
-        find_substitutions_data[0].stop_symbol_ptr = block_ptr;
-        find_substitutions_data[1].start_symbol_ptr = block_ptr;
-        block_ptr += block_size;
-        find_substitutions_data[1].stop_symbol_ptr = block_ptr;
-        find_substitutions_data[2].start_symbol_ptr = block_ptr;
-        block_ptr += block_size;
-        find_substitutions_data[2].stop_symbol_ptr = block_ptr;
-        find_substitutions_data[3].start_symbol_ptr = block_ptr;
-        block_ptr += block_size;
-        find_substitutions_data[3].stop_symbol_ptr = block_ptr;
-        find_substitutions_data[4].start_symbol_ptr = block_ptr;
-        block_ptr += block_size;
-        find_substitutions_data[4].stop_symbol_ptr = block_ptr;
-        find_substitutions_data[5].start_symbol_ptr = block_ptr;
-        find_substitutions_data[5].stop_symbol_ptr = end_symbol_ptr;
-        for (i1 = 0 ; i1 < 6 ; i1++) {
-          atomic_store_explicit(&find_substitutions_data[i1].done, 0, memory_order_relaxed);
-          atomic_store_explicit(&find_substitutions_data[i1].read_index, 0, memory_order_release);
-          pthread_create(&find_substitutions_threads[i1], NULL, find_substitutions_thread, (char *)&find_substitutions_data[i1]);
-        }
+      if ((end_symbol_ptr - start_symbol_ptr >= 1000000) && num_find_substitutions_threads) {
+        num_find_substitutions_segments = FIND_SUBSTITUTIONS_SEGMENTS_PER_THREAD * num_find_substitutions_threads;
+        block_size = (end_symbol_ptr - start_symbol_ptr) / (num_find_substitutions_segments + 1);
+        stop_symbol_ptr = start_symbol_ptr + block_size;
+        block_ptr = stop_symbol_ptr;
+        for (i1 = 0 ; i1 < num_find_substitutions_segments ; i1++) {
+          find_substitutions_segment_ptrs[i1] = block_ptr;
+          block_ptr += block_size;
+        }
+        find_substitutions_segment_ptrs[num_find_substitutions_segments] = end_symbol_ptr;
+        atomic_store_explicit(&find_substitutions_next_segment, 0, memory_order_relaxed);
+        for (i1 = 0 ; i1 < num_find_substitutions_threads ; i1++) {
+          atomic_store_explicit(&find_substitutions_data[i1].active_segment, 0, memory_order_relaxed);
+          atomic_store_explicit(&find_substitutions_data[i1].free_segment, i1, memory_order_release);
+        }
+        for (i1 = 0 ; i1 < num_find_substitutions_threads ; i1++)
+          pthread_create(&find_substitutions_threads[i1], NULL, find_substitutions_worker, NULL);
       }
-      else
+      else {
+        num_find_substitutions_segments = 0;
         stop_symbol_ptr = end_symbol_ptr;
+      }
 
       uint32_t extra_match_symbols = 0;
       uint16_t substitute_index = 0;
@@ -2829,41 +2868,44 @@ main_symbol_substitution_loop_end:
       }
       atomic_store_explicit(&substitute_data_write_index, substitute_index, memory_order_release);
 
-      if (end_symbol_ptr - start_symbol_ptr >= 1000000) {
-        for (i1 = 0 ; i1 < 6 ; i1++) {
+      if (num_find_substitutions_segments) {
+        for (i1 = 0 ; i1 < num_find_substitutions_segments ; i1++) {
+          struct find_substitutions_data * thread_data_ptr
+              = &find_substitutions_data[i1 % num_find_substitutions_threads];
           uint32_t local_substitutions_write_index;
           uint32_t substitutions_index = 0;
+          uint8_t restarted = 0;
 
+          while (atomic_load_explicit(&thread_data_ptr->active_segment, memory_order_acquire) != i1 + 1) /* wait */ ;
           if (extra_match_symbols != 0) {
-            while ((local_substitutions_write_index = atomic_load_explicit(&find_substitutions_data[i1].write_index,
+            while ((local_substitutions_write_index = atomic_load_explicit(&thread_data_ptr->write_index,
                 memory_order_acquire)) == 0) /* wait */ ;
-            if (((int)find_substitutions_data[i1].data[0] >= (int)extra_match_symbols)) {
-              if (find_substitutions_data[i1].data[0] > extra_match_symbols)
-                find_substitutions_data[i1].data[0] -= extra_match_symbols;
+            if (((int)thread_data_ptr->data[0] >= (int)extra_match_symbols)) {
+              if (thread_data_ptr->data[0] > extra_match_symbols)
+                thread_data_ptr->data[0] -= extra_match_symbols;
               else
                 substitutions_index = 1;
             }
             else {
-              while (atomic_load_explicit(&find_substitutions_data[i1].done, memory_order_acquire) == 0) {
-                substitutions_index = atomic_load_explicit(&find_substitutions_data[i1].write_index, memory_order_relaxed);
-                atomic_store_explicit(&find_substitutions_data[i1].read_index, substitutions_index, memory_order_relaxed);
+              while (atomic_load_explicit(&thread_data_ptr->done, memory_order_acquire) == 0) {
+                substitutions_index = atomic_load_explicit(&thread_data_ptr->write_index, memory_order_relaxed);
+                atomic_store_explicit(&thread_data_ptr->read_index, substitutions_index, memory_order_relaxed);
               }
-              pthread_join(find_substitutions_threads[i1],NULL);
               substitutions_index = 0;
               local_substitutions_write_index = 0;
-              find_substitutions_data[i1].start_symbol_ptr += extra_match_symbols;
-              atomic_store_explicit(&find_substitutions_data[i1].done, 0, memory_order_relaxed);
-              atomic_store_explicit(&find_substitutions_data[i1].write_index, 0, memory_order_release);
-              pthread_create(&find_substitutions_threads[i1],NULL,find_substitutions_thread,
-                  (char *)&find_substitutions_data[i1]);
+              thread_data_ptr->start_symbol_ptr += extra_match_symbols;
+              atomic_store_explicit(&thread_data_ptr->done, 0, memory_order_relaxed);
+              atomic_store_explicit(&thread_data_ptr->write_index, 0, memory_order_release);
+              pthread_create(&find_substitutions_restart_thread,NULL,find_substitutions_thread,(char *)thread_data_ptr);
+              restarted = 1;
             }
             extra_match_symbols = 0;
           }
 
-          while ((atomic_load_explicit(&find_substitutions_data[i1].done, memory_order_acquire) == 0)
-              || (substitutions_index != atomic_load_explicit(&find_substitutions_data[i1].write_index, memory_order_acquire))) {
+          while ((atomic_load_explicit(&thread_data_ptr->done, memory_order_acquire) == 0)
+              || (substitutions_index != atomic_load_explicit(&thread_data_ptr->write_index, memory_order_acquire))) {
             local_substitutions_write_index
-                = atomic_load_explicit(&find_substitutions_data[i1].write_index, memory_order_acquire);
+                = atomic_load_explicit(&thread_data_ptr->write_index, memory_order_acquire);
             if (substitutions_index != local_substitutions_write_index) {
               if (((local_substitutions_write_index - substitutions_index) & 0x3FFFFF) >= 0x40) {
                 do {
@@ -2872,7 +2914,7 @@ main_symbol_substitution_loop_end:
                         >= 0x7FC1) /* wait */ ;
                   uint32_t end_substitutions_index = (substitutions_index + 0x40) & 0x3FFFFF;
                   do {
-                    substitute_data[substitute_index++] = find_substitutions_data[i1].data[substitutions_index];
+                    substitute_data[substitute_index++] = thread_data_ptr->data[substitutions_index];
                     substitutions_index = (substitutions_index + 1) & 0x3FFFFF;
                   } while (substitutions_index != end_substitutions_index);
                   atomic_store_explicit(&substitute_data_write_index, substitute_index, memory_order_release);
@@ -2884,16 +2926,20 @@ main_symbol_substitution_loop_end:
                   while ((uint16_t)(substitute_index - atomic_load_explicit(&substitute_data_read_index, memory_order_acquire))
                       >= 0x8000) /* wait */ ;
                 }
-                substitute_data[substitute_index++] = find_substitutions_data[i1].data[substitutions_index];
+                substitute_data[substitute_index++] = thread_data_ptr->data[substitutions_index];
                 substitutions_index = (substitutions_index + 1) & 0x3FFFFF;
                 atomic_store_explicit(&substitute_data_write_index, substitute_index, memory_order_release);
               }
             }
-            atomic_store_explicit(&find_substitutions_data[i1].read_index, substitutions_index, memory_order_release);
+            atomic_store_explicit(&thread_data_ptr->read_index, substitutions_index, memory_order_release);
           }
-          pthread_join(find_substitutions_threads[i1], NULL);
-          extra_match_symbols += find_substitutions_data[i1].extra_match_symbols;
+          if (restarted)
+            pthread_join(find_substitutions_restart_thread, NULL);
+          extra_match_symbols += thread_data_ptr->extra_match_symbols;
+          atomic_store_explicit(&thread_data_ptr->free_segment, i1 + num_find_substitutions_threads, memory_order_release);
         }
+        for (i1 = 0 ; i1 < num_find_substitutions_threads ; i1++)
+          pthread_join(find_substitutions_threads[i1], NULL);
       }
       if ((substitute_index & 0x7FFF) == 0)
         while (substitute_index != (uint16_t)atomic_load_explicit(&substitute_data_read_index, memory_order_acquire)) /* wait */ ;
@@ -2921,6 +2967,7 @@ main_symbol_substitution_loop_end:
       end_symbol_ptr = out_symbol_ptr;
       *end_symbol_ptr = 0xFFFFFFFE;
       free_RAM_ptr = (uint8_t *)(end_symbol_ptr + 1);
+      end_phase(SUBSTITUTION_PHASE);
     }
 
     if (num_candidates) {
@@ -3058,8 +3105,46 @@ write_file:
     fwrite(write_ptr,1,char_buffer+in_size-write_ptr,fd_out);
   }
   fclose(fd_out);
+  if (malloc_count_peak() > max_peak)
+    max_peak = malloc_count_peak();
   free(start_symbol_ptr);
+  gcx_probe_stop(&probe);
+  double wall_duration = probe.wall;
   fprintf(stderr,"%u grammar productions created in %0.3f seconds.\n",
       num_compound_symbols,(float)(clock()-start_time)/CLOCKS_PER_SEC);
+  fprintf(stderr,"Wall time %0.3f seconds with %u threads:",wall_duration,(unsigned int)num_threads);
+  for (i1 = 0 ; i1 < NUM_PHASES ; i1++)
+    fprintf(stderr," %s %0.3f%s",phase_names[i1],phase_time[i1],(i1 + 1 < NUM_PHASES) ? "," : "\n");
+
+  //gcx
+  if (file_report_gcx != 0) {
+    size_t max_stack = 0;
+    for (i1 = 0 ; i1 < NUM_PHASES ; i1++)
+      if (phase_stack[i1] > max_stack)
+        max_stack = phase_stack[i1];
+    // the phases reset the malloc_count and RSS peaks, so the probe only keeps the maximum of theirs
+    probe.peak = (long long)max_peak;
+    if (max_peak_rss > probe.peak_rss)
+      probe.peak_rss = max_peak_rss;
+    probe.stack = (long long)max_stack;
+    if (!gcx_probe_report(file_report_gcx, &probe)) {
+      fprintf(stderr,"Error opening file %s\n",file_report_gcx);
+      exit(EXIT_FAILURE);
+    }
+    gcx_probe_record(&probe, "GLZAcompress", "compression");
+  }
+  if (file_phase_report_gcx != 0) {
+    FILE *report_gcx = fopen(file_phase_report_gcx, "a");
+    if (report_gcx == NULL) {
+      fprintf(stderr,"Error opening file %s\n",file_phase_report_gcx);
+      exit(EXIT_FAILURE);
+    }
+    for (i1 = 0 ; i1 < NUM_PHASES ; i1++)
+      fprintf(report_gcx,"%s|%s|%5.4lf|%5.4lf|%llu|%llu|%lld\n",in_file_name,phase_names[i1],phase_time[i1],
+          phase_cpu_time[i1],(unsigned long long)phase_peak[i1],(unsigned long long)phase_stack[i1],
+          phase_peak_rss[i1]);
+    fclose(report_gcx);
+  }
+  //fim do relatório gcx
   return(0);
 }
\ No newline at end of file
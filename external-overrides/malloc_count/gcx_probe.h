@@ -0,0 +1,152 @@
+/******************************************************************************
+ * gcx_probe.h
+ *
+ * Measurement shared by the report hooks of every tool (to gcx). One probe
+ * brackets one operation (compression, decompression or extraction) and
+ * records:
+ *
+ *   wall      seconds on the monotonic clock
+ *   cpu       user + system seconds of the process, all threads included
+ *   peak      malloc_count heap peak, in bytes
+ *   stack     stack_count usage, in bytes
+ *   peak_rss  resident set peak (VmHWM), in bytes
+ *
+ * and appends them to a gcx report as "peak|stack|wall|cpu|peak_rss|", and
+ * with gcx_probe_record() as a record of gcx_record.h.
+ *
+ * Tools that are not linked with malloc_count define GCX_PROBE_NO_MALLOC_COUNT
+ * before including this file; their peak and stack are written as 0.
+ *
+ * The peak RSS is reset at gcx_probe_start() through /proc/self/clear_refs
+ * (Linux); elsewhere it is the peak of the whole process.
+ ******************************************************************************/
+
+#ifndef GCX_PROBE_H
+#define GCX_PROBE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "gcx_record.h"
+
+#ifndef GCX_PROBE_NO_MALLOC_COUNT
+#include "malloc_count.h"
+#include "stack_count.h"
+#endif
+
+typedef struct gcx_probe {
+    double wall;
+    double cpu;
+    long long peak;
+    long long stack;
+    long long peak_rss;
+
+    double wall_start;
+    double cpu_start;
+    void *stack_base;
+} gcx_probe;
+
+static inline double gcx_probe_wall(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static inline double gcx_probe_cpu(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)
+        + (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static inline void gcx_probe_reset_peak_rss(void)
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f != NULL) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+static inline long long gcx_probe_peak_rss(void)
+{
+    struct rusage ru;
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f != NULL) {
+        char line[256];
+        long long kb;
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (sscanf(line, "VmHWM: %lld kB", &kb) == 1) {
+                fclose(f);
+                return kb << 10;
+            }
+        }
+        fclose(f);
+    }
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return (long long)ru.ru_maxrss;
+#else
+    return (long long)ru.ru_maxrss << 10;
+#endif
+}
+
+static inline void gcx_probe_start(gcx_probe *p)
+{
+    memset(p, 0, sizeof(*p));
+    /* before the malloc_count reset, so that its FILE is not counted */
+    gcx_probe_reset_peak_rss();
+#ifndef GCX_PROBE_NO_MALLOC_COUNT
+    malloc_count_reset_peak();
+    p->stack_base = stack_count_clear();
+#endif
+    p->cpu_start = gcx_probe_cpu();
+    p->wall_start = gcx_probe_wall();
+}
+
+static inline void gcx_probe_stop(gcx_probe *p)
+{
+    p->wall = gcx_probe_wall() - p->wall_start;
+    p->cpu = gcx_probe_cpu() - p->cpu_start;
+#ifndef GCX_PROBE_NO_MALLOC_COUNT
+    p->peak = (long long)malloc_count_peak();
+    p->stack = (long long)stack_count_usage(p->stack_base);
+#endif
+    p->peak_rss = gcx_probe_peak_rss();
+}
+
+/* Appends "peak|stack|wall|cpu|peak_rss|" to the report. Returns 0 if the
+ * report can not be opened. */
+static inline int gcx_probe_report(const char *file_report_gcx, const gcx_probe *p)
+{
+    FILE *report = fopen(file_report_gcx, "a");
+    if (report == NULL)
+        return 0;
+    fprintf(report, "%lld|%lld|%5.4lf|%5.4lf|%lld|",
+            p->peak, p->stack, p->wall, p->cpu, p->peak_rss);
+    fclose(report);
+    printf("Time inserted into the GCX report: %5.4lf (cpu %5.4lf)\n", p->wall, p->cpu);
+    return 1;
+}
+
+/* Appends a record of the probe for the phase (compression, decompression,
+ * extraction...) of tool to $GCX_RECORDS. Returns 0 if it can not be
+ * written. */
+static inline int gcx_probe_record(const gcx_probe *p, const char *tool, const char *phase)
+{
+    gcx_record r;
+    gcx_record_begin(&r, tool, phase, NULL, NULL, NULL);
+    gcx_record_double(&r, "wall", p->wall);
+    gcx_record_double(&r, "cpu", p->cpu);
+    gcx_record_int(&r, "peak", p->peak);
+    gcx_record_int(&r, "stack", p->stack);
+    gcx_record_int(&r, "peak_rss", p->peak_rss);
+    return gcx_record_write(&r);
+}
+
+#endif /* GCX_PROBE_H */
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * gcx_record.h
+ *
+ * Self-describing result records (to gcx). A record is one JSON object per
+ * line of a JSONL file:
+ *
+ *   {"tool":"bzip2","phase":"compression","file":"...","algorithm":"bzip2-t4",
+ *    "params":{"threads":"4"},"host":"...","git_rev":"...","pid":123,
+ *    "unix_time":1700000000,"metrics":{"wall":1.25,"cpu":4.8,...}}
+ *
+ * and is appended with a single write() on an O_APPEND descriptor, so records
+ * of concurrent processes never interleave and a record is either complete
+ * or absent. scripts/records_to_csv.py turns the records into the reports of
+ * scripts/graphs.
+ *
+ * What the tool does not pass to gcx_record_begin() (NULL) is taken from the
+ * environment, set by measure_compression.sh for each run:
+ *
+ *   GCX_RECORDS           path of the JSONL file; unset, nothing is written
+ *   GCX_RECORD_FILE       file of the dataset
+ *   GCX_RECORD_ALGORITHM  algorithm column of the report row
+ *   GCX_RECORD_PARAMS     "key=value,key=value" parameters of the run
+ *   GCX_GIT_REV           commit of the benchmark
+ *
+ * Usage: gcx_record_begin(), any gcx_record_int()/gcx_record_double(), then
+ * gcx_record_write(). gcx_probe.h adds gcx_probe_record() on top of it.
+ ******************************************************************************/
+
+#ifndef GCX_RECORD_H
+#define GCX_RECORD_H
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GCX_RECORD_MAX 4096
+
+typedef struct gcx_record {
+    char buf[GCX_RECORD_MAX];
+    size_t len;
+    int metrics;  /* metrics written so far */
+    int overflow; /* the record did not fit in buf */
+} gcx_record;
+
+static inline void gcx_record_append(gcx_record *r, const char *format, ...)
+{
+    va_list args;
+    int n;
+    if (r->overflow)
+        return;
+    va_start(args, format);
+    n = vsnprintf(r->buf + r->len, GCX_RECORD_MAX - r->len, format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= GCX_RECORD_MAX - r->len)
+        r->overflow = 1;
+    else
+        r->len += (size_t)n;
+}
+
+/* appends s as a JSON string, or null */
+static inline void gcx_record_string(gcx_record *r, const char *s, size_t n)
+{
+    size_t i;
+    if (s == NULL) {
+        gcx_record_append(r, "null");
+        return;
+    }
+    gcx_record_append(r, "\"");
+    for (i = 0; i < n && s[i] != '\0'; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+            gcx_record_append(r, "\\%c", c);
+        else if (c < 0x20)
+            gcx_record_append(r, "\\u%04x", c);
+        else
+            gcx_record_append(r, "%c", c);
+    }
+    gcx_record_append(r, "\"");
+}
+
+static inline void gcx_record_field(gcx_record *r, const char *key, const char *value)
+{
+    gcx_record_append(r, ",\"%s\":", key);
+    gcx_record_string(r, value, value == NULL ? 0 : strlen(value));
+}
+
+/* GCX_RECORD_PARAMS as an object of strings */
+static inline void gcx_record_params(gcx_record *r, const char *params)
+{
+    const char *p = params, *end, *eq;
+    int first = 1;
+    gcx_record_append(r, ",\"params\":{");
+    while (p != NULL && *p != '\0') {
+        end = strchr(p, ',');
+        if (end == NULL)
+            end = p + strlen(p);
+        eq = (const char *)memchr(p, '=', (size_t)(end - p));
+        if (eq != NULL && eq > p) {
+            if (!first)
+                gcx_record_append(r, ",");
+            gcx_record_string(r, p, (size_t)(eq - p));
+            gcx_record_append(r, ":");
+            gcx_record_string(r, eq + 1, (size_t)(end - eq - 1));
+            first = 0;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    gcx_record_append(r, "}");
+}
+
+/* file, algorithm and params may be NULL, to take them from the environment */
+static inline void gcx_record_begin(gcx_record *r, const char *tool, const char *phase,
+                                    const char *file, const char *algorithm,
+                                    const char *params)
+{
+    char host[256];
+    r->len = 0;
+    r->metrics = 0;
+    r->overflow = 0;
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "unknown");
+    host[sizeof(host) - 1] = '\0';
+
+    gcx_record_append(r, "{\"tool\":");
+    gcx_record_string(r, tool, strlen(tool));
+    gcx_record_field(r, "phase", phase);
+    gcx_record_field(r, "file", file != NULL ? file : getenv("GCX_RECORD_FILE"));
+    gcx_record_field(r, "algorithm",
+                     algorithm != NULL ? algorithm : getenv("GCX_RECORD_ALGORITHM"));
+    gcx_record_params(r, params != NULL ? params : getenv("GCX_RECORD_PARAMS"));
+    gcx_record_field(r, "host", host);
+    gcx_record_field(r, "git_rev", getenv("GCX_GIT_REV"));
+    gcx_record_append(r, ",\"pid\":%ld,\"unix_time\":%lld,\"metrics\":{",
+                      (long)getpid(), (long long)time(NULL));
+}
+
+static inline void gcx_record_int(gcx_record *r, const char *key, long long value)
+{
+    gcx_record_append(r, "%s\"%s\":%lld", r->metrics++ ? "," : "", key, value);
+}
+
+static inline void gcx_record_double(gcx_record *r, const char *key, double value)
+{
+    gcx_record_append(r, "%s\"%s\":%.6f", r->metrics++ ? "," : "", key, value);
+}
+
+/* Appends the record to $GCX_RECORDS. Returns 0 if it could not be written,
+ * 1 otherwise (also when GCX_RECORDS is not set). */
+static inline int gcx_record_write(gcx_record *r)
+{
+    const char *path = getenv("GCX_RECORDS");
+    int fd;
+    ssize_t written;
+    if (path == NULL || *path == '\0')
+        return 1;
+    gcx_record_append(r, "}}\n");
+    if (r->overflow) {
+        fprintf(stderr, "gcx record longer than %d bytes, not written\n", GCX_RECORD_MAX);
+        return 0;
+    }
+    fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 0;
+    }
+    written = write(fd, r->buf, r->len);
+    close(fd);
+    return written == (ssize_t)r->len;
+}
+
+#endif /* GCX_RECORD_H */
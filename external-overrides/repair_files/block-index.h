@@ -0,0 +1,65 @@
+/**************************************************************************
+**  Re-Pair / Des-Pair
+**  Compressor and decompressor based on recursive pairing.
+**  
+**  Version N/A (On Github) -- November 13, 2015
+**  
+**  Copyright (C) 2003, 2007, 2015 by Raymond Wan, All rights reserved.
+**  Contact:  rwan.work@gmail.com
+**  Organization:  Division of Life Science, Faculty of Science, Hong Kong
+**                 University of Science and Technology, Hong Kong
+**  
+**  This file is part of Re-Pair / Des-Pair.
+**  
+**  Re-Pair / Des-Pair is free software; you can redistribute it and/or 
+**  modify it under the terms of the GNU General Public License 
+**  as published by the Free Software Foundation; either version 
+**  3 of the License, or (at your option) any later version.
+**  
+**  Re-Pair / Des-Pair is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**  
+**  You should have received a copy of the GNU General Public 
+**  License along with Re-Pair / Des-Pair; if not, see 
+**  <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#ifndef BLOCK_INDEX_H
+#define BLOCK_INDEX_H
+
+/*
+**  Block index (<filename>.idx), written by Re-Pair with -I and read by
+**  Des-Pair when present.
+**
+**  The file starts with BLOCK_INDEX_MAGIC and a BLOCK_INDEX_HEADER, and
+**  is followed by one BLOCK_INDEX_ENTRY per block, in block order.  With
+**  -I, Re-Pair flushes the prelude at the end of every block, so each
+**  block's prelude starts on a byte boundary and can be decoded on its
+**  own.  That padding also means that -I output can only be decoded with
+**  its index.
+**
+**  The header holds the sizes of the .prel and .seq files the index was
+**  written with; Des-Pair refuses an index that does not match them (a
+**  stale index of an earlier run).  Re-Pair without -I removes the index.
+*/
+#define BLOCK_INDEX_MAGIC "RPBIDX2"
+#define BLOCK_INDEX_MAGIC_SIZE 8
+#define BLOCK_INDEX_SUFFIX ".idx"
+
+typedef struct block_index_header {
+  R_ULL_INT prel_size;                  /*  Size of <filename>.prel in bytes  */
+  R_ULL_INT seq_size;                    /*  Size of <filename>.seq in bytes  */
+} BLOCK_INDEX_HEADER;
+
+typedef struct block_index_entry {
+  R_ULL_INT prel_offset;      /*  Byte offset of the block in the prelude  */
+  R_ULL_INT seq_offset;      /*  Byte offset of the block in the sequence  */
+  R_ULL_INT out_offset;
+                   /*  Offset of the block's first symbol in the output  */
+  R_ULL_INT out_length;         /*  Number of symbols the block expands to  */
+} BLOCK_INDEX_ENTRY;
+
+#endif
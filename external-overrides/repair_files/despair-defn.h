@@ -30,12 +30,15 @@
 #ifndef DESPAIR_DEFN_H
 #define DESPAIR_DEFN_H
 
+#include <pthread.h>                          /*  pthread_mutex_t, etc.  */
+
 /******************************
 Forward declaration of important structures defined in other files
 ******************************/
 struct gennode;
 struct bitinrec;                                          /*  bitinput.h  */
 struct pair;                                               /*  despair.h  */
+struct block_index_entry;                              /*  block-index.h  */
 
 /******************************
 Definitions
@@ -58,6 +61,8 @@ typedef struct args_info {
   R_CHAR *base_filename;
   R_CHAR *gcx_report_filename;
   R_UINT base_datatype;
+  R_ULL_INT max_expand_bytes;
+  R_UINT num_threads;
 
   R_BOOLEAN apply_split;
   R_BOOLEAN verbose_level;
@@ -75,6 +80,9 @@ typedef struct prog_info {
   R_CHAR *progname;                                     /*  Program name  */
 
   FILE *out_file;                                        /*  Output file  */
+  R_INT out_fd;
+        /*  If not -1, output goes here with pwrite at out_offset instead  */
+  R_ULL_INT out_offset;                   /*  Byte offset for the next pwrite  */
   FILE *seq_file;                                /*  Input sequence file  */
   FILE **seq_file_list;
   FILE *prel_file;                                /*  Input prelude file  */
@@ -101,6 +109,13 @@ typedef struct prog_info {
   */
   R_BOOLEAN apply_split;
   R_BOOLEAN verbose_level;
+  R_ULL_INT max_expand_bytes;
+        /*  Cap on the expansion arena (FAVOUR_TIME_EXPAND); 0 = no cap  */
+  R_UINT num_threads;                      /*  Decoders used with an index  */
+
+  struct block_index_entry *block_index;
+                              /*  Contents of <filename>.idx, or NULL  */
+  R_UINT num_index_blocks;
 
   /*
   **  Statistics collected in the Despair process across all blocks
@@ -131,6 +146,11 @@ typedef struct block_info {
   R_UINT *out_buf_end;
   R_UINT *out_buf_p;
 
+  R_UINT *expand_arena;
+       /*  Expansions of all phrases, in generation order (FAVOUR_TIME_EXPAND)  */
+  R_ULL_INT expand_arena_size;
+                          /*  Number of symbols stored in expand_arena  */
+
   /*
   **  Statistics collected in the Despair process for the current block
   */
@@ -146,6 +166,25 @@ typedef struct block_info {
   R_UINT max_longest_phrase_length;
 
 } BLOCK_INFO;
+
+
+/*
+**  Shared state of the indexed decoder.  Workers claim blocks in order
+**  through next_block, which is protected by lock.
+*/
+typedef struct decode_info {
+  PROG_INFO *prog_struct;
+  R_UINT next_block;
+  pthread_mutex_t lock;
+} DECODE_INFO;
+
+
+typedef struct decoder_info {
+  DECODE_INFO *decode_struct;
+  PROG_INFO prog_struct;
+              /*  Private copy with its own files, buffers and statistics  */
+  BLOCK_INFO block_struct;
+} DECODER_INFO;
     
 
 #endif
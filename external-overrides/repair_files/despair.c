@@ -32,6 +32,10 @@
 #include <stdlib.h>
 #include <limits.h>                   /*  UINT_MAX, UCHAR_MAX, USHRT_MAX  */
 #include <getopt.h>                                           /*  getopt  */
+#include <errno.h>
+#include <unistd.h>                                           /*  pwrite  */
+#include <pthread.h>
+#include <sys/stat.h>                                         /*  fstat  */
 
 #include "common-def.h"
 #include "wmalloc.h"
@@ -40,6 +44,7 @@
 #include "despair.h"
 #include "bitin.h"
 #include "phrase-slide-decode.h"
+#include "block-index.h"
 
 static void usage (ARGS_INFO *args_info);
 static void intDecodeHierarchy (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, R_UINT a, R_UINT b, R_ULL_INT lo, R_ULL_INT hi);
@@ -48,6 +53,18 @@ static void uninitDespair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_st
 static void executeDespair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
 static void decodeHierarchy_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
 static void decodeSequence_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
+static void writeOutput (PROG_INFO *prog_struct, const void *buf, size_t size, size_t count);
+static void initBlock (BLOCK_INFO *block_struct);
+static FILE *openBaseFile (const R_CHAR *base_filename, const R_CHAR *suffix, const R_CHAR *mode);
+static void readBlockIndex (PROG_INFO *prog_struct);
+static void *decoderDespair_Thread (void *arg);
+static void executeDespair_FileIndexed (PROG_INFO *prog_struct);
+#ifdef FAVOUR_TIME_EXPAND
+static void fillArena (BLOCK_INFO *block_struct, R_UINT x, R_UINT *dst);
+static void buildArena_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
+static void emitSymbols (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, const R_UINT *src, R_UINT len);
+static void emitPhrase (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, R_UINT x);
+#endif
 
 
 static void usage (ARGS_INFO *args_struct) {
@@ -56,6 +73,12 @@ static void usage (ARGS_INFO *args_struct) {
   fprintf (stderr, "Usage:  %s [options]\n\n", args_struct -> progname);
   fprintf (stderr, "Options:\n");
   fprintf (stderr, "-i <file> :  Input filename  [Required]\n");
+#ifdef FAVOUR_TIME_EXPAND
+  fprintf (stderr, "-m <MB>   :  Memory cap on phrase expansions [default:  no cap]\n");
+#endif
+  fprintf (stderr, "-n <num>  :  Decoding threads if <filename.idx> exists [default:  1]\n");
+  fprintf (stderr, "\n<filename.idx> is used whenever it exists; Re-Pair -I output\n");
+  fprintf (stderr, "cannot be decoded without it.\n\n");
   fprintf (stderr, "-t <type> :  Input data type [1 (default), 2, or 4]\n");
   fprintf (stderr, "-v        :  Verbose output\n");
   fprintf (stderr, "Des-Pair version:  %s (%s)\n\n", __DATE__, __TIME__);
@@ -63,6 +86,39 @@ static void usage (ARGS_INFO *args_struct) {
 }
 
 
+/*
+**  Write count items of the given size to the output.  A decoder
+**  working from the block index writes with pwrite at its own offset;
+**  otherwise the output is appended to out_file.
+*/
+static void writeOutput (PROG_INFO *prog_struct, const void *buf, size_t size, size_t count) {
+  const R_UCHAR *src = (const R_UCHAR *) buf;
+  size_t left = size * count;
+  ssize_t written = 0;
+
+  if (prog_struct -> out_fd == -1) {
+    (void) fwrite (buf, size, count, prog_struct -> out_file);
+    return;
+  }
+
+  while (left != 0) {
+    written = pwrite (prog_struct -> out_fd, src, left, (off_t) prog_struct -> out_offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror ("pwrite");
+      exit (EXIT_FAILURE);
+    }
+    src += written;
+    left -= (size_t) written;
+    prog_struct -> out_offset += (R_ULL_INT) written;
+  }
+
+  return;
+}
+
+
 void writeOutputFile (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, R_UINT num) {
   R_UINT i = 0;
   R_UCHAR *temp_c = prog_struct -> out_buf_c;
@@ -78,7 +134,7 @@ void writeOutputFile (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, R_UINT n
       }
       temp_c[i] = (R_UCHAR) src[i];
     }
-    (void) fwrite (temp_c, sizeof (R_UCHAR), (size_t) num, prog_struct -> out_file);
+    writeOutput (prog_struct, temp_c, sizeof (R_UCHAR), (size_t) num);
   }
   else if (prog_struct -> base_datatype == (R_UINT) sizeof (R_USHRT)) {
     for (i = 0; i < num; i++) {
@@ -89,10 +145,10 @@ void writeOutputFile (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, R_UINT n
       }
       temp_s[i] = (R_USHRT) src[i];
     }
-    (void) fwrite (temp_s, sizeof (R_USHRT), (size_t) num, prog_struct -> out_file);
+    writeOutput (prog_struct, temp_s, sizeof (R_USHRT), (size_t) num);
   }
   else {
-    (void) fwrite (src, sizeof (R_UINT), (size_t) num, prog_struct -> out_file);
+    writeOutput (prog_struct, src, sizeof (R_UINT), (size_t) num);
   }
 
   return;
@@ -181,6 +237,12 @@ static void uninitDespair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_st
   }
   block_struct -> phrases_array = NULL;
 
+  if (block_struct -> expand_arena != NULL) {
+    wfree (block_struct -> expand_arena);
+  }
+  block_struct -> expand_arena = NULL;
+  block_struct -> expand_arena_size = 0;
+
   return;
 }
 
@@ -295,29 +357,126 @@ static void decodeHierarchy_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_
 }
 
 
-static void decodeSequence_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
-  R_UINT x = 0;
-  R_UINT bytes_read;
-  R_UINT symbol_count = 0;
-
 #ifdef FAVOUR_TIME_EXPAND
+/*
+**  Write the expansion of phrase x to dst, copying from the arena
+**  where possible and recursing into the children otherwise.
+*/
+static void fillArena (BLOCK_INFO *block_struct, R_UINT x, R_UINT *dst) {
+  PAIR *phrase = &(block_struct -> phrases_array[x]);
+
+  if (phrase -> pos != NULL) {
+    memcpy (dst, phrase -> pos, phrase -> len * sizeof (R_UINT));
+    return;
+  }
+  fillArena (block_struct, phrase -> left, dst);
+  fillArena (block_struct, phrase -> right, dst + block_struct -> phrases_array[phrase -> left].len);
+
+  return;
+}
+
+
+/*
+**  Expand every phrase into one contiguous arena, in generation order,
+**  so that each phrase is an offset (pos) and a length (len) into it.
+**  A phrase only refers to phrases of earlier generations, so its
+**  children are already in the arena when it is reached.
+**
+**  With a cap (-m), phrases are taken greedily in generation order
+**  while they fit; the rest keep pos == NULL and are expanded
+**  recursively by emitPhrase.  Primitives keep the pos set up by
+**  setUnitPrimitives.
+*/
+static void buildArena_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
+  R_UINT total = block_struct -> num_prims + block_struct -> num_phrases;
+  R_ULL_INT cap = prog_struct -> max_expand_bytes / sizeof (R_UINT);
+  R_ULL_INT used = 0;
   R_UINT i = 0;
-  R_UINT j = 0;
-  R_UINT k = 0;
-#endif
+  PAIR *phrase = NULL;
 
-#ifdef FAVOUR_TIME_EXPAND
-  for (; i < (block_struct -> num_prims + block_struct -> num_phrases); i++) {
-    block_struct -> phrases_array[i].len = block_struct -> phrases_array[block_struct -> phrases_array[i].left].len + block_struct -> phrases_array[block_struct -> phrases_array[i].right].len;
-    block_struct -> phrases_array[i].pos = wmalloc (block_struct -> phrases_array[i].len * sizeof (R_UINT));
-    for (j = 0; j < block_struct -> phrases_array[block_struct -> phrases_array[i].left].len; j++) {
-      block_struct -> phrases_array[i].pos[j] = block_struct -> phrases_array[block_struct -> phrases_array[i].left].pos[j];
+  for (i = block_struct -> num_prims; i < total; i++) {
+    phrase = &(block_struct -> phrases_array[i]);
+    phrase -> len = block_struct -> phrases_array[phrase -> left].len + block_struct -> phrases_array[phrase -> right].len;
+    if ((cap == 0) || (used + phrase -> len <= cap)) {
+      used += phrase -> len;
+    }
+  }
+
+  block_struct -> expand_arena_size = used;
+  block_struct -> expand_arena = NULL;
+  if (used != 0) {
+    block_struct -> expand_arena = wmalloc ((size_t) used * sizeof (R_UINT));
+  }
+
+  used = 0;
+  for (i = block_struct -> num_prims; i < total; i++) {
+    phrase = &(block_struct -> phrases_array[i]);
+    if ((cap == 0) || (used + phrase -> len <= cap)) {
+      /*  Children are filled before pos is set, so a phrase never reads
+      **  its own (still empty) slot  */
+      phrase -> pos = NULL;
+      fillArena (block_struct, i, block_struct -> expand_arena + used);
+      phrase -> pos = block_struct -> expand_arena + used;
+      used += phrase -> len;
+    }
+    else {
+      phrase -> pos = NULL;
+    }
+  }
+
+  return;
+}
+
+
+/*
+**  Append len symbols to the output buffer, flushing it to the output
+**  file whenever it fills up.
+*/
+static void emitSymbols (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, const R_UINT *src, R_UINT len) {
+  R_UINT room = 0;
+
+  while (len != 0) {
+    room = (R_UINT) (block_struct -> out_buf_end - block_struct -> out_buf_p);
+    if (room == 0) {
+      writeOutputFile (prog_struct, block_struct, (R_UINT) (block_struct -> out_buf_p - block_struct -> out_buf));
+      block_struct -> out_buf_p = block_struct -> out_buf;
+      continue;
     }
-    for (k = 0; k < block_struct -> phrases_array[block_struct -> phrases_array[i].right].len; k++) {
-      block_struct -> phrases_array[i].pos[j] = block_struct -> phrases_array[block_struct -> phrases_array[i].right].pos[k];
-      j++;
+    if (room > len) {
+      room = len;
     }
+    memcpy (block_struct -> out_buf_p, src, room * sizeof (R_UINT));
+    block_struct -> out_buf_p += room;
+    src += room;
+    len -= room;
   }
+
+  return;
+}
+
+
+static void emitPhrase (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, R_UINT x) {
+  PAIR *phrase = &(block_struct -> phrases_array[x]);
+
+  if (phrase -> pos != NULL) {
+    emitSymbols (prog_struct, block_struct, phrase -> pos, phrase -> len);
+    return;
+  }
+  emitPhrase (prog_struct, block_struct, phrase -> left);
+  emitPhrase (prog_struct, block_struct, phrase -> right);
+
+  return;
+}
+#endif
+
+
+static void decodeSequence_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
+  R_UINT x = 0;
+  R_UINT bytes_read;
+  R_UINT symbol_count = 0;
+
+#ifdef FAVOUR_TIME_EXPAND
+  buildArena_OneBlock (prog_struct, block_struct);
 #endif
 
   while (R_TRUE) {
@@ -347,7 +506,11 @@ static void decodeSequence_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_s
       break;
     }
 
+#ifdef FAVOUR_TIME_EXPAND
+    emitPhrase (prog_struct, block_struct, x);
+#else
     outPhrase (prog_struct, block_struct, x);
+#endif
 
   }
 
@@ -377,7 +540,158 @@ static void displayStats_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_str
   return;
 }
 
+/*
+**  Decode the blocks listed in the block index on num_threads threads.
+**
+**  Every block in the index starts on a byte boundary of the prelude,
+**  so each decoder opens its own prelude and sequence files, seeks to
+**  the block and decodes it as the serial loop would.  The output
+**  offset of every block is known from the index, so decoders write
+**  with pwrite and no ordering between them is needed.
+*/
+static void *decoderDespair_Thread (void *arg) {
+  DECODER_INFO *decoder_struct = (DECODER_INFO *) arg;
+  DECODE_INFO *decode_struct = decoder_struct -> decode_struct;
+  PROG_INFO *prog_struct = &(decoder_struct -> prog_struct);
+  BLOCK_INFO *block_struct = &(decoder_struct -> block_struct);
+  BLOCK_INDEX_ENTRY *entry = NULL;
+  R_UINT i = 0;
+
+  while (R_TRUE) {
+    pthread_mutex_lock (&decode_struct -> lock);
+    i = decode_struct -> next_block++;
+    pthread_mutex_unlock (&decode_struct -> lock);
+    if (i >= prog_struct -> num_index_blocks) {
+      break;
+    }
+    entry = &(prog_struct -> block_index[i]);
+
+    if ((fseek (prog_struct -> prel_file, (long) entry -> prel_offset, SEEK_SET) != 0) ||
+        (fseek (prog_struct -> seq_file, (long) entry -> seq_offset, SEEK_SET) != 0)) {
+      fprintf (stderr, "ERROR:  Seeking to block %u.  %s: %u.\n", i + 1, __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    if (prog_struct -> bit_in_rec != NULL) {
+      wfree ((prog_struct -> bit_in_rec) -> buffer);
+      wfree (prog_struct -> bit_in_rec);
+    }
+    prog_struct -> bit_in_rec = newBitin (prog_struct -> prel_file);
+    prog_struct -> seq_buf_p = prog_struct -> seq_buf;
+    prog_struct -> seq_buf_end = prog_struct -> seq_buf;
+    prog_struct -> out_offset = entry -> out_offset * (R_ULL_INT) prog_struct -> base_datatype;
+
+    /*  initDespair_OneBlock counts this block, giving the same block
+    **  number as in the serial loop  */
+    prog_struct -> total_blocks = i;
+    initDespair_OneBlock (prog_struct, block_struct);
+    executeDespair_OneBlock (prog_struct, block_struct);
+    displayStats_OneBlock (prog_struct, block_struct);
+    /*  Flushes what is left of the block's output  */
+    uninitDespair_OneBlock (prog_struct, block_struct);
+
+    if (prog_struct -> out_offset != (entry -> out_offset + entry -> out_length) * (R_ULL_INT) prog_struct -> base_datatype) {
+      fprintf (stderr, "ERROR:  Block %u does not match its length in the block index.\n", i + 1);
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  return (NULL);
+}
+
+
+static void executeDespair_FileIndexed (PROG_INFO *prog_struct) {
+  DECODE_INFO decode_struct;
+  DECODER_INFO *decoders = NULL;
+  pthread_t *threads = NULL;
+  PROG_INFO *worker_prog = NULL;
+  R_UINT num_decoders = prog_struct -> num_threads;
+  R_UINT i = 0;
+
+  if (num_decoders > prog_struct -> num_index_blocks) {
+    num_decoders = prog_struct -> num_index_blocks;
+  }
+
+  decode_struct.prog_struct = prog_struct;
+  decode_struct.next_block = 0;
+  pthread_mutex_init (&decode_struct.lock, NULL);
+
+  decoders = wmalloc (num_decoders * sizeof (DECODER_INFO));
+  threads = wmalloc (num_decoders * sizeof (pthread_t));
+  for (i = 0; i < num_decoders; i++) {
+    decoders[i].decode_struct = &decode_struct;
+    worker_prog = &(decoders[i].prog_struct);
+    *worker_prog = *prog_struct;
+    worker_prog -> prel_file = openBaseFile (prog_struct -> base_filename, ".prel", "r");
+    worker_prog -> seq_file = openBaseFile (prog_struct -> base_filename, ".seq", "r");
+    worker_prog -> out_file = NULL;
+    worker_prog -> out_fd = fileno (prog_struct -> out_file);
+    worker_prog -> bit_in_rec = NULL;
+    worker_prog -> seq_buf = wmalloc (SEQ_BUF_SIZE * sizeof (R_UINT));
+    worker_prog -> out_buf_c = NULL;
+    worker_prog -> out_buf_s = NULL;
+    if (prog_struct -> base_datatype == (R_UINT) sizeof (R_UCHAR)) {
+      worker_prog -> out_buf_c = wmalloc (sizeof (R_UCHAR) * OUT_BUF_SIZE);
+    }
+    else if (prog_struct -> base_datatype == (R_UINT) sizeof (R_USHRT)) {
+      worker_prog -> out_buf_s = wmalloc (sizeof (R_USHRT) * OUT_BUF_SIZE);
+    }
+    initBlock (&(decoders[i].block_struct));
+  }
+
+  for (i = 0; i < num_decoders; i++) {
+    pthread_create (&threads[i], NULL, decoderDespair_Thread, &decoders[i]);
+  }
+
+  for (i = 0; i < num_decoders; i++) {
+    pthread_join (threads[i], NULL);
+    worker_prog = &(decoders[i].prog_struct);
+
+    /*  Merge the statistics of this decoder  */
+    prog_struct -> total_num_prims += worker_prog -> total_num_prims;
+    prog_struct -> total_num_phrases += worker_prog -> total_num_phrases;
+    prog_struct -> total_num_symbols += worker_prog -> total_num_symbols;
+    if (worker_prog -> maximum_total_num_phrases > prog_struct -> maximum_total_num_phrases) {
+      prog_struct -> maximum_total_num_phrases = worker_prog -> maximum_total_num_phrases;
+    }
+    if (worker_prog -> maximum_generations > prog_struct -> maximum_generations) {
+      prog_struct -> maximum_generations = worker_prog -> maximum_generations;
+    }
+    if (worker_prog -> maximum_primitives > prog_struct -> maximum_primitives) {
+      prog_struct -> maximum_primitives = worker_prog -> maximum_primitives;
+    }
+
+    FCLOSE (worker_prog -> prel_file);
+    FCLOSE (worker_prog -> seq_file);
+    if (worker_prog -> bit_in_rec != NULL) {
+      wfree ((worker_prog -> bit_in_rec) -> buffer);
+      wfree (worker_prog -> bit_in_rec);
+    }
+    wfree (worker_prog -> seq_buf);
+    if (worker_prog -> out_buf_c != NULL) {
+      wfree (worker_prog -> out_buf_c);
+    }
+    else if (worker_prog -> out_buf_s != NULL) {
+      wfree (worker_prog -> out_buf_s);
+    }
+  }
+
+  /*  The serial loop also counts the empty block that ends the prelude  */
+  prog_struct -> total_blocks = prog_struct -> num_index_blocks + 1;
+
+  pthread_mutex_destroy (&decode_struct.lock);
+  wfree (threads);
+  wfree (decoders);
+
+  return;
+}
+
+
 void executeDespair_File (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
+  if (prog_struct -> block_index != NULL) {
+    executeDespair_FileIndexed (prog_struct);
+    return;
+  }
+
   while (R_TRUE) {
     initDespair_OneBlock (prog_struct, block_struct);
     executeDespair_OneBlock (prog_struct, block_struct);
@@ -401,6 +715,8 @@ ARGS_INFO *parseArguments (int argc, char *argv[], ARGS_INFO *args_struct) {
   args_struct -> base_filename = NULL;
   args_struct -> base_datatype = (R_UINT) sizeof (R_UCHAR);
   args_struct -> verbose_level = R_FALSE;
+  args_struct -> max_expand_bytes = 0;
+  args_struct -> num_threads = 1;
   args_struct -> gcx_report_filename = argv[3];
   /*  Print usage information if no arguments  */
   if (argc == 1) {
@@ -409,7 +725,7 @@ ARGS_INFO *parseArguments (int argc, char *argv[], ARGS_INFO *args_struct) {
 
   /*  Check arguments  */
   while (R_TRUE) {
-    c = getopt (argc, argv, "i:t:v?");
+    c = getopt (argc, argv, "i:m:n:t:v?");
     if (c == EOF) {
       break;
     }
@@ -420,6 +736,21 @@ ARGS_INFO *parseArguments (int argc, char *argv[], ARGS_INFO *args_struct) {
     case 'i':
       args_struct -> base_filename = optarg;
       break;
+    case 'm':
+#ifdef FAVOUR_TIME_EXPAND
+      args_struct -> max_expand_bytes = (R_ULL_INT) strtoull (optarg, NULL, 10) << 20;
+#else
+      /*  Only the FAVOUR_TIME_EXPAND arena has a cap  */
+      fprintf (stderr, "Option -m needs Des-Pair built with -DFAVOUR_TIME_EXPAND; ignored.\n");
+#endif
+      break;
+    case 'n':
+      args_struct -> num_threads = (R_UINT) atoi (optarg);
+      if (args_struct -> num_threads == 0) {
+        fprintf (stderr, "Option with -n must be at least 1.\n");
+        exit (EXIT_FAILURE);
+      }
+      break;
     case 't':
       args_struct -> base_datatype = (R_UINT) atoi (optarg);
       if ((args_struct -> base_datatype != (R_UINT) sizeof (R_UCHAR)) && 
@@ -462,14 +793,116 @@ ARGS_INFO *parseArguments (int argc, char *argv[], ARGS_INFO *args_struct) {
 }
 
 
-void initDespair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
-  R_CHAR *prelName = NULL;
-  R_CHAR *seqName = NULL;
-  R_CHAR *outName = NULL;
+/*
+**  Initialize the fields of a BLOCK_INFO.  Assumes that
+**  initDespair_OneBlock will be run soon.
+*/
+static void initBlock (BLOCK_INFO *block_struct) {
+  block_struct -> phrases_array = NULL;
+  block_struct -> generation_array = NULL;
+  block_struct -> expand_arena = NULL;
+  block_struct -> expand_arena_size = 0;
+  block_struct -> prims_buf = NULL;
+  block_struct -> num_prims = 0;
+  block_struct -> num_phrases = 0;
+  block_struct -> num_symbols = 0;
+  block_struct -> num_generation = 0;
+  block_struct -> num_seq_blocks = 0;
+  block_struct -> total_phrase_length = 0;
+  block_struct -> max_longest_phrase_length = 0;
+
+  return;
+}
+
+
+/*
+**  Open <base_filename><suffix>, exiting on failure
+*/
+static FILE *openBaseFile (const R_CHAR *base_filename, const R_CHAR *suffix, const R_CHAR *mode) {
+  R_CHAR *name = NULL;
+  FILE *fp = NULL;
 
+  name = wmalloc ((strlen (base_filename) + strlen (suffix) + 1) * sizeof (R_CHAR));
+  strcpy (name, base_filename);
+  strcat (name, suffix);
+  fp = fopen (name, mode);
+  if (! fp) {
+    perror (name);
+    exit (EXIT_FAILURE);
+  }
+  wfree (name);
+
+  return (fp);
+}
+
+
+/*
+**  Load <base_filename>.idx if Re-Pair wrote one (-I).  Without it,
+**  block_index stays NULL and the blocks are decoded serially.
+*/
+static void readBlockIndex (PROG_INFO *prog_struct) {
+  R_CHAR *name = NULL;
+  R_CHAR magic[BLOCK_INDEX_MAGIC_SIZE];
+  BLOCK_INDEX_HEADER header;
+  struct stat prel_stat;
+  struct stat seq_stat;
+  FILE *fp = NULL;
+  long size = 0;
+
+  prog_struct -> block_index = NULL;
+  prog_struct -> num_index_blocks = 0;
+
+  name = wmalloc ((strlen (prog_struct -> base_filename) + strlen (BLOCK_INDEX_SUFFIX) + 1) * sizeof (R_CHAR));
+  strcpy (name, prog_struct -> base_filename);
+  strcat (name, BLOCK_INDEX_SUFFIX);
+  fp = fopen (name, "r");
+  wfree (name);
+  if (fp == NULL) {
+    return;
+  }
+
+  if ((fread (magic, sizeof (R_CHAR), BLOCK_INDEX_MAGIC_SIZE, fp) != BLOCK_INDEX_MAGIC_SIZE) ||
+      (memcmp (magic, BLOCK_INDEX_MAGIC, BLOCK_INDEX_MAGIC_SIZE) != 0)) {
+    fprintf (stderr, "ERROR:  Block index has an unknown format.\n");
+    exit (EXIT_FAILURE);
+  }
+
+  /*  An index left by an earlier run of Re-Pair does not match  */
+  if ((fread (&header, sizeof (BLOCK_INDEX_HEADER), 1, fp) != 1) ||
+      (fstat (fileno (prog_struct -> prel_file), &prel_stat) != 0) ||
+      (fstat (fileno (prog_struct -> seq_file), &seq_stat) != 0) ||
+      (header.prel_size != (R_ULL_INT) prel_stat.st_size) ||
+      (header.seq_size != (R_ULL_INT) seq_stat.st_size)) {
+    fprintf (stderr, "ERROR:  Block index %s%s does not match the .prel and .seq files.\n", prog_struct -> base_filename, BLOCK_INDEX_SUFFIX);
+    exit (EXIT_FAILURE);
+  }
+
+  (void) fseek (fp, 0, SEEK_END);
+  size = ftell (fp) - BLOCK_INDEX_MAGIC_SIZE - (long) sizeof (BLOCK_INDEX_HEADER);
+  (void) fseek (fp, BLOCK_INDEX_MAGIC_SIZE + (long) sizeof (BLOCK_INDEX_HEADER), SEEK_SET);
+  if ((size <= 0) || (size % (long) sizeof (BLOCK_INDEX_ENTRY) != 0)) {
+    fprintf (stderr, "ERROR:  Block index is truncated.\n");
+    exit (EXIT_FAILURE);
+  }
+
+  prog_struct -> num_index_blocks = (R_UINT) (size / (long) sizeof (BLOCK_INDEX_ENTRY));
+  prog_struct -> block_index = wmalloc ((size_t) size);
+  if (fread (prog_struct -> block_index, sizeof (BLOCK_INDEX_ENTRY), prog_struct -> num_index_blocks, fp) != prog_struct -> num_index_blocks) {
+    fprintf (stderr, "ERROR:  Reading block index.\n");
+    exit (EXIT_FAILURE);
+  }
+  FCLOSE (fp);
+
+  return;
+}
+
+
+void initDespair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
   /*  Initialize values in PROG_INFO  */
   prog_struct -> progname = NULL;
   prog_struct -> out_file = NULL;
+  prog_struct -> out_fd = -1;
+  prog_struct -> out_offset = 0;
   prog_struct -> seq_file = NULL;
   prog_struct -> prel_file = NULL;
   prog_struct -> base_filename = NULL;
@@ -479,6 +912,10 @@ void initDespair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
   prog_struct -> seq_buf_end = NULL;
   prog_struct -> seq_buf_p = NULL;
   prog_struct -> verbose_level = R_FALSE;
+  prog_struct -> max_expand_bytes = 0;
+  prog_struct -> num_threads = 1;
+  prog_struct -> block_index = NULL;
+  prog_struct -> num_index_blocks = 0;
   prog_struct -> maximum_total_num_phrases = 0;
   prog_struct -> total_num_prims = 0;
   prog_struct -> total_num_phrases = 0;
@@ -489,55 +926,22 @@ void initDespair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
   prog_struct -> total_blocks = 0;
 
   /*  Initialize values in BLOCK_INFO  */
-  /*  Assumes that initDespair_OneBlock will be run soon  */
-  block_struct -> phrases_array = NULL;
-  block_struct -> prims_buf = NULL;
-  block_struct -> num_prims = 0;
-  block_struct -> num_phrases = 0;
-  block_struct -> num_symbols = 0;
-  block_struct -> num_generation = 0;
-  block_struct -> num_seq_blocks = 0;
-  block_struct -> total_phrase_length = 0;
-  block_struct -> max_longest_phrase_length = 0;
+  initBlock (block_struct);
 
   if (prog_struct -> args_struct != NULL) {
     prog_struct -> progname = (prog_struct -> args_struct) -> progname;
     prog_struct -> base_filename = (prog_struct -> args_struct) -> base_filename;
     prog_struct -> verbose_level = (prog_struct -> args_struct) -> verbose_level;
     prog_struct -> base_datatype = (prog_struct -> args_struct) -> base_datatype;
+    prog_struct -> max_expand_bytes = (prog_struct -> args_struct) -> max_expand_bytes;
+    prog_struct -> num_threads = (prog_struct -> args_struct) -> num_threads;
   }
 
   if (prog_struct -> base_filename != NULL) {
-    prelName = wmalloc ((strlen (prog_struct -> base_filename) + 6) * sizeof (R_CHAR));
-    strcpy (prelName, prog_struct -> base_filename);
-    strcat (prelName, ".prel");
-    prog_struct -> prel_file = fopen (prelName, "r");
-    if (! prog_struct -> prel_file) {
-      perror (prelName);
-      exit (EXIT_FAILURE);
-    }
-    wfree (prelName);
-
-    seqName = wmalloc ((strlen (prog_struct -> base_filename) + 5) * sizeof (R_CHAR));
-    strcpy (seqName, prog_struct -> base_filename);
-    strcat (seqName, ".seq");
-    prog_struct -> seq_file = fopen (seqName, "r");
-    if (! prog_struct -> seq_file) {
-      perror (seqName);
-      exit (EXIT_FAILURE);
-    }
-    wfree (seqName);
-
-    outName = wmalloc ((strlen (prog_struct -> base_filename) + 3) * sizeof (R_CHAR));
-    strcpy (outName, prog_struct -> base_filename);
-    strcat (outName, ".u");
-    prog_struct -> out_file = fopen (outName, "w");
-    if (! prog_struct -> out_file) {
-      perror (outName);
-      exit (EXIT_FAILURE);
-    }
-    wfree (outName);
-
+    prog_struct -> prel_file = openBaseFile (prog_struct -> base_filename, ".prel", "r");
+    prog_struct -> seq_file = openBaseFile (prog_struct -> base_filename, ".seq", "r");
+    prog_struct -> out_file = openBaseFile (prog_struct -> base_filename, ".u", "w");
+    readBlockIndex (prog_struct);
   }
   else {
   }
@@ -616,10 +1020,20 @@ void uninitDespair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
     wfree (prog_struct -> out_buf_s);
   }
 
+  if (prog_struct -> block_index != NULL) {
+    wfree (prog_struct -> block_index);
+  }
+  prog_struct -> block_index = NULL;
+
   if (block_struct -> phrases_array != NULL) {
     wfree (block_struct -> phrases_array);
   }
 
+  if (block_struct -> expand_arena != NULL) {
+    wfree (block_struct -> expand_arena);
+  }
+  block_struct -> expand_arena = NULL;
+
   if (block_struct -> prims_buf != NULL) {
     wfree (block_struct -> prims_buf);
   }
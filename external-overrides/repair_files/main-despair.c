@@ -35,9 +35,7 @@
 #include "despair-defn.h"
 #include "despair.h"
 #include "main-despair.h"
-#include <time.h>
-#include "../../malloc_count/malloc_count.h"
-#include "../../malloc_count/stack_count.h"
+#include "../../malloc_count/gcx_probe.h"
 
 
 R_INT main (R_INT argc, R_CHAR *argv[]) {
@@ -68,22 +66,14 @@ R_INT main (R_INT argc, R_CHAR *argv[]) {
 
   initDespair (prog_struct, block_struct);
   
-  clock_t start, end;
-  double cpu_time_used;
-
-  void* base = stack_count_clear();
-  start = clock();
+  gcx_probe probe;
+  gcx_probe_start (&probe);
   executeDespair_File (prog_struct, block_struct);
-  end = clock();
-  cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+  gcx_probe_stop (&probe);
   uninitDespair (prog_struct, block_struct);
-  long long int peak = malloc_count_peak();
-  long long int stack = stack_count_usage(base);
 
-  FILE *report_dcx = fopen(prog_struct->args_struct->gcx_report_filename, "a");
-  fprintf(report_dcx, "%lld|%lld|%5.6lf|", peak, stack, cpu_time_used);
-  printf("Time inserted into the GCX report: %5.4lf\n", cpu_time_used);
-  fclose(report_dcx);
+  gcx_probe_report (prog_struct->args_struct->gcx_report_filename, &probe);
+  gcx_probe_record (&probe, "despair", "decompression");
 
   wfree (prog_struct);
   wfree (block_struct);
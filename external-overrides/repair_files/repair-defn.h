@@ -30,6 +30,8 @@
 #ifndef REPAIR_DEFN_H
 #define REPAIR_DEFN_H
 
+#include <pthread.h>                          /*  pthread_mutex_t, etc.  */
+
 /******************************
 Forward declaration of important structures defined in other files
 ******************************/
@@ -71,6 +73,9 @@ enum R_HEURISTICS { HEUR_NONE = 0, HEUR_WA = 1, HEUR_SIDE = 2, HEUR_NORECUR = 3
 **  a right phrase?  */
 enum R_PHRASE_SIDE { SIDE_NONE = 0, SIDE_LEFT = 1, SIDE_RIGHT = 2 };
 
+/*  State of a block slot in the pipelined (-n) mode  */
+enum R_SLOT_STATE { SLOT_EMPTY = 0, SLOT_FILLED = 1, SLOT_BUSY = 2, SLOT_DONE = 3 };
+
 /******************************
 Structure definitions
 ******************************/
@@ -95,6 +100,8 @@ typedef struct args_info {
   R_UINT max_prims;
   R_UINT base_datatype;
   R_BOOLEAN dowordlen;
+  R_UINT num_threads;
+  R_BOOLEAN write_index;
   R_CHAR *gcx_report_filename;
 } ARGS_INFO;
 
@@ -108,6 +115,9 @@ typedef struct prog_info {
   FILE *prel_file;                               /*  Output prelude file  */
   FILE *prel_text_file;             /*  Output of prelude in text format  */
   FILE *shuff_file;                                       /*  Shuff file  */
+  FILE *index_file;             /*  Output block index file (-I) or NULL  */
+  R_ULL_INT index_out_offset;
+                   /*  Symbols written to the index so far, across blocks  */
   R_CHAR *base_filename;                               /*  Base filename  */
 
   FILE **seq_file_list;
@@ -130,6 +140,9 @@ typedef struct prog_info {
   R_UINT max_prims;
   R_UINT base_datatype;
   R_BOOLEAN dowordlen;
+  R_UINT num_threads;
+             /*  Number of Re-Pair workers; 1 keeps the serial pipeline  */
+  R_BOOLEAN write_index;
 
   /*
   **  Statistics collected in the Re-Pairing process across all blocks
@@ -162,6 +175,7 @@ typedef struct prog_info {
 
 typedef struct block_info {
   R_UINT seq_buf_len;                      /*  Length of sequence buffer  */
+  R_UINT num_input_symbols;     /*  Input symbols read into this block  */
   struct seq_node *seq_buf;                          /*  Sequence buffer  */
   struct seq_node *seq_buf_end;     
                                /*  Pointer to the end of sequence buffer  */
@@ -218,6 +232,47 @@ typedef struct block_info {
                           /*  Length of all phrases in the current block  */
   R_UINT num_symbols;
 } BLOCK_INFO;
+
+
+/*
+**  Read-only view of the input file.  The file is mapped once and
+**  blocks are built directly from it; pos is the index of the first
+**  symbol not yet placed in a block.
+*/
+typedef struct input_info {
+  void *map;                                   /*  Mapped input file  */
+  size_t map_size;
+  R_UINT num_symbols;             /*  Number of symbols in the mapping  */
+  R_UINT pos;                               /*  Next unread symbol  */
+  R_UINT base_datatype;                /*  Bytes per symbol (-t)  */
+} INPUT_INFO;
+
+
+/*
+**  Shared state of the pipelined (-n) mode.  Block i lives in
+**  slots[i % num_slots]; next_fill, next_work and the writer's own
+**  counter only ever increase.  All fields below num_slots are
+**  protected by lock.
+*/
+typedef struct pipeline_info {
+  PROG_INFO *reader_prog;               /*  PROG_INFO used by the reader  */
+  INPUT_INFO *input_struct;
+  R_UINT num_slots;
+  BLOCK_INFO *slots;
+  enum R_SLOT_STATE *slot_state;
+  R_UINT next_fill;                  /*  Number of blocks filled so far  */
+  R_UINT next_work;    /*  Number of blocks claimed by workers so far  */
+  R_BOOLEAN reader_done;               /*  Reader has reached the end  */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;          /*  Broadcast on every state change  */
+} PIPELINE_INFO;
+
+
+typedef struct worker_info {
+  PIPELINE_INFO *pipe_struct;
+  PROG_INFO prog_struct;
+                     /*  Private copy with its own seq_nodelist  */
+} WORKER_INFO;
     
 
 #endif
@@ -36,6 +36,9 @@
 #include <math.h>                                      /*  ceil function  */
 #include <ctype.h>                                  /*  isalnum function  */
 #include <sys/stat.h>
+#include <sys/mman.h>                                   /*  mmap function  */
+#include <unistd.h>                                 /*  unlink function  */
+#include <pthread.h>
 
 #include "common-def.h"
 #include "wmalloc.h"
@@ -47,6 +50,7 @@
 #include "writeout.h"
 #include "bitout.h"
 #include "repair.h"
+#include "block-index.h"
 
 /*  Static functions  */
 static void usage (ARGS_INFO *args_struct);
@@ -54,6 +58,18 @@ static void initRepair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struc
 static void uninitRepair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
 static void executeRepair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
 static void displayStats_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
+static void encodeBlock_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct);
+static void initInput (PROG_INFO *prog_struct, INPUT_INFO *input_struct);
+static void uninitInput (INPUT_INFO *input_struct);
+static R_BOOLEAN moreInput (INPUT_INFO *input_struct);
+static R_UINT inputSymbol (INPUT_INFO *input_struct, R_UINT idx);
+static void addPrimitiveCounts (BLOCK_INFO *block_struct, const R_UINT *counts, R_UINT counts_size);
+static void copySymbols_OneBlock (BLOCK_INFO *block_struct, INPUT_INFO *input_struct, R_UINT len);
+static R_BOOLEAN fillRepair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, INPUT_INFO *input_struct);
+static void initBlock (BLOCK_INFO *block_struct);
+static void *readerRepair_Thread (void *arg);
+static void *workerRepair_Thread (void *arg);
+static void executeRepair_FilePipelined (PROG_INFO *prog_struct, INPUT_INFO *input_struct);
 
 /*
 **  Print out usage information
@@ -67,19 +83,24 @@ static void usage (ARGS_INFO *args_struct) {
   fprintf (stderr, "-b <size>    :  Blocksize\t\t\t[default:  %u]\n", args_struct -> max_buffer_size);
   fprintf (stderr, "-f           :  Use punctuation flags for word-based parsing.\n");
   fprintf (stderr, "-i <file>    :  Input filename\t\t\t[Required]\n");
+  fprintf (stderr, "-I           :  Write a block index to <filename.idx>.\n");
   fprintf (stderr, "-e <level>   :  Pairing heuristic.\t\t[default:  0]\n");
   fprintf (stderr, "           0  : No heuristic\n");
   fprintf (stderr, "           1  : Word-aligned Re-Pair\n");
   fprintf (stderr, "           2  : Obey which side symbol is on\n");
   fprintf (stderr, "           3  : No recursion\n");
   fprintf (stderr, "-l <length>  :  Length limit on phrases.\t[default:  %u]\n", args_struct -> max_length);
+  fprintf (stderr, "-n <threads> :  Re-Pair blocks on a pool of threads.\t[default:  1]\n");
   fprintf (stderr, "-p <phrases> :  Maximum number of phrases\t[default:  %u]\n", args_struct -> max_phrases);
   fprintf (stderr, "-t <type>    :  Input data type \t\t[1 (default), 2, or 4]\n");
   fprintf (stderr, "-v           :  Verbose output\n");
   fprintf (stderr, "-w           :  Do word length counting to .wl file.\n");
   fprintf (stderr, "-x <count>   :  Minimum number of occurances before replacement\n\t\t\t\t\t[default:  %u]\n", args_struct -> max_keep_count);
   fprintf (stderr, "\nDefault sequence file is <filename.seq>.\n");
-  fprintf (stderr, "Default phrase hierarchy file is <filename.prel>.\n\n");
+  fprintf (stderr, "Default phrase hierarchy file is <filename.prel>.\n");
+  fprintf (stderr, "With -I, each block's prelude is byte-aligned so that Des-Pair\n");
+  fprintf (stderr, "can decode blocks in parallel; that output cannot be decoded\n");
+  fprintf (stderr, "without <filename.idx>.  Without -I, an old <filename.idx> is removed.\n\n");
 
   fprintf (stderr, "Re-Pair version:  %s (%s)\n\n", __DATE__, __TIME__);
 
@@ -310,6 +331,37 @@ static void displayStats_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_str
   return;
 }
 
+/*
+**  Write the prelude and sequence of one block.  With -I, also record
+**  where the block starts in both files and byte-align the prelude so
+**  that the next block can be decoded independently.
+*/
+static void encodeBlock_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
+  BLOCK_INDEX_ENTRY entry;
+
+  if (prog_struct -> index_file != NULL) {
+    entry.prel_offset = (R_ULL_INT) ftell (prog_struct -> prel_file);
+    entry.seq_offset = (R_ULL_INT) ftell (prog_struct -> seq_file);
+    entry.out_offset = prog_struct -> index_out_offset;
+    entry.out_length = (R_ULL_INT) block_struct -> num_input_symbols;
+  }
+
+  encodeHierarchy_OneBlock (prog_struct, block_struct);
+  encodeSequence_OneBlock (prog_struct, block_struct);
+
+  if (prog_struct -> index_file != NULL) {
+    writeBits (prog_struct -> prel_file, 0, 0, R_TRUE);
+    if (fwrite (&entry, sizeof (BLOCK_INDEX_ENTRY), 1, prog_struct -> index_file) != 1) {
+      fprintf (stderr, "Error writing block index in %s on line %u.\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    prog_struct -> index_out_offset += entry.out_length;
+  }
+
+  return;
+}
+
+
 /*
 **  Parse arguments and use them to set numerous variables in the
 **  structures.
@@ -346,6 +398,8 @@ ARGS_INFO *parseArguments (R_INT argc, R_CHAR *argv[], ARGS_INFO *args_struct) {
   args_struct -> base_datatype = (R_UINT) sizeof (R_UCHAR);
   args_struct -> max_prims = MIN_PRIMS_ARRAY;
   args_struct -> dowordlen = R_FALSE;
+  args_struct -> num_threads = 1;
+  args_struct -> write_index = R_FALSE;
 
   /*
   **  Initialize to the name of the program
@@ -358,7 +412,7 @@ ARGS_INFO *parseArguments (R_INT argc, R_CHAR *argv[], ARGS_INFO *args_struct) {
   }
 
   while (R_TRUE) {
-    c = getopt (argc, argv, "ab:fe:i:l:p:t:vwx:?");
+    c = getopt (argc, argv, "ab:fe:i:Il:n:p:t:vwx:?");
     if (c == EOF) {
       break;
     }
@@ -383,9 +437,19 @@ ARGS_INFO *parseArguments (R_INT argc, R_CHAR *argv[], ARGS_INFO *args_struct) {
     case 'i':
       args_struct -> base_filename = optarg;
       break;
+    case 'I':
+      args_struct -> write_index = R_TRUE;
+      break;
     case 'l':
       args_struct -> max_length = (R_UINT) atoi (optarg);
       break;
+    case 'n':
+      args_struct -> num_threads = (R_UINT) atoi (optarg);
+      if (args_struct -> num_threads == 0) {
+        fprintf (stderr, "Option with -n must be at least 1.\n");
+        exit (EXIT_FAILURE);
+      }
+      break;
     case 'p':
       args_struct -> max_phrases = (R_UINT) atoi (optarg);
       break;
@@ -469,149 +533,440 @@ ARGS_INFO *parseArguments (R_INT argc, R_CHAR *argv[], ARGS_INFO *args_struct) {
 
 
 /*
-**  Perform Re-Pair on a file
+**  Map the input file once.  Blocks are filled straight from the
+**  mapping, so no intermediate read buffers are needed.
 */
-void executeRepair_File (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
-  R_UINT curr_seq_buf_len = 0;
-  R_UINT items_read = 0;
-  R_UINT k = 0;
-  R_UINT m = 0;
+static void initInput (PROG_INFO *prog_struct, INPUT_INFO *input_struct) {
+  input_struct -> map_size = (size_t) prog_struct -> in_file_size;
+  input_struct -> map = mmap (NULL, input_struct -> map_size, PROT_READ, MAP_PRIVATE, fileno (prog_struct -> in_file), 0);
+  if (input_struct -> map == MAP_FAILED) {
+    fprintf (stderr, "Error mapping input file in %s on line %u:  %s\n", __FILE__, __LINE__, strerror (errno));
+    exit (EXIT_FAILURE);
+  }
+  /*  Blocks are read front to back exactly once  */
+  (void) madvise (input_struct -> map, input_struct -> map_size, MADV_SEQUENTIAL);
+
+  /*  A trailing partial symbol is ignored, as fread did  */
+  input_struct -> num_symbols = prog_struct -> in_file_size / prog_struct -> base_datatype;
+  input_struct -> pos = 0;
+  input_struct -> base_datatype = prog_struct -> base_datatype;
+
+  return;
+}
+
+
+static void uninitInput (INPUT_INFO *input_struct) {
+  if (input_struct -> map != NULL) {
+    munmap (input_struct -> map, input_struct -> map_size);
+  }
+  input_struct -> map = NULL;
+  input_struct -> map_size = 0;
+
+  return;
+}
+
+
+/*
+**  Is there input left in the mapped view?
+*/
+static R_BOOLEAN moreInput (INPUT_INFO *input_struct) {
+  if (input_struct -> pos < input_struct -> num_symbols) {
+    return (R_TRUE);
+  }
+  return (R_FALSE);
+}
+
+
+/*
+**  Symbol number idx of the input, as an R_UINT
+*/
+static R_UINT inputSymbol (INPUT_INFO *input_struct, R_UINT idx) {
+  switch (input_struct -> base_datatype) {
+    case 1:
+      return ((R_UINT) ((const R_UCHAR *) input_struct -> map)[idx]);
+    case 2:
+      return ((R_UINT) ((const R_USHRT *) input_struct -> map)[idx]);
+    default:
+      return (((const R_UINT *) input_struct -> map)[idx]);
+  }
+}
+
+
+/*
+**  Add the symbol counts in counts[0 .. counts_size - 1] to
+**  prims_array.  Same rules as counting one symbol at a time:  a new
+**  primitive starts at 0 and a count saturates at
+**  UNINITIALIZED_GENERATION - 1.
+*/
+static void addPrimitiveCounts (BLOCK_INFO *block_struct, const R_UINT *counts, R_UINT counts_size) {
   R_UINT i = 0;
+  R_UINT room = 0;
 
-  /*  Declare various buffers, depending on which data type is used as input  */
-  R_UINT input_buffer[INPUT_BUFFER_SIZE];
-  /*  input_buffer_end points just off array  */
-  R_UINT *input_buffer_end = input_buffer + INPUT_BUFFER_SIZE;
-  R_UINT *input_buffer_p = input_buffer_end;
-  R_UCHAR *input_buffer_c = NULL;
-  R_USHRT *input_buffer_s = NULL;
-
-  if (prog_struct -> base_datatype == (R_UINT) sizeof (R_UCHAR)) {
-    input_buffer_c = wmalloc (sizeof (R_UCHAR) * INPUT_BUFFER_SIZE);
-  }
-  else if (prog_struct -> base_datatype == (R_UINT) sizeof (R_USHRT)) {
-    input_buffer_s = wmalloc (sizeof (R_USHRT) * INPUT_BUFFER_SIZE);
-  }
-
-  /*  Fill one block  */
-  while ((block_struct -> input_stack_size != 0) || (input_buffer_p < input_buffer_end) || (ftell (prog_struct -> in_file) < (R_L_INT) prog_struct -> in_file_size)) {
-    initRepair_OneBlock (prog_struct, block_struct);
-    curr_seq_buf_len = 0;
-    curr_seq_buf_len += block_struct -> input_stack_size;
-    block_struct -> input_stack_size = 0;
-
-    /*  Fill one sequence  */
-    while (curr_seq_buf_len < block_struct -> seq_buf_len && ((ftell (prog_struct -> in_file) < (R_L_INT) prog_struct -> in_file_size) || (input_buffer_p < input_buffer_end))) {
-      if (input_buffer_p == input_buffer_end) {
-        switch (prog_struct -> base_datatype) {
-          case 1:
-            items_read = (R_UINT) fread (input_buffer_c, sizeof (R_UCHAR), (size_t) INPUT_BUFFER_SIZE, prog_struct -> in_file);
-            for (i = 0; i < items_read; i++) {
-              input_buffer[i] = (R_UINT) input_buffer_c[i];
-            }
-            break;
-          case 2:
-            items_read = (R_UINT) fread (input_buffer_s, sizeof (R_USHRT), (size_t) INPUT_BUFFER_SIZE, prog_struct -> in_file);
-            for (i = 0; i < items_read; i++) {
-              input_buffer[i] = (R_UINT) input_buffer_s[i];
-            }
-            break;
-          case 4:
-            items_read = (R_UINT) fread (input_buffer, sizeof (R_UINT), (size_t) INPUT_BUFFER_SIZE, prog_struct -> in_file);
-            break;
-        }
-        input_buffer_p = input_buffer;
-        input_buffer_end = input_buffer + items_read;
-      }
-      if (ferror (prog_struct -> in_file) != R_FALSE) {
-        fprintf (stderr, "Fatal error in reading from input file!\n");
-        exit (EXIT_FAILURE);
-      }
+  for (i = 0; i < counts_size; i++) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    if (i >= block_struct -> prims_array_size) {
+      fprintf (stderr, "Symbol %u encountered.\n", i);
+      fprintf (stderr, "Symbol out of range in input buffer in %s, line %u.\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+
+    /*  New primitive found  */
+    if (block_struct -> prims_array[i] == UNINITIALIZED_GENERATION) {
+      block_struct -> num_prims += 1;
+      block_struct -> prims_array[i] = 0;
+    }
+
+    room = (UNINITIALIZED_GENERATION - 1) - block_struct -> prims_array[i];
+    block_struct -> prims_array[i] += (counts[i] < room) ? counts[i] : room;
+  }
 
-      if ((*input_buffer_p & NO_FLAGS) >= block_struct -> prims_array_size) {
-        fprintf (stderr, "Symbol %u encountered.\n", *input_buffer_p);
+  return;
+}
+
+
+/*
+**  Build seq_buf[0 .. len - 1] from the next len symbols of the mapped
+**  view and count them into prims_array.
+**
+**  Byte input is counted into four interleaved histograms so that runs
+**  of the same symbol do not serialize on one counter; the compiler can
+**  keep the four streams in flight together.  Wider input is counted
+**  directly against a table the size of prims_array.
+*/
+static void copySymbols_OneBlock (BLOCK_INFO *block_struct, INPUT_INFO *input_struct, R_UINT len) {
+  R_UINT i = 0;
+  R_UINT j = 0;
+  R_UINT sym = 0;
+  R_UINT *counts = NULL;
+  R_UINT byte_counts[4][256];
+  const R_UCHAR *src_c = NULL;
+
+  if (input_struct -> base_datatype == (R_UINT) sizeof (R_UCHAR)) {
+    src_c = ((const R_UCHAR *) input_struct -> map) + input_struct -> pos;
+    memset (byte_counts, 0, sizeof (byte_counts));
+    for (i = 0; i + 4 <= len; i += 4) {
+      byte_counts[0][src_c[i]]++;
+      byte_counts[1][src_c[i + 1]]++;
+      byte_counts[2][src_c[i + 2]]++;
+      byte_counts[3][src_c[i + 3]]++;
+    }
+    for (; i < len; i++) {
+      byte_counts[0][src_c[i]]++;
+    }
+    for (j = 0; j < 256; j++) {
+      byte_counts[0][j] += byte_counts[1][j] + byte_counts[2][j] + byte_counts[3][j];
+    }
+    addPrimitiveCounts (block_struct, byte_counts[0], 256);
+
+    for (i = 0; i < len; i++) {
+      initSeqNode ((R_UINT) src_c[i], &(block_struct -> seq_buf[i]));
+    }
+  }
+  else {
+    counts = wmalloc (block_struct -> prims_array_size * sizeof (R_UINT));
+    memset (counts, 0, block_struct -> prims_array_size * sizeof (R_UINT));
+    for (i = 0; i < len; i++) {
+      sym = inputSymbol (input_struct, input_struct -> pos + i);
+      if ((sym & NO_FLAGS) >= block_struct -> prims_array_size) {
+        fprintf (stderr, "Symbol %u encountered.\n", sym);
         fprintf (stderr, "Symbol out of range in input buffer in %s, line %u.\n", __FILE__, __LINE__);
         exit (EXIT_FAILURE);
       }
+      counts[sym & NO_FLAGS]++;
+      initSeqNode (sym, &(block_struct -> seq_buf[i]));
+    }
+    addPrimitiveCounts (block_struct, counts, block_struct -> prims_array_size);
+    wfree (counts);
+  }
 
-      /*  New primitive found  */
-      if (block_struct -> prims_array[(*input_buffer_p & NO_FLAGS)] == UNINITIALIZED_GENERATION) {
-        block_struct -> num_prims += 1;
-        block_struct -> prims_array[(*input_buffer_p & NO_FLAGS)] = 0;
-      }
+  input_struct -> pos += len;
 
-      /*  Do not increment if maximum number of primitives is reached;
-      **  basically prevents counter from overflowing back to 0.  */
-      if (block_struct -> prims_array[(*input_buffer_p & NO_FLAGS)] != UNINITIALIZED_GENERATION - 1) {
-        block_struct -> prims_array[(*input_buffer_p & NO_FLAGS)] += 1;
-      }
+  return;
+}
 
-      initSeqNode ((R_UINT) *input_buffer_p, &(block_struct -> seq_buf[curr_seq_buf_len]));
-      curr_seq_buf_len++;
-      input_buffer_p++;
+
+/*
+**  Fill one block from the mapped input file.  Returns R_FALSE (and
+**  leaves block_struct untouched) when there is nothing left to read.
+**
+**  The word-aligned rollback is decided on the mapped view before the
+**  block is built:  the symbols that would have been pushed to
+**  input_stack are simply left unread and start the next block.
+*/
+static R_BOOLEAN fillRepair_OneBlock (PROG_INFO *prog_struct, BLOCK_INFO *block_struct, INPUT_INFO *input_struct) {
+  R_UINT block_len = 0;
+  R_UINT k = 0;
+
+  if (moreInput (input_struct) == R_FALSE) {
+    return (R_FALSE);
+  }
+
+  initRepair_OneBlock (prog_struct, block_struct);
+
+  block_len = block_struct -> seq_buf_len;
+  if (block_len > input_struct -> num_symbols - input_struct -> pos) {
+    block_len = input_struct -> num_symbols - input_struct -> pos;
+  }
+
+  /*  Rollback sequence  */
+  if ((prog_struct -> apply_heuristics == HEUR_WA) && (input_struct -> pos + block_len < input_struct -> num_symbols)) {
+    k = block_len - 1;
+    while ((k > 0) && (!ISWORD (inputSymbol (input_struct, input_struct -> pos + k)))) {
+      k--;
+    }
+    while ((k > 0) && (ISWORD (inputSymbol (input_struct, input_struct -> pos + k)))) {
+      k--;
     }
+    /*
+    **  At this point, k will point to the last symbol of the shortened
+    **  block.
+    */
+    if (k != 1) {
+      block_len = k + 1;
+    }
+    else {
+      /*  Roll back sequence to the beginning  */
+    }
+  }
 
-    if (curr_seq_buf_len < block_struct -> seq_buf_len) {
-      block_struct -> seq_buf_len = curr_seq_buf_len;
-      block_struct -> seq_buf_end = block_struct -> seq_buf + (block_struct -> seq_buf_len - 1);
+  copySymbols_OneBlock (block_struct, input_struct, block_len);
+
+  block_struct -> seq_buf_len = block_len;
+  block_struct -> num_input_symbols = block_len;
+  block_struct -> seq_buf_end = block_struct -> seq_buf + (block_struct -> seq_buf_len - 1);
+
+  (block_struct -> sizelist) = initSListNode (block_struct -> num_prims);
+
+  return (R_TRUE);
+}
+
+
+/*
+**  Initialize the fields of a BLOCK_INFO that are reset at the
+**  beginning of each block.  Assumes uninitRepair_OneBlock will be
+**  run soon.
+*/
+static void initBlock (BLOCK_INFO *block_struct) {
+  block_struct -> num_input_symbols = 0;
+  block_struct -> seq_buf = NULL; 
+  block_struct -> input_stack = NULL;
+  block_struct -> input_stack_size = 0;
+  block_struct -> prims_array = NULL;  
+  block_struct -> tent_phrases = NULL;
+  block_struct -> pqueue = NULL;
+
+  block_struct -> temp_phrases = NULL;
+  block_struct -> sort_phrases = NULL;
+
+  /*  Initialize values to 0 before calling uninitRepair_OneBlock  */
+  block_struct -> num_prims = 0;
+  block_struct -> num_phrases = 0;
+  block_struct -> num_generation = 0;
+  block_struct -> sum_phrase_length = 0;
+  block_struct -> longest_phrase_length = 0;
+  block_struct -> num_symbols = 0;
+
+  return;
+}
+
+
+/*
+**  Pipelined Re-Pair (-n <threads> with more than one thread).
+**
+**  A reader thread fills blocks into a ring of slots, a pool of workers
+**  runs executeRepair_OneBlock on whichever filled block comes next, and
+**  the calling thread acts as the writer:  it waits for the blocks in
+**  file order and encodes them exactly as the serial loop does, so the
+**  prelude and sequence files are identical to the serial ones for a
+**  given block size.
+**
+**  Each worker owns a copy of PROG_INFO with its own seq_nodelist, since
+**  that list is scratch space for deleteTPhraseNode.  Only the writer
+**  touches the output files and the statistics in the caller's
+**  PROG_INFO.
+*/
+static void *readerRepair_Thread (void *arg) {
+  PIPELINE_INFO *pipe_struct = (PIPELINE_INFO *) arg;
+  R_UINT slot = 0;
+  R_BOOLEAN filled = R_FALSE;
+
+  while (R_TRUE) {
+    slot = pipe_struct -> next_fill % pipe_struct -> num_slots;
+    pthread_mutex_lock (&pipe_struct -> lock);
+    while (pipe_struct -> slot_state[slot] != SLOT_EMPTY) {
+      pthread_cond_wait (&pipe_struct -> changed, &pipe_struct -> lock);
     }
+    pthread_mutex_unlock (&pipe_struct -> lock);
 
-    /*  Rollback sequence  */
-    if ((prog_struct -> apply_heuristics == HEUR_WA) && ((ftell (prog_struct -> in_file) < (R_L_INT) prog_struct -> in_file_size) || (input_buffer_p < input_buffer_end))) {
-      k = block_struct -> seq_buf_len - 1;
-      while ((k > 0) && (!ISWORD (block_struct -> seq_buf[k].value))) {
-	k--;
-      }
-      while ((k > 0) && (ISWORD (block_struct -> seq_buf[k].value))) {
-	k--;
-      }
-      /*
-      **  At this point, k will point to the last SEQ_NODE of the shortened
-      **  block_struct -> seq_buf.
-      */
-      if (k != 1) {
-	/*
-	**  m is used to iterate through the end of the array to copy
-	**  the values to an "input_stack".
-	*/
-	m = k + 1;
-	block_struct -> input_stack = wmalloc (((block_struct -> seq_buf_len - m) * sizeof (SEQ_NODE)));
-	for (k = 0; k < block_struct -> seq_buf_len - m; k++) {
-	  initSeqNode ((R_UINT) block_struct -> seq_buf[m + k].value, &block_struct -> input_stack[k]);
-	  block_struct -> prims_array[block_struct -> seq_buf[m + k].value]--;
-	  if (block_struct -> prims_array[block_struct -> seq_buf[m + k].value] == 0) {
-	    block_struct -> num_prims--;
-            block_struct -> prims_array[block_struct -> seq_buf[m + k].value] = UNINITIALIZED_GENERATION;
-	  }
-	}
+    filled = fillRepair_OneBlock (pipe_struct -> reader_prog, &pipe_struct -> slots[slot], pipe_struct -> input_struct);
 
-        /*  Decrease sequence from block_struct -> seq_buf_len by the number
-        **  of characters copied  */
-	block_struct -> seq_buf_len -= k;
-	block_struct -> seq_buf_end = block_struct -> seq_buf + (block_struct -> seq_buf_len - 1);
-	block_struct -> input_stack_size = k;
-      }
-      else {
-        /*  Roll back sequence to the beginning  */
-      }
+    pthread_mutex_lock (&pipe_struct -> lock);
+    if (filled == R_FALSE) {
+      pipe_struct -> reader_done = R_TRUE;
     }
+    else {
+      pipe_struct -> slot_state[slot] = SLOT_FILLED;
+      pipe_struct -> next_fill++;
+    }
+    pthread_cond_broadcast (&pipe_struct -> changed);
+    pthread_mutex_unlock (&pipe_struct -> lock);
 
-    (block_struct -> sizelist) = initSListNode (block_struct -> num_prims);
+    if (filled == R_FALSE) {
+      break;
+    }
+  }
 
-    executeRepair_OneBlock (prog_struct, block_struct);
-    encodeHierarchy_OneBlock (prog_struct, block_struct);
-    encodeSequence_OneBlock (prog_struct, block_struct);
-    displayStats_OneBlock (prog_struct, block_struct);
+  return (NULL);
+}
+
+
+static void *workerRepair_Thread (void *arg) {
+  WORKER_INFO *worker_struct = (WORKER_INFO *) arg;
+  PIPELINE_INFO *pipe_struct = worker_struct -> pipe_struct;
+  R_UINT slot = 0;
+
+  while (R_TRUE) {
+    pthread_mutex_lock (&pipe_struct -> lock);
+    while ((pipe_struct -> next_work == pipe_struct -> next_fill) && (pipe_struct -> reader_done == R_FALSE)) {
+      pthread_cond_wait (&pipe_struct -> changed, &pipe_struct -> lock);
+    }
+    if (pipe_struct -> next_work == pipe_struct -> next_fill) {
+      pthread_mutex_unlock (&pipe_struct -> lock);
+      break;
+    }
+    slot = pipe_struct -> next_work % pipe_struct -> num_slots;
+    pipe_struct -> next_work++;
+    pipe_struct -> slot_state[slot] = SLOT_BUSY;
+    pthread_mutex_unlock (&pipe_struct -> lock);
+
+    executeRepair_OneBlock (&worker_struct -> prog_struct, &pipe_struct -> slots[slot]);
 
+    pthread_mutex_lock (&pipe_struct -> lock);
+    pipe_struct -> slot_state[slot] = SLOT_DONE;
+    pthread_cond_broadcast (&pipe_struct -> changed);
+    pthread_mutex_unlock (&pipe_struct -> lock);
+  }
+
+  return (NULL);
+}
+
+
+static void executeRepair_FilePipelined (PROG_INFO *prog_struct, INPUT_INFO *input_struct) {
+  PIPELINE_INFO pipe_struct;
+  PROG_INFO reader_prog;
+  WORKER_INFO *workers = NULL;
+  pthread_t reader_thread;
+  pthread_t *worker_threads = NULL;
+  BLOCK_INFO *block_struct = NULL;
+  R_UINT num_workers = prog_struct -> num_threads;
+  R_UINT slot = 0;
+  R_UINT i = 0;
+
+  /*
+  **  The reader runs initRepair_OneBlock, which counts blocks; give it
+  **  its own PROG_INFO so that the writer's block numbering and
+  **  statistics are the same as in the serial loop.
+  */
+  reader_prog = *prog_struct;
+  reader_prog.total_blocks = 0;
+
+  /*  Enough slots to keep every worker busy while one block is being
+  **  filled and one is being written  */
+  pipe_struct.num_slots = num_workers + 2;
+  pipe_struct.slots = wmalloc (pipe_struct.num_slots * sizeof (BLOCK_INFO));
+  pipe_struct.slot_state = wmalloc (pipe_struct.num_slots * sizeof (enum R_SLOT_STATE));
+  for (i = 0; i < pipe_struct.num_slots; i++) {
+    initBlock (&pipe_struct.slots[i]);
+    pipe_struct.slot_state[i] = SLOT_EMPTY;
+  }
+  pipe_struct.reader_prog = &reader_prog;
+  pipe_struct.input_struct = input_struct;
+  pipe_struct.next_fill = 0;
+  pipe_struct.next_work = 0;
+  pipe_struct.reader_done = R_FALSE;
+  pthread_mutex_init (&pipe_struct.lock, NULL);
+  pthread_cond_init (&pipe_struct.changed, NULL);
+
+  workers = wmalloc (num_workers * sizeof (WORKER_INFO));
+  worker_threads = wmalloc (num_workers * sizeof (pthread_t));
+  for (i = 0; i < num_workers; i++) {
+    workers[i].pipe_struct = &pipe_struct;
+    workers[i].prog_struct = *prog_struct;
+    workers[i].prog_struct.seq_nodelist = wmalloc (prog_struct -> seq_nodelist_size * sizeof (SEQ_NODE*));
+  }
+
+  pthread_create (&reader_thread, NULL, readerRepair_Thread, &pipe_struct);
+  for (i = 0; i < num_workers; i++) {
+    pthread_create (&worker_threads[i], NULL, workerRepair_Thread, &workers[i]);
+  }
+
+  /*  Writer:  encode the blocks in the order they were read  */
+  for (i = 0; ; i++) {
+    slot = i % pipe_struct.num_slots;
+    pthread_mutex_lock (&pipe_struct.lock);
+    while ((pipe_struct.slot_state[slot] != SLOT_DONE) && !((pipe_struct.reader_done == R_TRUE) && (i == pipe_struct.next_fill))) {
+      pthread_cond_wait (&pipe_struct.changed, &pipe_struct.lock);
+    }
+    if (pipe_struct.slot_state[slot] != SLOT_DONE) {
+      pthread_mutex_unlock (&pipe_struct.lock);
+      break;
+    }
+    pthread_mutex_unlock (&pipe_struct.lock);
+
+    block_struct = &pipe_struct.slots[slot];
+    prog_struct -> total_blocks++;
+    encodeBlock_OneBlock (prog_struct, block_struct);
+    displayStats_OneBlock (prog_struct, block_struct);
     uninitRepair_OneBlock (prog_struct, block_struct);
+
+    pthread_mutex_lock (&pipe_struct.lock);
+    pipe_struct.slot_state[slot] = SLOT_EMPTY;
+    pthread_cond_broadcast (&pipe_struct.changed);
+    pthread_mutex_unlock (&pipe_struct.lock);
   }
 
-  if (input_buffer_c != NULL) {
-    wfree (input_buffer_c);
+  pthread_join (reader_thread, NULL);
+  for (i = 0; i < num_workers; i++) {
+    pthread_join (worker_threads[i], NULL);
+    wfree (workers[i].prog_struct.seq_nodelist);
   }
-  else if (input_buffer_s != NULL) {
-    wfree (input_buffer_s);
+
+  pthread_mutex_destroy (&pipe_struct.lock);
+  pthread_cond_destroy (&pipe_struct.changed);
+  wfree (worker_threads);
+  wfree (workers);
+  wfree (pipe_struct.slot_state);
+  wfree (pipe_struct.slots);
+
+  return;
+}
+
+
+/*
+**  Perform Re-Pair on a file
+*/
+void executeRepair_File (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
+  INPUT_INFO input_struct;
+
+  initInput (prog_struct, &input_struct);
+
+  if (prog_struct -> num_threads > 1) {
+    executeRepair_FilePipelined (prog_struct, &input_struct);
   }
+  else {
+    /*  Fill one block  */
+    while (fillRepair_OneBlock (prog_struct, block_struct, &input_struct) == R_TRUE) {
+      executeRepair_OneBlock (prog_struct, block_struct);
+      encodeBlock_OneBlock (prog_struct, block_struct);
+      displayStats_OneBlock (prog_struct, block_struct);
+
+      uninitRepair_OneBlock (prog_struct, block_struct);
+    }
+  }
+
+  uninitInput (&input_struct);
 
   return;
 }
@@ -640,6 +995,8 @@ void initRepair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
   prog_struct -> prel_file = NULL;
   prog_struct -> prel_text_file = NULL;
   prog_struct -> shuff_file = NULL;
+  prog_struct -> index_file = NULL;
+  prog_struct -> index_out_offset = 0;
   prog_struct -> base_filename = NULL;
 
   prog_struct -> verbose_level = R_FALSE;
@@ -653,6 +1010,8 @@ void initRepair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
   prog_struct -> base_datatype = (R_UINT) sizeof (R_UCHAR);
   prog_struct -> max_prims = MIN_PRIMS_ARRAY;
   prog_struct -> dowordlen = R_FALSE;
+  prog_struct -> num_threads = 1;
+  prog_struct -> write_index = R_FALSE;
 
   prog_struct -> maximum_total_num_phrases = 0;
   prog_struct -> total_num_phrases = 0;
@@ -684,6 +1043,8 @@ void initRepair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
     prog_struct -> base_datatype = args_struct -> base_datatype;
     prog_struct -> max_prims = args_struct -> max_prims;
     prog_struct -> dowordlen = args_struct -> dowordlen;
+    prog_struct -> num_threads = args_struct -> num_threads;
+    prog_struct -> write_index = args_struct -> write_index;
   }
 
   prog_struct -> seq_nodelist_size = INIT_NODELIST_SIZE;
@@ -732,30 +1093,33 @@ void initRepair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
       fprintf (stderr, "Error creating prel file.\n");
     }
 
+    /*  Create block index file; the header is filled in by uninitRepair  */
+    temp_filename = strcpy (temp_filename, prog_struct -> base_filename);
+    temp_filename = strcat (temp_filename, BLOCK_INDEX_SUFFIX);
+    if (prog_struct -> write_index == R_TRUE) {
+      BLOCK_INDEX_HEADER header = {0, 0};
+
+      prog_struct -> index_file = fopen (temp_filename, "w");
+      if (prog_struct -> index_file == NULL) {
+        fprintf (stderr, "Error creating block index file in %s on line %u.\n", __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+      (void) fwrite (BLOCK_INDEX_MAGIC, sizeof (R_CHAR), BLOCK_INDEX_MAGIC_SIZE, prog_struct -> index_file);
+      (void) fwrite (&header, sizeof (BLOCK_INDEX_HEADER), 1, prog_struct -> index_file);
+    }
+    else if ((unlink (temp_filename) != 0) && (errno != ENOENT)) {
+      /*  An index of an earlier run would not match this output  */
+      fprintf (stderr, "Error removing the old block index %s.\n", temp_filename);
+      exit (EXIT_FAILURE);
+    }
+
     wfree (temp_filename);
   }
   else {
   }
 
   /*  Initialize values that are reset at the beginning of each block.  */
-  /*  Assumes uninitRepair_OneBlock will be run soon.  */
-  block_struct -> seq_buf = NULL; 
-  block_struct -> input_stack = NULL;
-  block_struct -> input_stack_size = 0;
-  block_struct -> prims_array = NULL;  
-  block_struct -> tent_phrases = NULL;
-  block_struct -> pqueue = NULL;
-
-  block_struct -> temp_phrases = NULL;
-  block_struct -> sort_phrases = NULL;
-
-  /*  Initialize values to 0 before calling uninitRepair_OneBlock  */
-  block_struct -> num_prims = 0;
-  block_struct -> num_phrases = 0;
-  block_struct -> num_generation = 0;
-  block_struct -> sum_phrase_length = 0;
-  block_struct -> longest_phrase_length = 0;
-  block_struct -> num_symbols = 0;
+  initBlock (block_struct);
 
   if (prog_struct -> verbose_level == R_TRUE) {
     fprintf (stderr, "Block\tPrims\tPhrases\t  Prims + Phrases\tGenerations\tSymbols\n\n");
@@ -776,6 +1140,18 @@ void uninitRepair (PROG_INFO *prog_struct, BLOCK_INFO *block_struct) {
     writeBits (prog_struct -> prel_file, 0, 0, R_FALSE);
     writeBits (prog_struct -> prel_file, 0, 0, R_TRUE);
 
+    if (prog_struct -> index_file != NULL) {
+      BLOCK_INDEX_HEADER header;
+
+      header.prel_size = (R_ULL_INT) ftell (prog_struct -> prel_file);
+      header.seq_size = (R_ULL_INT) ftell (prog_struct -> seq_file);
+      if ((fseek (prog_struct -> index_file, BLOCK_INDEX_MAGIC_SIZE, SEEK_SET) != 0) ||
+          (fwrite (&header, sizeof (BLOCK_INDEX_HEADER), 1, prog_struct -> index_file) != 1)) {
+        fprintf (stderr, "Error writing block index in %s on line %u.\n", __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+      FCLOSE (prog_struct -> index_file);
+    }
     FCLOSE (prog_struct -> seq_file);
     FCLOSE (prog_struct -> prel_file);
     if (prog_struct -> prel_text_file != NULL) {
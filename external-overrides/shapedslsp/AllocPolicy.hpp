@@ -0,0 +1,133 @@
+#ifndef INCLUDE_GUARD_AllocPolicy
+#define INCLUDE_GUARD_AllocPolicy
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <sdsl/memory_management.hpp>
+#include <sux/util/Vector.hpp>
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+/**
+ * Page policy for the memory behind a loaded SLP, named after sux::util::AllocType.
+ *
+ * sux::util::Vector takes the policy as a template argument (see SUX_DEFAULT_ALLOC_TYPE),
+ * but the SLP classes hold sdsl vectors, so for them the policy is applied around load():
+ * - MALLOC: system default, nothing is done.
+ * - SMALLPAGE: anonymous memory is advised MADV_NOHUGEPAGE after load, i.e. 4KiB pages only.
+ * - TRANSHUGEPAGE: anonymous memory is advised MADV_HUGEPAGE (and collapsed when the kernel supports it) after load.
+ * - FORCEHUGEPAGE: sdsl allocates from a MAP_HUGETLB pool reserved before load.
+ */
+using AllocType = sux::util::AllocType;
+
+
+inline bool parseAllocType(const std::string & name, AllocType & at) {
+  if (name == "MALLOC" or name == "malloc") {
+    at = sux::util::MALLOC;
+  } else if (name == "SMALLPAGE" or name == "smallpage") {
+    at = sux::util::SMALLPAGE;
+  } else if (name == "TRANSHUGEPAGE" or name == "transhugepage") {
+    at = sux::util::TRANSHUGEPAGE;
+  } else if (name == "FORCEHUGEPAGE" or name == "forcehugepage") {
+    at = sux::util::FORCEHUGEPAGE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+
+inline const char * allocTypeName(AllocType at) {
+  switch (at) {
+  case sux::util::SMALLPAGE: return "SMALLPAGE";
+  case sux::util::TRANSHUGEPAGE: return "TRANSHUGEPAGE";
+  case sux::util::FORCEHUGEPAGE: return "FORCEHUGEPAGE";
+  default: return "MALLOC";
+  }
+}
+
+
+/**
+ * To be called once, before any SLP is loaded.
+ * For FORCEHUGEPAGE, reserves a huge page pool large enough for files of up to maxFileBytes
+ * (an SLP in memory is about the size of its serialization).
+ */
+inline void prepareAllocPolicy(AllocType at, uint64_t maxFileBytes) {
+  if (at != sux::util::FORCEHUGEPAGE) {
+    return;
+  }
+  const uint64_t bytes = 2 * maxFileBytes + (16ULL << 20);
+  try {
+    sdsl::memory_manager::use_hugepages(bytes);
+  } catch (const std::exception & e) {
+    std::cerr << "warning: cannot reserve " << bytes << " bytes of huge pages (" << e.what()
+              << "), falling back to MALLOC" << std::endl;
+  }
+}
+
+
+/**
+ * To be called after load(). Advises every private anonymous mapping (heap included)
+ * according to the policy; stack and file mappings are left alone.
+ */
+inline void applyAllocPolicy(AllocType at) {
+  if (at != sux::util::SMALLPAGE and at != sux::util::TRANSHUGEPAGE) {
+    return;
+  }
+  std::ifstream maps("/proc/self/maps");
+  std::string line;
+  while (std::getline(maps, line)) {
+    std::istringstream ss(line);
+    std::string range, perms, offset, dev, path;
+    uint64_t inode;
+    ss >> range >> perms >> offset >> dev >> inode;
+    std::getline(ss >> std::ws, path);
+    if (perms.compare(0, 2, "rw") != 0 or perms[3] != 'p' or inode != 0) {
+      continue;
+    }
+    if (not path.empty() and path != "[heap]") {
+      continue;
+    }
+    const uint64_t beg = std::stoull(range.substr(0, range.find('-')), nullptr, 16);
+    const uint64_t end = std::stoull(range.substr(range.find('-') + 1), nullptr, 16);
+    void * addr = reinterpret_cast<void *>(beg);
+    if (at == sux::util::SMALLPAGE) {
+      madvise(addr, end - beg, MADV_NOHUGEPAGE);
+    } else if (madvise(addr, end - beg, MADV_HUGEPAGE) == 0) {
+      //// synchronous collapse (Linux 6.1+); otherwise khugepaged does it in the background
+      madvise(addr, end - beg, MADV_COLLAPSE);
+    }
+  }
+}
+
+
+/**
+ * Bytes of anonymous memory currently backed by transparent huge pages.
+ */
+inline uint64_t anonHugePagesBytes() {
+  std::ifstream smaps("/proc/self/smaps_rollup");
+  std::string key;
+  uint64_t kb;
+  while (smaps >> key) {
+    if (key == "AnonHugePages:" and smaps >> kb) {
+      return kb * 1024;
+    }
+    smaps.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return 0;
+}
+
+
+inline uint64_t fileBytes(const std::string & path) {
+  struct stat st;
+  return (stat(path.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+#endif
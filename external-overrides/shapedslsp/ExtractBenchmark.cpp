@@ -1,3 +1,8 @@
+#include "../malloc_count/malloc_count.h"
+#include "../malloc_count/stack_count.h"
+#include "../malloc_count/gcx_probe.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <queue>
@@ -16,6 +21,7 @@
 #include "FixedBitLenCode.hpp"
 #include "SelectType.hpp"
 #include "VlcVec.hpp"
+#include "AllocPolicy.hpp"
 
 using namespace std;
 
@@ -24,61 +30,212 @@ using timer = std::chrono::high_resolution_clock;
 
 using var_t = uint32_t;
 string file_gcx;
+void* base_gcx;
+uint64_t warmup_gcx = 1;
+uint64_t repetitions_gcx = 5;
+uint64_t threads_gcx = 1;
+AllocType alloc_gcx = sux::util::MALLOC;
+
+//// what measure() found for one encoding; main() turns it into report rows
+struct Measurement
+{
+  double loadTime;    // seconds
+  double extractTime; // seconds, one pass over the query file
+  double extractCpu;  // seconds, one pass over the query file
+  long long int peak;
+  long long int stack;
+  long long int peakRss; // from the load on
+  uint64_t substrLen; // longest query
+};
+
+double percentile(const vector<double> & sorted, double p)
+{
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const uint64_t idx = static_cast<uint64_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[idx];
+}
+
+//// Wall time (s) of one pass over v_query shared by numThreads threads.
+//// The loaded slp is shared read-only; every thread expands into its own buffer
+//// and grabs queries in small chunks so that long intervals do not unbalance the pass.
+template <class SlpT>
+double expandConcurrent(
+    SlpT & slp,
+    const vector<pair<uint64_t, uint64_t>> & v_query,
+    uint64_t maxLen,
+    uint64_t numThreads)
+{
+  const uint64_t chunk = 64;
+  std::atomic<uint64_t> nextQuery(0);
+  vector<std::thread> workers;
+  auto start = timer::now();
+  for (uint64_t t = 0; t < numThreads; ++t)
+  {
+    workers.emplace_back([&]() {
+      string substr;
+      substr.resize(maxLen);
+      uint64_t beg;
+      while ((beg = nextQuery.fetch_add(chunk)) < v_query.size())
+      {
+        const uint64_t end = std::min<uint64_t>(beg + chunk, v_query.size());
+        for (uint64_t i = beg; i < end; ++i)
+        {
+          slp.expandSubstr(v_query[i].first, v_query[i].second - v_query[i].first + 1, substr.data());
+        }
+      }
+    });
+  }
+  for (auto & w : workers)
+  {
+    w.join();
+  }
+  return duration<double>(timer::now() - start).count();
+}
+
 template <class SlpT>
-void measure(
+Measurement measure(
     std::string in,
     string query_file)
 {
-  FILE *report_gcx = fopen(file_gcx.c_str(), "a");
-  //long long int peak = malloc_count_peak();
-  //long long int stack = stack_count_usage(base);
+  gcx_probe_reset_peak_rss();
   SlpT slp;
-  uint64_t n;
-  uint64_t lenExpand;
   auto start = timer::now();
   ifstream fs(in);
   slp.load(fs);
   auto stop = timer::now();
+  const double loadTime = duration<double>(stop - start).count();
   cout << "time to load (ms): " << duration_cast<milliseconds>(stop - start).count() << endl;
+  //// the madvise of the policy is not part of load_time, so the policies are compared on the same load
+  start = timer::now();
+  applyAllocPolicy(alloc_gcx);
+  stop = timer::now();
+  cout << "time to apply the allocation policy (ms): " << duration_cast<milliseconds>(stop - start).count() << endl;
+  cout << "allocation policy: " << allocTypeName(alloc_gcx) << ", AnonHugePages (bytes): " << anonHugePagesBytes() << endl;
   // slp.printStatus();
 
   start = timer::now();
   std::ifstream query(query_file);
   vector<pair<uint64_t, uint64_t>> v_query;
   uint64_t l, r;
-//  query >> n >> lenExpand;
   while (query >> l >> r)
   {
     v_query.push_back(make_pair(l, r));
   }
   stop = timer::now();
   cout << "Time to load query file (ms): " << duration_cast<milliseconds>(stop - start).count() << endl;
+  if (v_query.empty()) {
+    cerr << "error: no query found in " << query_file << endl;
+    exit(1);
+  }
 
+  //// queries are inclusive intervals [l, r], as produced by generate_extract_input.py
   const uint64_t textLen = slp.getLen();
-  if (v_query[0].first >= textLen or lenExpand >= textLen or lenExpand >= textLen) {
-    cout << "firstPos, lenExpand and jump should be smaller than text length, which is " << textLen << endl;
-    exit(1);
+  uint64_t maxLen = 0;
+  uint64_t totalLen = 0;
+  for (auto p : v_query)
+  {
+    if (p.first > p.second or p.second >= textLen) {
+      cout << "query [" << p.first << ", " << p.second << "] is not a valid interval of a text of length " << textLen << endl;
+      exit(1);
+    }
+    maxLen = std::max(maxLen, p.second - p.first + 1);
+    totalLen += p.second - p.first + 1;
   }
+  const uint64_t n = v_query.size();
+  cout << "n = " << n << ", max expand size = " << maxLen << ", warmup = " << warmup_gcx << ", repetitions = " << repetitions_gcx << endl;
   string substr;
-  cout << "n = " << n << "Expand size = " << lenExpand << endl;
-  substr.resize(lenExpand);
-  auto first = std::chrono::high_resolution_clock::now();
-  auto total_time = std::chrono::high_resolution_clock::now();
-  for (auto p : v_query)
+  substr.resize(maxLen);
+  vector<double> latencies;
+  latencies.reserve(n * repetitions_gcx);
+
+  for (uint64_t w = 0; w < warmup_gcx; ++w)
+  {
+    for (auto p : v_query)
+    {
+      slp.expandSubstr(p.first, p.second - p.first + 1, substr.data());
+    }
+  }
+
+  double elapsed = 0.0;
+  const double cpuStart = gcx_probe_cpu();
+  for (uint64_t rep = 0; rep < repetitions_gcx; ++rep)
+  {
+    for (auto p : v_query)
+    {
+      auto t0 = timer::now();
+      slp.expandSubstr(p.first, p.second - p.first + 1, substr.data());
+      auto t1 = timer::now();
+      const double sec = duration<double>(t1 - t0).count();
+      latencies.push_back(sec);
+      elapsed += sec;
+    }
+  }
+  //// one batch is a pass over the whole query file, as in the other extract reports
+  elapsed /= repetitions_gcx;
+  const double cpuTime = (gcx_probe_cpu() - cpuStart) / repetitions_gcx;
+  std::sort(latencies.begin(), latencies.end());
+
+  cout << "Batch Extraction Total time(s): " << elapsed << endl;
+  cout << "Mean time (microseconds): " << elapsed / n * 1e6 << endl;
+  cout << "p50/p90/p99 (microseconds): " << percentile(latencies, 0.50) * 1e6 << " / "
+       << percentile(latencies, 0.90) * 1e6 << " / " << percentile(latencies, 0.99) * 1e6 << endl;
+  cout << "Throughput: " << n / elapsed << " queries/s, " << totalLen / elapsed / (1024.0 * 1024.0) << " MB/s" << endl;
+
+  //// concurrent mode: throughput scaling over 1, 2, 4, ..., threads_gcx threads
+  if (threads_gcx > 1)
   {
-    auto beg = p.first;
-    auto t0 = std::chrono::high_resolution_clock::now();
-    slp.expandSubstr(beg, lenExpand, substr.data());
-    auto t1 = std::chrono::high_resolution_clock::now();
-    total_time += t1 - t0;
+    vector<uint64_t> counts;
+    for (uint64_t t = 1; t < threads_gcx; t *= 2)
+    {
+      counts.push_back(t);
+    }
+    counts.push_back(threads_gcx);
+    double base = 0.0;
+    for (auto t : counts)
+    {
+      double wall = 0.0;
+      for (uint64_t rep = 0; rep < repetitions_gcx; ++rep)
+      {
+        wall += expandConcurrent(slp, v_query, maxLen, t);
+      }
+      wall /= repetitions_gcx;
+      if (t == 1) {
+        base = wall;
+      }
+      cout << "threads = " << t << ": " << n / wall << " queries/s, "
+           << totalLen / wall / (1024.0 * 1024.0) << " MB/s, speedup " << base / wall << endl;
+    }
   }
-  std::chrono::duration<double> elapsed = total_time - first;
 
-  cout << "Batch Extraction Total time(s): " << elapsed.count() << endl;
-  cout << "Mean time (microseconds): " << elapsed.count() / n * 1e6 << endl;
-  fprintf(report_gcx, "0|0|%5.4lf|", elapsed);
-  printf("Time inserted into the gcx report: %5.4lf\n", elapsed);
-  fclose(report_gcx);
+  return {loadTime, elapsed, cpuTime, (long long int)malloc_count_peak(), (long long int)stack_count_usage(base_gcx),
+          gcx_probe_peak_rss(), maxLen};
+}
+
+// record of gcx_record.h; a NULL file or encoding is taken from the environment
+void recordMeasurement(const char * file, const char * encoding, const Measurement & m)
+{
+  gcx_record r;
+  gcx_record_begin(&r, "ExtractBenchmark", "extraction", file, encoding, NULL);
+  gcx_record_double(&r, "load_time", m.loadTime);
+  gcx_record_double(&r, "wall", m.extractTime);
+  gcx_record_double(&r, "cpu", m.extractCpu);
+  gcx_record_int(&r, "peak", m.peak);
+  gcx_record_int(&r, "stack", m.stack);
+  gcx_record_int(&r, "peak_rss", m.peakRss);
+  gcx_record_int(&r, "longest_query", (long long)m.substrLen);
+  gcx_record_write(&r);
+}
+
+FILE * openReport(const string & file)
+{
+  FILE *report = fopen(file.c_str(), "a");
+  if (report == NULL) {
+    cerr << "error: cannot open report file " << file << endl;
+    exit(1);
+  }
+  return report;
 }
 
 int main(int argc, char *argv[])
@@ -91,7 +248,7 @@ int main(int argc, char *argv[])
   using Vlc64 = VlcVec<sdsl::coder::elias_delta, 64>;
   using Vlc128 = VlcVec<sdsl::coder::elias_delta, 128>;
   using funcs_type = map<string,
-                         void (*)(
+                         Measurement (*)(
                              std::string in,
                              string query_file)>;
   funcs_type funcs;
@@ -141,25 +298,63 @@ int main(int argc, char *argv[])
 
   cmdline::parser parser;
   parser.add<string>("input", 'i', "input file name in which ShapedSlp data structure is written.", true);
-  parser.add<string>("encoding", 'e', "encoding: " + methodList, true);
+  parser.add<string>("encoding", 'e', "encoding: " + methodList + "All (input is then the prefix of <input><encoding> files).", true);
   parser.add<string>("query_file", 'q', "query file containing the interval of substring to be extracted", true);
   parser.add<string>("file_report_gcx", 'r', "report gcx", true);
+  parser.add<string>("label", 'l', "file column of the rows written by All (default: input)", false, "");
+  parser.add<string>("sweep_report", 's', "All: also append file|encoding|load_time|peak|stack|extract_time|encoded_size|substring_size rows here", false, "");
+  parser.add<uint64_t>("warmup", 'w', "number of untimed passes over the query file", false, 1);
+  parser.add<uint64_t>("repetitions", 'n', "number of timed passes over the query file", false, 5);
+  parser.add<string>("alloc", 'a', "page policy of the loaded SLP: MALLOC, SMALLPAGE, TRANSHUGEPAGE or FORCEHUGEPAGE", false, "MALLOC");
+  parser.add<uint64_t>("threads", 't', "maximum number of query threads; >1 also reports scaling from 1 thread", false, 1);
   parser.parse_check(argc, argv);
   const string in = parser.get<string>("input");
   const string encoding = parser.get<string>("encoding");
   const string query_file = parser.get<string>("query_file");
   file_gcx = parser.get<string>("file_report_gcx");
+  const string label = parser.get<string>("label").empty() ? in : parser.get<string>("label");
+  const string sweep_file = parser.get<string>("sweep_report");
+  warmup_gcx = parser.get<uint64_t>("warmup");
+  repetitions_gcx = std::max<uint64_t>(1, parser.get<uint64_t>("repetitions"));
+  threads_gcx = std::max<uint64_t>(1, parser.get<uint64_t>("threads"));
+  if (not parseAllocType(parser.get<string>("alloc"), alloc_gcx)) {
+    cerr << "error: unknown allocation policy " << parser.get<string>("alloc") << endl;
+    exit(1);
+  }
   //To GCX
-  //clock_t start_gcx, finish_gcx;
-  //void* base = stack_count_clear();
-  //double duration =0.0;
-  //auto start = timer::now();
+  base_gcx = stack_count_clear();
   if (encoding.compare("All") == 0)
   {
+    uint64_t maxFileBytes = 0;
     for (auto itr = funcs.begin(); itr != funcs.end(); ++itr)
     {
+      maxFileBytes = std::max(maxFileBytes, fileBytes(in + itr->first));
+    }
+    prepareAllocPolicy(alloc_gcx, maxFileBytes);
+    //// sweep: every encoding is loaded once and gets complete rows of its own,
+    //// with peak and stack measured from its own start
+    for (auto itr = funcs.begin(); itr != funcs.end(); ++itr)
+    {
+      const uint64_t encodedSize = fileBytes(in + itr->first);
+      if (encodedSize == 0) {
+        cerr << "warning: " << in + itr->first << " not found, skipping " << itr->first << endl;
+        continue;
+      }
       cout << itr->first << ": BEGIN" << std::endl;
-      itr->second(in + itr->first, query_file);
+      malloc_count_reset_peak();
+      base_gcx = stack_count_clear();
+      const Measurement m = itr->second(in + itr->first, query_file);
+      FILE *report_gcx = openReport(file_gcx);
+      fprintf(report_gcx, "%s|%s|%lld|%lld|%5.4lf|%5.4lf|%lld|%llu\n", label.c_str(), itr->first.c_str(), m.peak, m.stack,
+              m.extractTime, m.extractCpu, m.peakRss, (unsigned long long)m.substrLen);
+      fclose(report_gcx);
+      recordMeasurement(label.c_str(), itr->first.c_str(), m);
+      if (not sweep_file.empty()) {
+        FILE *report_sweep = openReport(sweep_file);
+        fprintf(report_sweep, "%s|%s|%5.4lf|%lld|%lld|%5.4lf|%llu|%llu\n", label.c_str(), itr->first.c_str(), m.loadTime, m.peak, m.stack,
+                m.extractTime, (unsigned long long)encodedSize, (unsigned long long)m.substrLen);
+        fclose(report_sweep);
+      }
       cout << itr->first << ": END" << std::endl;
     }
   }
@@ -168,8 +363,15 @@ int main(int argc, char *argv[])
     auto itr = funcs.find(encoding);
     if (itr != funcs.end())
     {
+      prepareAllocPolicy(alloc_gcx, fileBytes(in));
       cout << itr->first << ": BEGIN" << std::endl;
-      itr->second(in, query_file);
+      const Measurement m = itr->second(in, query_file);
+      //// the script has already written file|encoding| and appends the substring size
+      FILE *report_gcx = openReport(file_gcx);
+      fprintf(report_gcx, "%lld|%lld|%5.4lf|%5.4lf|%lld|", m.peak, m.stack, m.extractTime, m.extractCpu, m.peakRss);
+      printf("Time inserted into the gcx report: %5.4lf (cpu %5.4lf)\n", m.extractTime, m.extractCpu);
+      fclose(report_gcx);
+      recordMeasurement(NULL, NULL, m);
       cout << itr->first << ": END" << std::endl;
     }
     else
@@ -178,10 +380,6 @@ int main(int argc, char *argv[])
       exit(1);
     }
   }
-  //auto stop = timer::now();
-  //duration = (double)duration_cast<seconds>(stop - start).count();
-  //To GCX
-  
 
   // { // correctness check
   //   PoSlp<var_t> poslp;
@@ -58,6 +58,15 @@ enum AllocType {
 	FORCEHUGEPAGE
 };
 
+/** The type of memory allocation used when none is given explicitly.
+ *
+ * It can be overridden at compile time, e.g. `-DSUX_DEFAULT_ALLOC_TYPE=TRANSHUGEPAGE`,
+ * to move every defaulted Vector to another page policy without touching its users.
+ */
+#ifndef SUX_DEFAULT_ALLOC_TYPE
+#define SUX_DEFAULT_ALLOC_TYPE MALLOC
+#endif
+
 /** An expandable vector with settable type of memory allocation.
  *
  * Instances of this class have a behavior similar to std::vector.
@@ -73,10 +82,10 @@ enum AllocType {
  * serialization and deserialization.
  *
  * @tparam T the data type of an element.
- * @tparam AT a type of memory allocation out of ::AllocType.
+ * @tparam AT a type of memory allocation out of ::AllocType (default: SUX_DEFAULT_ALLOC_TYPE).
  */
 
-template <typename T, AllocType AT = MALLOC> class Vector : public Expandable {
+template <typename T, AllocType AT = SUX_DEFAULT_ALLOC_TYPE> class Vector : public Expandable {
 
 #ifndef MAP_HUGETLB
 #pragma message("Huge pages not supported")
@@ -4,22 +4,110 @@ source utils.sh
 readonly LCP_WINDOW=(2 4 8 16 32)
 readonly COVERAGE_LIST=(2 4 8 16 32 64 128)
 readonly STR_LEN=(1 10 100 1000 10000)
-readonly EXTRACT_ENCODING=("PlainSlp_32Fblc"  "PlainSlp_FblcFblc")
+# non-uniform query workloads of extract-workload, and the lengths they are measured at
+readonly EXTRACT_WORKLOADS=(zipf sequential clustered readahead)
+readonly WORKLOAD_STR_LEN=(100 10000)
+readonly SEVEN_ZIP_CHUNK_SIZES=(64k 256k 1m 4m)
+readonly EXTRACT_ENCODING=("PlainSlp_FblcFblc" "PlainSlp_IblcFblc" "PlainSlp_32Fblc" "PoSlp_Iblc" "PoSlp_Sd"
+	"ShapedSlp_SdMclSd_SdMcl" "ShapedSlp_SdSdSd_SdMcl" "ShapedSlpV2_Sd_SdMcl"
+	"SelfShapedSlp_SdSd_Sd" "SelfShapedSlp_SdSd_Mcl" "SelfShapedSlpV2_SdSd_Sd")
 
 #cabeçalhos
-readonly COMPRESSION_HEADER="file|algorithm|peak_comp|stack_comp|compression_time|peak_decomp|stack_decomp|decompression_time|compressed_size|plain_size"
-readonly EXTRACTION_HEADER="file|algorithm|peak|stack|time|substring_size"
+readonly COMPRESSION_HEADER="file|algorithm|peak_comp|stack_comp|compression_time|compression_cpu|peak_rss_comp|peak_decomp|stack_decomp|decompression_time|decompression_cpu|peak_rss_decomp|compressed_size|plain_size"
+readonly EXTRACTION_HEADER="file|algorithm|peak|stack|time|cpu|peak_rss|substring_size"
+readonly WORKLOAD_EXTRACTION_HEADER="file|algorithm|peak|stack|time|cpu|peak_rss|workload"
+# peak of GLZA is the heap with its available_RAM reservation (-r); peak_rss is the memory it touched
+readonly GLZA_PHASES_HEADER="file|phase|wall|cpu|peak|stack|peak_rss"
+readonly SEVEN_ZIP_BENCH_HEADER="file|threads|dictionary|comp_wall|comp_cpu|comp_peak_rss|decomp_wall|decomp_cpu|decomp_peak_rss|compressed_size|plain_size"
+readonly GCIS_PERF_HEADER="file|algorithm|substring_size|mode|phase|level|calls|time|cycles|instructions|llc_misses|dtlb_misses|branch_misses"
+readonly GCIS_TIMELINE_HEADER="file|algorithm|mode|time|kind|name|level|current|peak"
+readonly GCIS_KERNELS_HEADER="label|input|kernel|codec|level|n|items|rounds|ns_per_item|min_ns_per_item|max_ns_per_item"
+readonly SLP_SWEEP_HEADER="file|encoding|load_time|peak|stack|extract_time|encoded_size|substring_size"
 readonly HEADER_REPORT_GRAMMAR="file|algorithm|nLevels|xs_size|level_cover_qtyRules|compressed_size|plain_size"
 
 # paths
 readonly GCIS_EXECUTABLE="external/GCIS/build/src/./gcis"
+readonly GCIS_PERF_EXECUTABLE="external/GCIS/build/src/./gcis-perf"
+readonly GCIS_TIMELINE_EXECUTABLE="external/GCIS/build/src/./gcis-timeline"
+readonly GCIS_BENCH_EXECUTABLE="external/GCIS/build/src/./gcis-bench"
+readonly GCIS_KERNELS_EXECUTABLE="external/GCIS/build/src/./gcis-kernels"
+readonly EXTRACT_WORKLOAD_EXECUTABLE="external/GCIS/build/src/./extract-workload"
+readonly EXTRACT_VERIFY_EXECUTABLE="external/GCIS/build/src/./extract-verify"
 readonly REPAIR_EXECUTABLE="external/GCIS/external/repair-navarro"
 readonly GLZA_EXECUTABLE="external/GLZA"
+readonly SETE_ZIP_EXECUTABLE="external/7zip/CPP/7zip/Bundles/Alone2/_o/./7zz"
 readonly GCX_PATH="../GCX/gcx/"
 readonly GCX_MAIN_EXEC_PATH="$(pwd)/gcx_output"
 readonly GC_STAR_PATH="../GCX/gc_/"
 readonly GC_STAR_MAIN_EXEC_PATH="$(pwd)/gc_star_output"
 
+# records of every tool (gcx_record.h), absolute since some tools run from other folders
+export GCX_RECORDS="$(pwd)/$REPORT_DIR/$CURR_DATE/records.jsonl"
+export GCX_GIT_REV=$(git rev-parse --short HEAD 2>/dev/null)
+
+# job queue run by scripts/scheduler.py. Every queued job is timed, so by default they run one
+# after another; with MAX_JOBS > 1 (0: one job per core) their times are measured while sharing
+# the caches and the memory bandwidth, and their records get the parameter max_jobs.
+readonly JOBS_DIR="$REPORT_DIR/$CURR_DATE/jobs"
+MAX_JOBS=${MAX_JOBS:-1}
+# passes over the queue: every report gets one row per pass, the samples of scripts/compare_runs.py
+REPETITIONS=${REPETITIONS:-1}
+MEMORY_BUDGET=${MEMORY_BUDGET:-0} # bytes, 0: 80% of the available memory
+
+
+# record_context <file> <algorithm> [key=value,...]
+# File, algorithm and parameters of the records written by the tools run next. Every job
+# runs in its own shell, so the context of concurrent jobs never mixes.
+record_context() {
+	export GCX_RECORD_FILE=$1 GCX_RECORD_ALGORITHM=$2 GCX_RECORD_PARAMS=${3:-}
+	if [ "$MAX_JOBS" != 1 ]; then
+		GCX_RECORD_PARAMS+="${GCX_RECORD_PARAMS:+,}max_jobs=$MAX_JOBS"
+	fi
+}
+
+# JSON string of $1: backslashes, quotes and control characters escaped
+json_string() {
+	local value=$1
+	value=${value//\\/\\\\}
+	value=${value//\"/\\\"}
+	value=${value//$'\n'/\\n}
+	value=${value//$'\r'/\\r}
+	value=${value//$'\t'/\\t}
+	printf '"%s"' "$value"
+}
+
+# record_metrics <phase> <name>=<number>...
+# A record of what the script measures itself (sizes, tools without a hook) in the current
+# context, appended with a single write like those of gcx_record.h. A metric that is not a
+# number (e.g. the empty size of a failed run) is left out with a warning, and reads as NA.
+record_metrics() {
+	local phase=$1 metrics="" params="" pair value
+	shift
+	for pair in "$@"; do
+		value=${pair#*=}
+		if [[ ! "$value" =~ ^-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][-+]?[0-9]+)?$ ]]; then
+			echo "record_metrics: ${pair%%=*} of $GCX_RECORD_FILE|$GCX_RECORD_ALGORITHM is not a number ('$value'), left out" >&2
+			continue
+		fi
+		metrics+="${metrics:+,}$(json_string "${pair%%=*}"):$value"
+	done
+	IFS=',' read -ra pairs <<< "$GCX_RECORD_PARAMS"
+	for pair in "${pairs[@]}"; do
+		params+="${params:+,}$(json_string "${pair%%=*}"):$(json_string "${pair#*=}")"
+	done
+	printf '{"tool":"measure_compression.sh","phase":%s,"file":%s,"algorithm":%s,"params":{%s},"host":%s,"git_rev":%s,"pid":%d,"unix_time":%d,"metrics":{%s}}\n' \
+		"$(json_string "$phase")" "$(json_string "$GCX_RECORD_FILE")" "$(json_string "$GCX_RECORD_ALGORITHM")" "$params" \
+		"$(json_string "$(hostname)")" "$(json_string "$GCX_GIT_REV")" $$ "$(date +%s)" "$metrics" >> "$GCX_RECORDS"
+}
+
+# parameter of the extract records for the last column of a row: substring size or workload
+extract_params() {
+	if [[ "$1" =~ ^[0-9]+$ ]]; then
+		echo "substring_size=$1"
+	else
+		echo "workload=$1"
+	fi
+}
 
 compress_and_decompress_with_gcis() {
 	echo -e "\n\t\t ${YELLOW}Starting compression/decompression using GCIS-$1 ${RESET}\n"
@@ -28,17 +116,72 @@ compress_and_decompress_with_gcis() {
 	REPORT=$3
 	FILE_NAME=$4
 	OUTPUT="$COMP_DIR/$CURR_DATE/$FILE_NAME"
-	echo -n "$FILE_NAME|GCIS-${CODEC}|" >> $report
+	echo -n "$FILE_NAME|GCIS-${CODEC}|" >> $REPORT
+	record_context "$FILE_NAME" "GCIS-${CODEC}"
 	echo -e "${GREEN}Comprimindo arquivo...${RESET}\n"
 	"$GCIS_EXECUTABLE" -c "$PLAIN" "$OUTPUT-gcis-$CODEC" "-$CODEC" "$REPORT"
 	echo -e "${GREEN}Descomprimindo arquivo.. ${RESET}\n."
 	"$GCIS_EXECUTABLE" -d "$OUTPUT-gcis-$CODEC" "$OUTPUT-gcis-$CODEC-plain" "-$CODEC" "$REPORT"
-	echo "$(stat $stat_options $OUTPUT-gcis-$CODEC)|$5" >> $REPORT
+	size=$(stat $stat_options $OUTPUT-gcis-$CODEC)
+	echo "$size|$5" >> $REPORT
+	record_metrics size compressed_size=$size plain_size=$5
 
 	checks_equality "$PLAIN" "$OUTPUT-gcis-$CODEC-plain" "gcis"
 	echo -e "\n\t ${YELLOW}Finishing compression/decompression operations on the $FILE file using GCIS-$CODEC. ${RESET}\n"
 }
 
+# hardware counters of each GCIS phase (gcis-perf, NA where perf_event_open is not allowed)
+# count_gcis_phases encode <codec> <plain> <perf report> <file>
+# count_gcis_phases extract <codec> <compressed> <perf report> <file> <query> <length>
+count_gcis_phases() {
+	mode=$1
+	codec=$2
+	input=$3
+	perf_report=$4
+	file_name=$5
+	output="$COMP_DIR/$CURR_DATE/$file_name-gcis-$codec-perf"
+	phases="$output.csv"
+
+	echo -e "\n\t\t ${YELLOW}Counting the phases of GCIS-$codec ($mode) - $file_name ${RESET}\n"
+	rm -f "$phases"
+	# the gcx report and the records of these runs are not used
+	local GCX_RECORDS=
+	if [ "$mode" = "encode" ]; then
+		"$GCIS_PERF_EXECUTABLE" -c "$input" "$output" "-$codec" /dev/null "$phases"
+		"$GCIS_PERF_EXECUTABLE" -d "$output" "$output-plain" "-$codec" /dev/null "$phases"
+		sed "s/^/$file_name|GCIS-$codec|0|/" "$phases" >> $perf_report
+		rm -f "$output" "$output-plain"
+	else
+		"$GCIS_PERF_EXECUTABLE" -e "$input" "$6" "-$codec" /dev/null "$phases" > /dev/null
+		sed "s/^/$file_name|GCIS-$codec|$7|/" "$phases" >> $perf_report
+	fi
+	rm -f "$phases"
+}
+
+# heap at each event of GCIS (level, t, bkt, SA, next_r_string...) and sampled in between (gcis-timeline)
+# Its times include a clock read on every malloc/free and are not comparable with those of gcis.
+# Only ef has decode events (the s8b decoder is the upstream one), so s8b records its encoding only.
+# record_gcis_timeline <codec> <plain> <timeline report> <file>
+record_gcis_timeline() {
+	codec=$1
+	input=$2
+	timeline_report=$3
+	file_name=$4
+	output="$COMP_DIR/$CURR_DATE/$file_name-gcis-$codec-timeline"
+	timeline="$output.csv"
+
+	echo -e "\n\t\t ${YELLOW}Recording the memory timeline of GCIS-$codec - $file_name ${RESET}\n"
+	rm -f "$timeline"
+	# the gcx report and the records of these runs are not used
+	local GCX_RECORDS=
+	"$GCIS_TIMELINE_EXECUTABLE" -c "$input" "$output" "-$codec" /dev/null "$timeline"
+	if [ "$codec" = "ef" ]; then
+		"$GCIS_TIMELINE_EXECUTABLE" -d "$output" "$output-plain" "-$codec" /dev/null "$timeline"
+	fi
+	sed "s/^/$file_name|GCIS-$codec|/" "$timeline" >> $timeline_report
+	rm -f "$output" "$output-plain" "$timeline"
+}
+
 compress_and_decompress_with_repair() {
 	echo -e "\n\t\t ${YELLOW}Starting compression/decompression using REPAIR ${RESET}\n"
 	FILE=$1
@@ -48,12 +191,16 @@ compress_and_decompress_with_repair() {
 	size_plain=$4
 	cp $FILE "$FILE-repair" #faz uma cópia do arquivo, para não ter sobrescrita do original ao descompactar
 	
-	"${REPAIR_EXECUTABLE}/./repair-navarro" "$FILE-repair" "$REPORT"
-	"${REPAIR_EXECUTABLE}/./despair-navarro" "$FILE-repair" "$REPORT"
+	# repair and despair write their times to a report of their own, the start of every REPAIR-<encoding> row
+	repair_report="$OUTPUT-repair-report.csv"
+	rm -f "$repair_report"
+	record_context "$FILE_NAME" "REPAIR"
+	"${REPAIR_EXECUTABLE}/./repair-navarro" "$FILE-repair" "$repair_report"
+	"${REPAIR_EXECUTABLE}/./despair-navarro" "$FILE-repair" "$repair_report"
 	checks_equality "$FILE" "$FILE-repair" "repair"
 
-	repair_report_entry=$(tail -n 1 "$REPORT") #pega a linha gravada pelo repair
-	sed -i '$d' "$REPORT" #apaga a linha recém gravada
+	repair_report_entry=$(tail -n 1 "$repair_report")
+	rm -f "$repair_report"
 
 	size_c=$(stat $stat_options $FILE-repair.C)
 	size_r=$(stat $stat_options $FILE-repair.R)
@@ -65,8 +212,11 @@ compress_and_decompress_with_repair() {
 		size_slp=$(stat $stat_options $FILE-$encoding)
 		size=$((size_c + size_r + size_slp))
 
-		echo -n "$FILE_NAME|REPAIR-$encoding|" >> $report
+		echo -n "$FILE_NAME|REPAIR-$encoding|" >> $REPORT
 		echo "${repair_report_entry}$size|$size_plain" >> "$REPORT"
+		# the times are those of the REPAIR records
+		record_context "$FILE_NAME" "REPAIR-$encoding" "timing=REPAIR"
+		record_metrics size compressed_size=$size plain_size=$size_plain
 
 		echo -e "\nTamanhos: Size C $size_c , size R $size_r, size SLP $size_slp, total: $size\n\n"
 	done
@@ -82,19 +232,41 @@ compress_and_decompress_with_7zip() {
 	compressed_file="$COMP_DIR/$CURR_DATE/$file"
 	decompressed_file="$COMP_DIR/$CURR_DATE"
 
-	SETE_ZIP_EXECUTABLE="external/7zip/CPP/7zip/Bundles/Alone2/_o/./7zz"
-
 	echo -e "\n\t\t ${YELLOW}Starting compression using 7zip ${RESET}\n"
 	echo -n "$file|7zip|" >> $report
+	record_context "$file" "7zip"
 	
+	# a new archive every time: 7zz a would update the archive of an earlier pass, copying the file from it
+	rm -f "$compressed_file.7z"
 	cd $RAW_FILES_DIR # é necessário alterar a pasta, para ele não inserir o path do arquivo
 	"../../$SETE_ZIP_EXECUTABLE" a "../../$compressed_file.7z" "$file" -gcx_report="../../$report"
 	cd ../../
 	echo -e "\n\t\t ${YELLOW}Starting decompression using 7zip ${RESET}\n"
-	"$SETE_ZIP_EXECUTABLE" x $compressed_file.7z -o$decompressed_file -gcx_report="$report"
+	# -aoa: overwrite without asking, the jobs have no terminal to answer on
+	"$SETE_ZIP_EXECUTABLE" x $compressed_file.7z -o$decompressed_file -aoa -gcx_report="$report"
 	
 	size=$(stat $stat_options $compressed_file.7z)
 	echo "$size|$size_plain" >> $report
+	record_metrics size compressed_size=$size plain_size=$size_plain
+
+	echo -e "\n\t\t ${YELLOW}Sweeping 7zip threads and dictionary sizes in memory ${RESET}\n"
+	# the header is written once by evaluate_compression_performance, the passes append their rows
+	bench_report="$REPORT_DIR/$CURR_DATE/$file-7zip-bench.csv"
+	"$SETE_ZIP_EXECUTABLE" -gcx_bench="$plain_file_path" -gcx_report="$bench_report"
+
+	# chunked LZMA2 files, the random access baseline of run_extract
+	for chunk in "${SEVEN_ZIP_CHUNK_SIZES[@]}"; do
+		echo -e "\n\t\t ${YELLOW}Starting chunked compression using 7zip - chunks of $chunk ${RESET}\n"
+		echo -n "$file|7zip-c$chunk|" >> $report
+		record_context "$file" "7zip-c$chunk"
+		"$SETE_ZIP_EXECUTABLE" -gcx_chunk=$chunk "$plain_file_path" "$compressed_file-c$chunk.7zc" -gcx_report="$report"
+		"$SETE_ZIP_EXECUTABLE" -gcx_unchunk "$compressed_file-c$chunk.7zc" "$decompressed_file/$file-c$chunk" -gcx_report="$report"
+		size=$(stat $stat_options $compressed_file-c$chunk.7zc)
+		echo "$size|$size_plain" >> $report
+		record_metrics size compressed_size=$size plain_size=$size_plain
+		checks_equality "$plain_file_path" "$decompressed_file/$file-c$chunk" "7zip"
+		rm "$decompressed_file/$file-c$chunk"
+	done
 
 	checks_equality "$plain_file_path" $decompressed_file/$file "7zip"
 	rm $decompressed_file/$file
@@ -108,181 +280,565 @@ compress_and_decompress_with_bzip2() {
 	file_name=$3
 	output="$COMP_DIR/$CURR_DATE/$file_name"
 	size_plain=$4
+	threads=${5:-1}
 
 	cp $file $output #faz uma cópia do arquivo, para não ter sobrescrita do original ao descompactar
-	echo -n "$file_name|bzip2|" >> $report
+	# with threads the times are wall clock, so the row gets its own label
+	if [ "$threads" -gt 1 ]; then
+		echo -n "$file_name|bzip2-t$threads|" >> $report
+		record_context "$file_name" "bzip2-t$threads" "threads=$threads"
+	else
+		echo -n "$file_name|bzip2|" >> $report
+		record_context "$file_name" "bzip2"
+	fi
 	BZIP2_EXECUTABLE="external/bzip2/build/./bzip2"
 
-	echo -e "\n\t\t ${YELLOW}Starting compression using Bzip2 ${RESET}\n"
-	"$BZIP2_EXECUTABLE" -f $output --gcx_report="$report"
+	echo -e "\n\t\t ${YELLOW}Starting compression using Bzip2 ($threads threads) ${RESET}\n"
+	# the serial row measures the stock compressStream; --index goes through the block pipeline
+	if [ "$threads" -gt 1 ]; then
+		"$BZIP2_EXECUTABLE" -f $output --threads=$threads --index --gcx_report="$report"
+	else
+		"$BZIP2_EXECUTABLE" -f $output --threads=1 --gcx_report="$report"
+	fi
 	
-	echo -e "\n\t\t ${YELLOW}Starting decompression using Bzip2 ${RESET}\n"
-	"$BZIP2_EXECUTABLE" -d -kf $output.bz2 --gcx_report="$report"
+	echo -e "\n\t\t ${YELLOW}Starting decompression using Bzip2 ($threads threads) ${RESET}\n"
+	"$BZIP2_EXECUTABLE" -d -kf $output.bz2 --threads=$threads --gcx_report="$report"
 	
 	size=$(stat $stat_options $output.bz2)
 	echo "$size|$size_plain" >> $report
+	record_metrics size compressed_size=$size plain_size=$size_plain
+
+	checks_equality "$file" $output "bz2"
 
-	checks_equality "$plain_file_path" $output "bz2"
+	# block index of extract_with_bzip2, not measured
+	if [ "$threads" -eq 1 ]; then
+		GCX_RECORDS= "$BZIP2_EXECUTABLE" -kf $output --threads=1 --index --gcx_report=/dev/null
+	fi
 
 	echo -e "\n\t ${YELLOW}Finishing compression/decompression operations on the $file file using Bzip2. ${RESET}\n"
 }
 
+compress_and_decompress_with_glza() {
+	file=$1
+	report=$2
+	file_name=$3
+	output="$COMP_DIR/$CURR_DATE/$file_name"
+	size_plain=$4
+	phase_report="$REPORT_DIR/$CURR_DATE/$file_name-glza-phases.csv"
+
+	echo $GLZA_PHASES_HEADER > $phase_report
+	echo -n "$file_name|GLZA|" >> $report
+	record_context "$file_name" "GLZA"
+
+	# GLZAformat and GLZAencode are linear passes around the grammar construction, which is what GLZAcompress reports
+	echo -e "\n\t\t ${YELLOW}Starting compression using GLZA ${RESET}\n"
+	"$GLZA_EXECUTABLE/GLZAformat" "$file" "$output.glzf"
+	"$GLZA_EXECUTABLE/GLZAcompress" --gcx_report="$report" --gcx_phase_report="$phase_report" "$output.glzf" "$output.glzc"
+	"$GLZA_EXECUTABLE/GLZAencode" "$output.glzc" "$output.glza"
+
+	# GLZAdecode has no report hook, so only its wall time is recorded
+	echo -e "\n\t\t ${YELLOW}Starting decompression using GLZA ${RESET}\n"
+	start=$(wall_clock)
+	"$GLZA_EXECUTABLE/GLZAdecode" "$output.glza" "$output-glza-plain"
+	end=$(wall_clock)
+	wall=$(awk -v start=$start -v end=$end 'BEGIN { printf "%5.4f", end - start }')
+	echo -n "0|0|$wall|NA|NA|" >> $report
+	record_metrics decompression peak=0 stack=0 wall=$wall
+
+	size=$(stat $stat_options $output.glza)
+	echo "$size|$size_plain" >> $report
+	record_metrics size compressed_size=$size plain_size=$size_plain
+
+	checks_equality "$file" "$output-glza-plain" "glza"
+	rm "$output.glzf" "$output.glzc" "$output-glza-plain"
+
+	echo -e "\n\t ${YELLOW}Finishing compression/decompression operations on the $file file using GLZA. ${RESET}\n"
+}
+
 compress_and_decompress_with_gcx() {
 	plain_file_path=$1
 	report=$2
 	file=$3
 	size_plain=$4
+	cover=$5
+	grammar_report=$6
 
-    grammar_report="$REPORT_DIR/$CURR_DATE/$file-gcx-grammar.csv"
-    echo $HEADER_REPORT_GRAMMAR > $grammar_report;
-	
-	#perform compress and decompress with GCX
 	echo -e "\n\t\t ${YELLOW}Starting compression/decompression using GCX ${RESET}\n"
-	for cover in "${LCP_WINDOW[@]}"; do
-		echo -e "\tUsing initial window of size $cover for LCP calculation.\n"
-		echo -n "$file|GCX-y$cover|" >> $report
-		echo -n "$file|GCX-y$cover|" >> $grammar_report
-
-		file_out="$COMP_DIR/$CURR_DATE/$file-y$cover"
-		./gcx_output -c $plain_file_path $file_out $report $cover
-		./gcx_output -d $file_out.gcx $file_out-plain $report
-		checks_equality "$plain_file_path" "$file_out-plain" "gcx"
-		
-		compressed_size=$(stat $stat_options $file_out.gcx)
-		echo "$compressed_size|$size_plain" >> $report
-		echo "|$compressed_size|$size_plain" >> $grammar_report
-	done
+	echo -e "\tUsing initial window of size $cover for LCP calculation.\n"
+	echo -n "$file|GCX-y$cover|" >> $report
+	echo -n "$file|GCX-y$cover|" >> $grammar_report
+
+	file_out="$COMP_DIR/$CURR_DATE/$file-y$cover"
+	# GCX writes peak|stack|time only, its cpu and peak_rss are padded
+	./gcx_output -c $plain_file_path $file_out $report $cover
+	echo -n "NA|NA|" >> $report
+	./gcx_output -d $file_out.gcx $file_out-plain $report
+	echo -n "NA|NA|" >> $report
+	checks_equality "$plain_file_path" "$file_out-plain" "gcx"
+
+	compressed_size=$(stat $stat_options $file_out.gcx)
+	echo "$compressed_size|$size_plain" >> $report
+	echo "|$compressed_size|$size_plain" >> $grammar_report
+}
+
+compress_and_decompress_with_gc_star() {
+	plain_file_path=$1
+	report=$2
+	file=$3
+	size_plain=$4
+	cover=$5
+	grammar_report=$6
 
-	#perform compress and decompress with GC*
+	echo -e "\n\t${BLUE}####### FILE: $file, COVERAGE: ${cover} ${RESET}"
 	echo -e "\n\t\t ${YELLOW}Starting compression/decompression using GC* ${RESET}\n"
-	for cover in "${COVERAGE_LIST[@]}"; do
-		echo -e "\n\t${BLUE}####### FILE: $file, COVERAGE: ${cover} ${RESET}"
-		echo -n "$file|GC$cover|" >> $report
-		echo -n "$file|GC$cover|" >> $grammar_report
+	echo -n "$file|GC$cover|" >> $report
+	echo -n "$file|GC$cover|" >> $grammar_report
+
+	file_out="$COMP_DIR/$CURR_DATE/$file-gc$cover"
+	./gc_star_output -c $plain_file_path $file_out $cover $report
+	echo -n "NA|NA|" >> $report
+	./gc_star_output -d $file_out.gcx $file_out-plain $cover $report
+	echo -n "NA|NA|" >> $report
+	checks_equality "$plain_file_path" "$file_out-plain" "gcx"
+
+	size_file=$(stat $stat_options $file_out.gcx)
+	echo "$size_file|$size_plain" >> $report
+}
 
-		file_out="$COMP_DIR/$CURR_DATE/$file-gc$cover"
-		./gc_star_output -c $plain_file_path $file_out $cover $report
-		./gc_star_output -d $file_out.gcx $file_out-plain $cover $report
-		checks_equality "$plain_file_path" "$file_out-plain" "gcx"
+# Starts an empty queue of jobs for scripts/scheduler.py.
+new_job_queue() {
+	rm -rf "${JOBS_DIR:?}"
+	mkdir -p "$JOBS_DIR"
+	: > "$JOBS_DIR/jobs.tsv"
+	: > "$JOBS_DIR/parts"
+	job_count=0
+}
 
-		size_file=$(stat $stat_options $file_out.gcx)
-		echo "$size_file|$size_plain" >> $report
+# queue_job <solo> <threads> <algorithms> <kind> <function> <args...>
+# Queues "<function> <args...>" for the current $file and $size_plain. <algorithms> is the
+# pattern of the rows the job writes to the <kind> (encoding or extract) report, used to
+# predict its memory from earlier reports. An argument @<report> becomes a part of
+# <report> owned by the job (same basename, in the job's folder), so that the fragments
+# of concurrent rows never interleave; run_jobs appends the parts in queue order.
+# A solo job runs alone, for multi-threaded tools and timing-sensitive measurements.
+queue_job() {
+	local solo=$1 threads=$2 algorithms=$3 kind=$4
+	shift 4
+	local job_dir="$JOBS_DIR/$(printf '%05d' $job_count)"
+	local command="" arg part
+	mkdir -p "$job_dir"
+	for arg in "$@"; do
+		if [ "${arg:0:1}" = "@" ]; then
+			part="$job_dir/$(basename "${arg:1}")"
+			if ! grep -qF "$part"$'\t' "$JOBS_DIR/parts"; then
+				printf '%s\t%s\n' "$part" "${arg:1}" >> "$JOBS_DIR/parts"
+			fi
+			arg=$part
+		fi
+		command+="$(printf '%q' "$arg") "
 	done
+	printf '%s\t%s\t%s\t%s\t%s\t%s\t%s\n' "$solo" "$threads" "$file" "$size_plain" "$algorithms" "$kind" "$command" >> "$JOBS_DIR/jobs.tsv"
+	job_count=$((job_count + 1))
+}
+
+# Runs the queue REPETITIONS times, appending the report parts of the jobs in queue order after
+# each pass. Fails (and stops) if a job failed.
+run_jobs() {
+	local status=0 pass
+	for ((pass = 1; pass <= REPETITIONS; pass++)); do
+		echo -e "\n${BLUE}####### Running $job_count jobs, pass $pass of $REPETITIONS (logs in $JOBS_DIR) ${RESET}"
+		if ! CURR_DATE="$CURR_DATE" python3 scripts/scheduler.py "$JOBS_DIR/jobs.tsv" "$REPORT_DIR" "$MAX_JOBS" "$MEMORY_BUDGET" "$pass"; then
+			echo -e "${RED}Some jobs failed, see $JOBS_DIR/schedule-$pass.csv and their logs ${RESET}"
+			status=1
+		fi
+		while IFS=$'\t' read -r part final_report; do
+			if [ -f "$part" ]; then
+				cat "$part" >> "$final_report"
+				rm "$part"
+			fi
+		done < "$JOBS_DIR/parts"
+		[ $status -ne 0 ] && break
+	done
+	return $status
 }
 
 evaluate_compression_performance() {
 	echo -e "\n${GREEN}%%% REPORT: Compresses the files, decompresses them, and compares the result with the original version${RESET}."
 
 	build_tools
+	new_job_queue
 	for file in $files; do
 		report="$REPORT_DIR/$CURR_DATE/$file-gcx-encoding.csv"
 		echo $COMPRESSION_HEADER > $report;
+		grammar_report="$REPORT_DIR/$CURR_DATE/$file-gcx-grammar.csv"
+		echo $HEADER_REPORT_GRAMMAR > $grammar_report;
+		perf_report="$REPORT_DIR/$CURR_DATE/$file-gcis-perf.csv"
+		echo $GCIS_PERF_HEADER > $perf_report;
+		timeline_report="$REPORT_DIR/$CURR_DATE/$file-gcis-timeline.csv"
+		echo $GCIS_TIMELINE_HEADER > $timeline_report;
+		echo $SEVEN_ZIP_BENCH_HEADER > "$REPORT_DIR/$CURR_DATE/$file-7zip-bench.csv"
 		plain_file_path="$RAW_FILES_DIR/$file"
 		size_plain=$(stat $stat_options $plain_file_path)
 
 		echo -e "\n\t${BLUE}####### FILE: $file ${RESET}"
 
-		#perform compress and decompress with GCX and GC*
-		compress_and_decompress_with_gcx "$plain_file_path" "$report" "$file" "$size_plain"
+		#perform compress and decompress with GCX and GC*, one job per cover
+		for cover in "${LCP_WINDOW[@]}"; do
+			queue_job 0 1 "GCX-y$cover" encoding compress_and_decompress_with_gcx "$plain_file_path" "@$report" "$file" "$size_plain" "$cover" "@$grammar_report"
+		done
+		for cover in "${COVERAGE_LIST[@]}"; do
+			queue_job 0 1 "GC$cover" encoding compress_and_decompress_with_gc_star "$plain_file_path" "@$report" "$file" "$size_plain" "$cover" "@$grammar_report"
+		done
 
 		#perform compress and decompress with GCIS
-		compress_and_decompress_with_gcis "ef" "$plain_file_path" "$report" "$file" "$size_plain"
-		compress_and_decompress_with_gcis "s8b" "$plain_file_path" "$report" "$file" "$size_plain"
+		queue_job 0 1 "GCIS-ef" encoding compress_and_decompress_with_gcis "ef" "$plain_file_path" "@$report" "$file" "$size_plain"
+		queue_job 0 1 "GCIS-s8b" encoding compress_and_decompress_with_gcis "s8b" "$plain_file_path" "@$report" "$file" "$size_plain"
+		if [ -x "$GCIS_PERF_EXECUTABLE" ]; then
+			queue_job 0 1 "GCIS-ef" encoding count_gcis_phases encode "ef" "$plain_file_path" "@$perf_report" "$file"
+			queue_job 0 1 "GCIS-s8b" encoding count_gcis_phases encode "s8b" "$plain_file_path" "@$perf_report" "$file"
+		fi
+		if [ -x "$GCIS_TIMELINE_EXECUTABLE" ]; then
+			queue_job 0 1 "GCIS-ef" encoding record_gcis_timeline "ef" "$plain_file_path" "@$timeline_report" "$file"
+			queue_job 0 1 "GCIS-s8b" encoding record_gcis_timeline "s8b" "$plain_file_path" "@$timeline_report" "$file"
+		fi
 
 		#perform compress and decompress with REPAIR
-		compress_and_decompress_with_repair "$plain_file_path" "$report" "$file" "$size_plain"
+		queue_job 0 1 "REPAIR-*" encoding compress_and_decompress_with_repair "$plain_file_path" "@$report" "$file" "$size_plain"
 
-		#perform compress and decompress with 7zip
-		compress_and_decompress_with_7zip $file $plain_file_path $report $size_plain
+		#perform compress and decompress with 7zip (multi-threaded, and its sweep measures the scaling)
+		queue_job 1 "$(nproc)" "7zip*" encoding compress_and_decompress_with_7zip "$file" "$plain_file_path" "@$report" "$size_plain"
 
 		#perform compress and decompress with bzip2
-		compress_and_decompress_with_bzip2 "$plain_file_path" "$report" "$file" "$size_plain"
+		queue_job 0 1 "bzip2" encoding compress_and_decompress_with_bzip2 "$plain_file_path" "@$report" "$file" "$size_plain" 1
+		if [ "$(nproc)" -gt 1 ]; then
+			queue_job 1 "$(nproc)" "bzip2-t*" encoding compress_and_decompress_with_bzip2 "$plain_file_path" "@$report" "$file" "$size_plain" "$(nproc)"
+		fi
+
+		#perform compress and decompress with GLZA (GLZAcompress uses a thread per core)
+		queue_job 1 "$(nproc)" "GLZA" encoding compress_and_decompress_with_glza "$plain_file_path" "@$report" "$file" "$size_plain"
 	done
+	run_jobs
+	local status=$?
 	clean_tools
+	return $status
+}
+
+# Writes the expected answer of a query file and prints its path: the XXH64 of
+# each query (extract-verify) when it is built, the substrings (scripts/extract.py) otherwise.
+# write_extract_answer <plain> <query file> <answer path without extension>
+write_extract_answer() {
+	if [ -x "$EXTRACT_VERIFY_EXECUTABLE" ]; then
+		"$EXTRACT_VERIFY_EXECUTABLE" -g "$1" "$2" "$3.xxh64"
+		echo "$3.xxh64"
+	else
+		python3 scripts/extract.py "$1" "$3.txt" "$2"
+		echo "$3.txt"
+	fi
+}
+
+# checks_extract <extract output> <answer of write_extract_answer>
+checks_extract() {
+	if [ "${2##*.}" != "xxh64" ]; then
+		checks_equality "$1" "$2" "extract"
+		return
+	fi
+	echo -e "\n\t\t ${YELLOW} Checking the extracted substrings against the expected hashes ${RESET}\n"
+	if ! mismatch=$("$EXTRACT_VERIFY_EXECUTABLE" -v "$2" "$1"); then
+		echo -e "\n\t\t\t ${RED} $mismatch ${RESET}\n"
+		echo "$1: $mismatch" >> "$GENERAL_REPORT/errors/errors-extract-compress.txt"
+	else
+		echo -e "\n\t\t\t ${GREEN} The substrings are the expected ones. ${RESET}\n"
+	fi
+}
+
+extract_with_gcx() {
+	file=$1
+	compressed_file=$2
+	query=$3
+	report=$4
+	length=$5
+	extract_answer=$6
+	cover=$7
+
+	echo -e "\n\t ${YELLOW}Starting extract with GCX - $file - INTERVAL SIZE $length.${RESET}"
+	echo -e "\tUsing initial window of size $cover for LCP calculation.\n"
+	echo -n "$file|GCX-y$cover|" >> $report
+	extract_output="$REPORT_DIR/$CURR_DATE/extract/${file}_result_extract_gcx_y${cover}_len${length}.txt"
+	./gcx_output -e "$compressed_file-y$cover.gcx" $extract_output $query $report
+	echo "NA|NA|$length" >> $report
+	checks_extract "$extract_output" "$extract_answer"
+	rm $extract_output
+}
+
+extract_with_gc_star() {
+	file=$1
+	compressed_file=$2
+	query=$3
+	report=$4
+	length=$5
+	extract_answer=$6
+	cover=$7
+
+	echo -e "\n\t ${YELLOW}Starting extract with GC* - INTERVAL SIZE $length.${RESET}"
+	echo -n "$file|GC$cover|" >> $report
+	extract_output="$REPORT_DIR/$CURR_DATE/extract/${file}_result_extract_gc${cover}_len${length}.txt"
+	./gc_star_output -e "$compressed_file-gc$cover.gcx" $extract_output $cover $query $report
+	echo "NA|NA|$length" >> $report
+	checks_extract "$extract_output" "$extract_answer"
+	rm $extract_output
+}
+
+# extract on the block index written by compress_and_decompress_with_bzip2
+extract_with_bzip2() {
+	file=$1
+	compressed_file=$2
+	query=$3
+	report=$4
+	length=$5
+	extract_answer=$6
+
+	echo -e "\n${YELLOW}Starting extract with bzip2 - $file - INTERVAL SIZE $length.${RESET}"
+	echo -n "$file|bzip2|" >> $report
+	record_context "$file" "bzip2" "$(extract_params $length)"
+	extract_output="$REPORT_DIR/$CURR_DATE/extract/${file}_result_extract_bzip2_len${length}.txt"
+	"external/bzip2/build/./bzip2" -e $query --extract_output=$extract_output --gcx_report="$report" "$compressed_file.bz2"
+	echo "$length" >> $report
+	checks_extract "$extract_output" "$extract_answer"
+	rm $extract_output
+}
+
+# extract on the chunked LZMA2 file of one chunk size
+extract_with_7zip() {
+	file=$1
+	compressed_file=$2
+	query=$3
+	report=$4
+	length=$5
+	extract_answer=$6
+	chunk=$7
+
+	echo -e "\n${YELLOW}Starting extract with 7zip (chunks of $chunk) - $file - INTERVAL SIZE $length.${RESET}"
+	echo -n "$file|7zip-c$chunk|" >> $report
+	record_context "$file" "7zip-c$chunk" "$(extract_params $length)"
+	extract_output="$REPORT_DIR/$CURR_DATE/extract/${file}_result_extract_7zip_c${chunk}_len${length}.txt"
+	"$SETE_ZIP_EXECUTABLE" -gcx_extract=$query "$compressed_file-c$chunk.7zc" $extract_output -gcx_report="$report"
+	echo "$length" >> $report
+	checks_extract "$extract_output" "$extract_answer"
+	rm $extract_output
+}
+
+extract_with_gcis() {
+	file=$1
+	compressed_file=$2
+	query=$3
+	report=$4
+	length=$5
+
+	echo -e "\n${YELLOW}Starting extract with GCIS - $file - INTERVAL SIZE $length.${RESET}"
+	echo -n "$file|GCIS-ef|" >> $report
+	record_context "$file" "GCIS-ef" "$(extract_params $length)"
+	$GCIS_EXECUTABLE -e "$compressed_file-gcis-ef" $query -ef $report
+	echo "$length" >> $report
+}
+
+# every SLP encoding in one run, each one writes its own rows
+extract_with_shaped_slp() {
+	file=$1
+	plain_file_path=$2
+	query=$3
+	report=$4
+	length=$5
+	sweep_report=$6
+
+	echo -e "\n${YELLOW} Starting extract with ShapedSlp - $file - INTERVAL SIZE $length.${RESET}"
+	record_context "$file" "" "$(extract_params $length)"
+	"external/ShapeSlp/build/./ExtractBenchmark" --input="$plain_file_path-" --encoding=All --query_file=$query --file_report_gcx=$report --label=$file --sweep_report=$sweep_report
 }
 
+# one run per SLP encoding, for reports whose last column is not the substring size
+extract_workload_with_shaped_slp() {
+	file=$1
+	plain_file_path=$2
+	query=$3
+	report=$4
+	workload=$5
+
+	echo -e "\n${YELLOW} Starting extract with ShapedSlp - $file - WORKLOAD $workload.${RESET}"
+	for encoding in "${EXTRACT_ENCODING[@]}"; do
+		echo -n "$file|$encoding|" >> $report
+		record_context "$file" "$encoding" "$(extract_params $workload)"
+		"external/ShapeSlp/build/./ExtractBenchmark" --input="$plain_file_path-$encoding" --encoding=$encoding --query_file=$query --file_report_gcx=$report
+		echo "$workload" >> $report
+	done
+}
+
+# queues the extraction of one query file by every tool that reads it;
+# column is the last column of their rows (substring size or workload)
+queue_extract_jobs() {
+	local file=$1 compressed_file=$2 query=$3 report=$4 column=$5 extract_answer=$6
+	local cover chunk
+
+	for cover in "${LCP_WINDOW[@]}"; do
+		queue_job 0 1 "GCX-y$cover" extract extract_with_gcx "$file" "$compressed_file" "$query" "@$report" "$column" "$extract_answer" "$cover"
+	done
+	for cover in "${COVERAGE_LIST[@]}"; do
+		queue_job 0 1 "GC$cover" extract extract_with_gc_star "$file" "$compressed_file" "$query" "@$report" "$column" "$extract_answer" "$cover"
+	done
+	queue_job 0 1 "bzip2" extract extract_with_bzip2 "$file" "$compressed_file" "$query" "@$report" "$column" "$extract_answer"
+	for chunk in "${SEVEN_ZIP_CHUNK_SIZES[@]}"; do
+		queue_job 0 1 "7zip-c$chunk" extract extract_with_7zip "$file" "$compressed_file" "$query" "@$report" "$column" "$extract_answer" "$chunk"
+	done
+	queue_job 0 1 "GCIS-ef" extract extract_with_gcis "$file" "$compressed_file" "$query" "@$report" "$column"
+}
 
 run_extract() {
 	build_tools
+	new_job_queue
 
 	echo -e "\n${BLUE}####### Extract validation ${RESET}"
 	for file in $files; do
 		echo -e "\n\t${BLUE}Preparing for extract operation on the $file file. ${RESET}\n"
 
 		plain_file_path="$RAW_FILES_DIR/$file"
+		size_plain=$(stat $stat_options $plain_file_path)
 		extract_dir="$REPORT_DIR/$CURR_DATE/extract"
 		compressed_file="$COMP_DIR/$CURR_DATE/$file"
 
 		report="$REPORT_DIR/$CURR_DATE/$file-gcx-extract.csv"
 		echo $EXTRACTION_HEADER > $report;
+		sweep_report="$REPORT_DIR/$CURR_DATE/$file-slp-sweep.csv"
+		echo $SLP_SWEEP_HEADER > $sweep_report;
+		# appended to the counters of the encoding
+		perf_report="$REPORT_DIR/$CURR_DATE/$file-gcis-perf.csv"
+		workload_report="$REPORT_DIR/$CURR_DATE/$file-gcx-extract-workloads.csv"
 
 		#generates intervals
 		echo -e "\n${YELLOW} Generating search intervals... ${RESET}"
+		if [ -x "$EXTRACT_WORKLOAD_EXECUTABLE" ]; then
+			echo $WORKLOAD_EXTRACTION_HEADER > $workload_report;
+			"$EXTRACT_WORKLOAD_EXECUTABLE" -w "$(IFS=,; echo "${EXTRACT_WORKLOADS[*]}"),mixed" -s "$(IFS=,; echo "${STR_LEN[*]}")" "$plain_file_path" "$extract_dir/$file"
+		fi
+		# the uniform queries stay those of generate_extract_input.py (random.seed(42)), comparable with older runs
 		python3 external/GCIS/scripts/generate_extract_input.py "$plain_file_path" "$extract_dir/$file"
 
-		#perform extracting
+		#queue the extractions, one job per tool and parameter
 		for length in "${STR_LEN[@]}"; do
 			query="$extract_dir/${file}.${length}_extract"
 			if [ -e $query ]; then
 				echo -e "\n${YELLOW} Generating expected responses for searched interval...${RESET}"
-				extract_answer="$extract_dir/${file}_${length}_substrings_expected_response.txt"
-				python3 scripts/extract.py $plain_file_path $extract_answer $query
-
-				#perform extract with GCX
-				for cover in "${LCP_WINDOW[@]}"; do
-					echo -e "\n\t ${YELLOW}Starting extract with GCX - $file - INTERVAL SIZE $length.${RESET}"
-					echo -e "\tUsing initial window of size $cover for LCP calculation.\n"
-					echo -n "$file|GCX-y$cover|" >> $report
-					extract_output="$extract_dir/${file}_${length}_substrings_results.txt"
-					./gcx_output -e "$compressed_file-y$cover.gcx" $extract_output $query $report
-					echo "$length" >> $report
-					checks_equality "$extract_output" "$extract_answer" "extract"
-					rm $extract_output
-				done
-
-				#perform extract with GC*
-				echo -e "\n\t ${YELLOW}Starting extract with GC* - INTERVAL SIZE $length.${RESET}"
-				for cover in "${COVERAGE_LIST[@]}"; do
-					echo -n "$file|GC$cover|" >> $report
-					extract_output="$extract_dir/${file}_result_extract_gc${cover}_len${length}.txt"
-					./gc_star_output -e "$compressed_file-gc$cover.gcx" $extract_output $cover $query $report
-					echo "$length" >> $report
-					checks_equality "$extract_output" "$extract_answer" "extract"
-					rm $extract_output
-				done
-				rm $extract_answer
-
-				#perform extract with GCIS
-				echo -e "\n${YELLOW}Starting extract with GCIS - $file - INTERVAL SIZE $length.${RESET}"
-				echo -n "$file|GCIS-ef|" >> $report
-				$GCIS_EXECUTABLE -e "$compressed_file-gcis-ef" $query -ef $report
-				echo "$length" >> $report
-
-				#perform extract with RePair
-				echo -e "\n${YELLOW} Starting extract with ShapedSlp - $file - INTERVAL SIZE $length.${RESET}"
-				for encoding in "${EXTRACT_ENCODING[@]}"; do
-					echo -n "$file|$encoding|" >> $report
-					"external/ShapeSlp/build/./ExtractBenchmark" --input="$plain_file_path-$encoding" --encoding=$encoding --query_file=$query --file_report_gcx=$report
-					echo "$length" >> $report
-				done
+				extract_answer=$(write_extract_answer "$plain_file_path" "$query" "$extract_dir/${file}_${length}_substrings_expected_response")
+
+				queue_extract_jobs "$file" "$compressed_file" "$query" "$report" "$length" "$extract_answer"
+				if [ -x "$GCIS_PERF_EXECUTABLE" ]; then
+					queue_job 0 1 "GCIS-ef" extract count_gcis_phases extract "ef" "$compressed_file-gcis-ef" "@$perf_report" "$file" "$query" "$length"
+				fi
+				queue_job 0 1 "*Slp*" extract extract_with_shaped_slp "$file" "$plain_file_path" "$query" "@$report" "$length" "@$sweep_report"
 			else
 				echo "Unable to find $query file."
 			fi
 		done
+
+		#the same tools under the non-uniform workloads (only written by extract-workload)
+		workloads=("mixed")
+		for workload in "${EXTRACT_WORKLOADS[@]}"; do
+			for length in "${WORKLOAD_STR_LEN[@]}"; do
+				workloads+=("$workload.$length")
+			done
+		done
+		for workload in "${workloads[@]}"; do
+			query="$extract_dir/${file}.${workload}_extract"
+			if [ -e $query ]; then
+				extract_answer=$(write_extract_answer "$plain_file_path" "$query" "$extract_dir/${file}_${workload}_substrings_expected_response")
+
+				queue_extract_jobs "$file" "$compressed_file" "$query" "$workload_report" "$workload" "$extract_answer"
+				queue_job 0 1 "*Slp*" extract extract_workload_with_shaped_slp "$file" "$plain_file_path" "$query" "@$workload_report" "$workload"
+			fi
+		done
 	done
+	run_jobs
+	local status=$?
+	# the expected responses are shared by the jobs of a length
+	rm -f "${REPORT_DIR:?}/${CURR_DATE:?}/extract/"*_substrings_expected_response.*
 	clean_tools
+	return $status
+}
+
+# every codec in one process per file: the input is read once, each operation is
+# repeated and the results are checked in memory (needs the SLP encodings written
+# by compress_and_decompress_with_repair and the queries written by run_extract)
+run_in_process_benchmark() {
+	echo -e "\n${BLUE}####### In-process benchmark ${RESET}"
+	for file in $files; do
+		plain_file_path="$RAW_FILES_DIR/$file"
+		extract_dir="$REPORT_DIR/$CURR_DATE/extract"
+		report="$REPORT_DIR/$CURR_DATE/$file-native-encoding.csv"
+		extract_report="$REPORT_DIR/$CURR_DATE/$file-native-extract.csv"
+		echo $COMPRESSION_HEADER > $report
+		echo $EXTRACTION_HEADER > $extract_report
+
+		queries=()
+		for length in "${STR_LEN[@]}"; do
+			query="$extract_dir/${file}.${length}_extract"
+			if [ -e $query ]; then
+				queries+=(-q "$query")
+			fi
+		done
+
+		echo -e "\n\t${YELLOW}Starting the in-process benchmark - $file ${RESET}\n"
+		if ! "$GCIS_BENCH_EXECUTABLE" -l "$file" -p "$plain_file_path-" "${queries[@]}" -x "$extract_report" "$plain_file_path" "$report"; then
+			echo "$file: gcis-bench found a wrong result." >> "$GENERAL_REPORT/errors/errors-native-compress.txt"
+		fi
+	done
+}
+
+# microbenchmark of the GCIS kernels on the synthetic inputs and on a prefix of
+# every file, labelled with the commit so that the rows of two commits can be
+# compared
+run_kernel_benchmark() {
+	echo -e "\n${BLUE}####### GCIS kernels ${RESET}"
+	if [ ! -x "$GCIS_KERNELS_EXECUTABLE" ]; then
+		echo "$GCIS_KERNELS_EXECUTABLE not found, skipping it."
+		return
+	fi
+	report="$REPORT_DIR/$CURR_DATE/gcis-kernels.csv"
+	echo $GCIS_KERNELS_HEADER > $report
+
+	inputs=()
+	for file in $files; do
+		inputs+=(-i "$RAW_FILES_DIR/$file")
+	done
+	label=$(git rev-parse --short HEAD 2>/dev/null || echo "unknown")
+	"$GCIS_KERNELS_EXECUTABLE" -l "$label" -g random,versions "${inputs[@]}" "$report"
 }
 
 generate_graphs() {
 	echo -e "\n\n${GREEN}%%% Starting the generation of the graphs. ${RESET}"
 
-	python3 scripts/graphs/report.py "$REPORT_DIR/$CURR_DATE/*-gcx-encoding" "$REPORT_DIR/$CURR_DATE" "compress" "en" "report"
+	# the reports from the records; the graphs take every tool but GCX and GC* from them
+	[ -s "$GCX_RECORDS" ] && python3 scripts/records_to_csv.py "$GCX_RECORDS" "$REPORT_DIR/$CURR_DATE/records"
+	python3 scripts/graphs/report.py "$REPORT_DIR/$CURR_DATE/*-gcx-encoding" "$REPORT_DIR/$CURR_DATE" "compress" "en" "report" "$REPORT_DIR/$CURR_DATE/records"
 	#python3 scripts/graphs/report.py "$REPORT_DIR/$CURR_DATE/*-gcx-extract" "$REPORT_DIR/$CURR_DATE" "extract" "en" "report"
 	#python3 scripts/graphsE/report.py "$REPORT_DIR/$CURR_DATE/*-gcx-grammar" "$REPORT_DIR/$CURR_DAT" "grammar" "en" "report"
 
 	echo -e "\n\n${GREEN}%%% FINISHED. ${RESET}"
 }
 
+# Regression gate: compares the reports of this run with those of the runs in $BASELINE
+# (report folders, e.g. BASELINE="report/2025-05-22 report/2025-05-23") and fails on
+# time or memory regressions, or when nothing matches (scripts/compare_runs.py; COMPARE_OPTIONS
+# are passed to it, e.g. COMPARE_OPTIONS="-t 0.05 -m 0.02"). A regression is only tested with
+# REPETITIONS >= 4 on both sides; with fewer the changes are reported and the run does not fail.
+check_regressions() {
+	[ -z "$BASELINE" ] && return 0
+	echo -e "\n\n${GREEN}%%% Comparing with the baseline $BASELINE ${RESET}"
+	python3 scripts/compare_runs.py $COMPARE_OPTIONS -o "$REPORT_DIR/$CURR_DATE/regressions.csv" "$REPORT_DIR/$CURR_DATE" $BASELINE
+	local status=$?
+	if [ $status -eq 1 ]; then
+		echo -e "${RED}Regressions over the baseline, see $REPORT_DIR/$CURR_DATE/regressions.csv ${RESET}"
+	fi
+	return $status
+}
+
 build_tools() {
     make clean -C "$GCX_PATH" OUTPUT="$GCX_MAIN_EXEC_PATH"
     make compile -C "$GCX_PATH" MACROS="REPORT=1 FILE_OUTPUT=1" OUTPUT="$GCX_MAIN_EXEC_PATH"
@@ -299,7 +855,10 @@ clean_tools() {
 if [ "$0" = "$BASH_SOURCE" ]; then
 	check_and_create_folder
 	download_files
-	evaluate_compression_performance
-	run_extract
+	evaluate_compression_performance || exit 1
+	run_extract || exit 1
+	run_in_process_benchmark
+	run_kernel_benchmark
 	generate_graphs
+	check_regressions || exit 1
 fi
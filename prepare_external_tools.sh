@@ -5,7 +5,7 @@ REPO_DIR="$(cd "$(dirname "$0")"; pwd)"
 echo "\n\t${GREEN}$REPO_DIR\n\t${GREEN}"
 SOURCE_DIR=$(pwd)
 
-submodules=("external/malloc_count" "external/GCIS" "external/ShapeSlp"  "external/sdsl-lite" "external/7zip" "external/bzip2") 
+submodules=("external/malloc_count" "external/GCIS" "external/ShapeSlp"  "external/sdsl-lite" "external/7zip" "external/bzip2" "external/GLZA") 
 
 need_init=0
 
@@ -23,6 +23,9 @@ else
     echo -e "Todos os submódulos já estão prontos."
 fi
 
+# gcx_probe.h, used by the report hooks of every tool
+cp -f external-overrides/malloc_count/* external/malloc_count/
+
 if [ ! -d "external/sdsl-lite/build/include" ]; then
     echo -e "\n\t${GREEN}####### Instalando a SDSL-lite ${RESET}"
     cp external-overrides/sdsl/include/sdsl/louds_tree.hpp external/sdsl-lite/include/sdsl/louds_tree.hpp
@@ -116,4 +119,20 @@ else
     echo -e "${BLUE}## Bzip2 já configurada. ${RESET}"
 fi
 
-
+if [ ! -f "external/GLZA/GLZAcompress" ]; then
+    echo -e "\n\t${GREEN}####### Compilando GLZA ${RESET}"
+    cp -rf external-overrides/glza/* external/GLZA/
+    cd external/GLZA
+    gcc -O3 -o GLZAcompress GLZAcompress.c ../malloc_count/malloc_count.c ../malloc_count/stack_count.c -lpthread -lm -ldl
+    # GLZAmodel.c only exists in some GLZA versions
+    model=""
+    if [ -f GLZAmodel.c ]; then
+        model=GLZAmodel.c
+    fi
+    for tool in GLZAformat GLZAencode GLZAdecode; do
+        gcc -O3 -o $tool $tool.c $model -lpthread -lm
+    done
+    cd $SOURCE_DIR
+else
+    echo -e "${BLUE}## GLZA já configurado. ${RESET}"
+fi
@@ -0,0 +1,175 @@
+"""
+Regression gate: compares the reports of a run with those of earlier runs.
+
+Rows of the pipe CSV reports (report/<date>/<file>-<report>-<kind>.csv) are matched by
+(kind, file, algorithm, params), params being every column that is not a measurement
+(substring_size, workload, threads, ...). Every row of a key is one measurement: the
+baseline may be several dated runs, and a run that appends repeated rows to its reports
+gives repeated candidate measurements.
+
+For each time (time, cpu, wall) and memory (peak, stack, rss) column of a key, the median
+of the candidate is compared with the median of the baseline. It is a regression when it
+is larger by more than the threshold of the column and a one-sided Mann-Whitney U test
+says the candidate is larger (p < alpha), which needs MIN_SAMPLES measurements on both
+sides (REPETITIONS=4 of measure_compression.sh). With fewer measurements there is no test:
+a change over the threshold is reported as untested and does not fail the run.
+Times below MIN_TIME seconds are noise and never regress.
+
+Reports of older runs are read as they were written:
+- the *-dcx-* reports, from before the project was renamed, are the gcx ones;
+- numbers may have a decimal comma (12,000000 of the runs on macOS);
+- until the reports had cpu columns, their times were the CPU time of clock(), so a report
+  without compression_cpu / decompression_cpu / cpu has its compression_time /
+  decompression_time / time compared as that CPU column, never with the wall time.
+
+Prints the regressions and the untested changes (all compared metrics with -v), writes them
+to -o as a pipe CSV and exits with 1 if there are regressions, with 2 if no row of the
+candidate matches the baseline.
+
+usage: python3 scripts/compare_runs.py [-t time threshold] [-m memory threshold] [-a alpha]
+                                       [-o output] [-v] <candidate dir> <baseline dir>...
+"""
+import argparse
+import csv
+import glob
+import os
+import re
+import statistics
+import sys
+
+from scipy.stats import mannwhitneyu
+
+TIME_COLUMN = re.compile(r'time|cpu|wall')
+MEMORY_COLUMN = re.compile(r'peak|stack|rss')
+# measurements that are not compared (sizes are checked by checks_equality and the graphs)
+IGNORED_COLUMNS = {'compressed_size', 'plain_size', 'encoded_size', 'calls', 'xs_size'}
+REPORT_NAME = re.compile(r'^(?P<file>.+)-(?P<report>[^-]+)-(?P<kind>encoding|extract|extract-workloads)\.csv$')
+REPORT_ALIASES = {'dcx': 'gcx'}
+# the CPU time column of each time column that held clock() before the reports had them
+CPU_COLUMNS = {'compression_time': 'compression_cpu', 'decompression_time': 'decompression_cpu', 'time': 'cpu'}
+
+# default thresholds, relative to the baseline median
+TIME_THRESHOLD = 0.10
+MEMORY_THRESHOLD = 0.05
+ALPHA = 0.05
+MIN_SAMPLES = 4
+MIN_TIME = 0.01
+
+OUTPUT_HEADER = ['kind', 'file', 'algorithm', 'params', 'metric', 'baseline', 'candidate', 'change',
+                 'n_baseline', 'n_candidate', 'p_value', 'verdict']
+
+
+def metric_kind(column):
+    if column in IGNORED_COLUMNS:
+        return None
+    if TIME_COLUMN.search(column):
+        return 'time'
+    if MEMORY_COLUMN.search(column):
+        return 'memory'
+    return None
+
+
+def to_number(value):
+    try:
+        return float(value.replace(',', '.'))
+    except (AttributeError, ValueError):
+        return None
+
+
+def load_run(directory, samples):
+    """Adds the measurements of the reports of directory to samples[key][column]."""
+    for path in glob.glob(os.path.join(directory, '*.csv')):
+        name = REPORT_NAME.match(os.path.basename(path))
+        if not name:
+            continue
+        report_name = REPORT_ALIASES.get(name.group('report'), name.group('report'))
+        with open(path, newline='') as report:
+            reader = csv.DictReader(report, delimiter='|')
+            columns = [c for c in reader.fieldnames or [] if c]
+            params = [c for c in columns
+                      if c not in ('file', 'algorithm') and c not in IGNORED_COLUMNS and not metric_kind(c)]
+            metrics = [c for c in columns if metric_kind(c)]
+            # column of the samples of each metric: the times of a report without cpu columns are CPU times
+            if not any(cpu in columns for cpu in CPU_COLUMNS.values()):
+                names = {c: CPU_COLUMNS.get(c, c) for c in metrics}
+            else:
+                names = {c: c for c in metrics}
+            for row in reader:
+                if not row.get('algorithm'):
+                    continue
+                key = (f"{report_name}-{name.group('kind')}", row.get('file') or '', row['algorithm'],
+                       ','.join(f"{p}={row.get(p) or ''}" for p in params))
+                for column in metrics:
+                    value = to_number(row.get(column))
+                    if value is not None:
+                        samples.setdefault(key, {}).setdefault(names[column], []).append(value)
+
+
+def compare(baseline, candidate, column, thresholds, alpha):
+    kind = metric_kind(column)
+    base, cand = statistics.median(baseline), statistics.median(candidate)
+    if base <= 0 or (kind == 'time' and max(base, cand) < MIN_TIME):
+        return None, None, 'skipped'
+    change = cand / base - 1
+    if len(baseline) < MIN_SAMPLES or len(candidate) < MIN_SAMPLES:
+        if change > thresholds[kind]:
+            return change, None, 'untested regression'
+        if change < -thresholds[kind]:
+            return change, None, 'untested improvement'
+        return change, None, 'unchanged'
+    p_value = mannwhitneyu(candidate, baseline, alternative='greater').pvalue
+    if change > thresholds[kind] and p_value < alpha:
+        return change, p_value, 'regression'
+    if change < -thresholds[kind]:
+        return change, p_value, 'improvement'
+    return change, p_value, 'unchanged'
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='Flags time and memory regressions of a run.')
+    parser.add_argument('candidate')
+    parser.add_argument('baseline', nargs='+')
+    parser.add_argument('-t', '--time-threshold', type=float, default=TIME_THRESHOLD)
+    parser.add_argument('-m', '--memory-threshold', type=float, default=MEMORY_THRESHOLD)
+    parser.add_argument('-a', '--alpha', type=float, default=ALPHA)
+    parser.add_argument('-o', '--output')
+    parser.add_argument('-v', '--verbose', action='store_true')
+    args = parser.parse_args(argv[1:])
+    thresholds = {'time': args.time_threshold, 'memory': args.memory_threshold}
+
+    baseline, candidate = {}, {}
+    for directory in args.baseline:
+        load_run(directory, baseline)
+    load_run(args.candidate, candidate)
+
+    results = []
+    for key in sorted(set(baseline) & set(candidate)):
+        for column in sorted(set(baseline[key]) & set(candidate[key])):
+            base, cand = baseline[key][column], candidate[key][column]
+            change, p_value, verdict = compare(base, cand, column, thresholds, args.alpha)
+            results.append(list(key) + [column, f"{statistics.median(base):g}", f"{statistics.median(cand):g}",
+                                        'NA' if change is None else f"{change:+.2%}", len(base), len(cand),
+                                        'NA' if p_value is None else f"{p_value:.4f}", verdict])
+    if not results:
+        print(f"no row of {args.candidate} matches {' '.join(args.baseline)}")
+        return 2
+
+    regressions = [r for r in results if r[-1] == 'regression']
+    untested = [r for r in results if r[-1] == 'untested regression']
+    shown = results if args.verbose else regressions + untested
+    for r in shown:
+        print('|'.join(map(str, r)))
+    if args.output:
+        with open(args.output, 'w', newline='') as output:
+            writer = csv.writer(output, delimiter='|', lineterminator='\n')
+            writer.writerow(OUTPUT_HEADER)
+            writer.writerows(shown)
+
+    keys = len({tuple(r[:4]) for r in results})
+    print(f"{len(results)} metrics of {keys} rows compared, {len(regressions)} regressions, "
+          f"{len(untested)} untested changes over the threshold (fewer than {MIN_SAMPLES} measurements)")
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
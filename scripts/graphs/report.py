@@ -29,6 +29,9 @@ extract_values = {
 
 sep_decimal= "."
 
+# rows that only the pipe CSVs have: GCX and GC* write no records
+GCX_PATTERN = r'^(GCX-y\d+|GC\d+)$'
+
 def generate_grammar_chart(df_list, output_dir, language):
     for df in df_list:
         print(f"\n## FILE: {df.index[0]}")
@@ -45,9 +48,8 @@ def generate_extract_chart(df_list, output_dir, language):
 
 def generate_compress_chart(df_list, output_dir, language):
     for df in df_list:
-        pattern = r'^(GCX-y\d+|GC\d+)$'
-        dcx = df[df['algorithm'].str.match(pattern, na=False)]
-        others =  df[~df['algorithm'].str.match(pattern, na=False)]
+        dcx = df[df['algorithm'].str.match(GCX_PATTERN, na=False)]
+        others =  df[~df['algorithm'].str.match(GCX_PATTERN, na=False)]
        
         print(f"\n## FILE: {df.index[0]}")
         plt.generate_chart_bar(dcx, others, language.COMPRESS_AND_DECOMPRESS['cmp_time'], output_dir)
@@ -102,17 +104,34 @@ def prepare_dataset(df: pd.DataFrame, operation: str):
 
     return df
 
-def get_data_frame(path: str, operation: str, report: bool) -> List[pd.DataFrame]:
+def read_report(file: str, records_dir: str) -> pd.DataFrame:
+    """
+        The GCX and GC* rows of the pipe CSV and, when scripts/records_to_csv.py wrote the same
+        report in records_dir, the rows of every other tool from it.
+    """
+    df = pd.read_csv(file, sep='|', decimal=sep_decimal, on_bad_lines='skip')
+    records = os.path.join(records_dir, os.path.basename(file)) if records_dir else None
+    if records and os.path.isfile(records):
+        gcx = df[df['algorithm'].str.match(GCX_PATTERN, na=False)]
+        df = pd.concat([gcx, pd.read_csv(records, sep='|', decimal='.', on_bad_lines='skip')], ignore_index=True)
+    return df
+
+def get_data_frame(path: str, operation: str, report: bool, records_dir: str = None) -> List[pd.DataFrame]:
     files = glob.glob(f"{path}*.csv")
     df_list = []
 
     for file in files:
-        df = pd.read_csv(file, sep='|', decimal=sep_decimal, on_bad_lines='skip')
+        df = read_report(file, records_dir)
         if operation == "compress":
+            # one row per algorithm: the median of the repetitions of the run (REPETITIONS)
+            df = df.groupby(['file', 'algorithm'], as_index=False, sort=False).median(numeric_only=True)
             df = prepare_dataset(df, operation)
             set_max_values(compress_max_values, df)
             set_summary(compression_summary, df)
         elif operation == "extract":
+            # one point per algorithm and substring size (or workload): the median of the repetitions
+            keys = ['file', 'algorithm'] + [c for c in ('substring_size', 'workload') if c in df.columns]
+            df = df.groupby(keys, as_index=False, sort=False).median(numeric_only=True)
             df = prepare_dataset(df, operation)
             set_max_values(extract_values, df)
             set_summary(extract_summary, df)
@@ -164,17 +183,18 @@ def generate_tables(df_list, language, table_path_dir):
 
 def main(argv):
     if len(argv) < 5:
-        print("Uso: script.py <input_dir> <output_dir> <operation> <locale> [report]")
+        print("Uso: script.py <input_dir> <output_dir> <operation> <locale> [report] [records_dir]")
         sys.exit(1)
 
     path = argv[1]
     operation = argv[3]
     locale = argv[4]
     report =  argv[5] if len(sys.argv) > 5 else False
+    records_dir = argv[6] if len(sys.argv) > 6 else None
     graph_path_dir = f"{argv[2]}/graphs/{locale}"
 
     language = ut.set_locale(locale)
-    df_list = get_data_frame(path, operation, report)
+    df_list = get_data_frame(path, operation, report, records_dir)
 
     generate_charts(operation, df_list, graph_path_dir, language)
     
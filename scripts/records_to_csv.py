@@ -0,0 +1,109 @@
+import csv
+import json
+import os
+import sys
+from collections import OrderedDict
+
+# Reports of scripts/graphs from the records of gcx_record.h (records.jsonl of a run):
+#   <file>-<report>-encoding.csv            compression, decompression and size records
+#   <file>-<report>-extract.csv             extraction records with substring_size
+#   <file>-<report>-extract-workloads.csv   extraction records with workload
+# <report> is the report parameter of the records (gcx if absent). The columns are
+# those of measure_compression.sh, so the reports read the same as the pipe CSVs, with
+# one row per repetition of the run (REPETITIONS).
+#
+# usage: python3 scripts/records_to_csv.py <records.jsonl> <output dir>
+
+COMPRESSION_HEADER = ["file", "algorithm", "peak_comp", "stack_comp", "compression_time",
+                      "compression_cpu", "peak_rss_comp", "peak_decomp", "stack_decomp",
+                      "decompression_time", "decompression_cpu", "peak_rss_decomp",
+                      "compressed_size", "plain_size"]
+EXTRACTION_HEADER = ["file", "algorithm", "peak", "stack", "time", "cpu", "peak_rss"]
+PROBE = ["peak", "stack", "wall", "cpu", "peak_rss"]
+
+
+def read_records(path):
+    records = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                records.append(json.loads(line))
+            except json.JSONDecodeError:
+                print(f"{path}:{number}: malformed record, skipped", file=sys.stderr)
+    return records
+
+
+def metrics(record, names):
+    values = record["metrics"] if record else {}
+    return [values.get(name, "NA") for name in names]
+
+
+def encoding_rows(records):
+    # the records of each phase of (report, file, algorithm), one per repetition of the run
+    groups = OrderedDict()
+    for r in records:
+        params = r.get("params", {})
+        if r["phase"] not in ("compression", "decompression", "size"):
+            continue
+        if "substring_size" in params or "workload" in params:
+            continue
+        key = (params.get("report", "gcx"), r["file"], r["algorithm"])
+        groups.setdefault(key, {}).setdefault(r["phase"], []).append(r)
+
+    rows = {}
+    for (report, file, algorithm), phases in groups.items():
+        size = phases.get("size")
+        # e.g. REPAIR-<encoding> has only its size, the times are those of params.timing
+        timing = size[-1]["params"].get("timing") if size else None
+        if timing:
+            phases = dict(groups.get((report, file, timing), {}), size=size)
+        missing = [p for p in ("compression", "decompression", "size") if p not in phases]
+        if missing:
+            print(f"{file}|{algorithm} ({report}): no {', '.join(missing)} record, skipped",
+                  file=sys.stderr)
+            continue
+        # the i-th records of the phases are those of the i-th repetition
+        for i in range(min(len(phases[p]) for p in ("compression", "decompression", "size"))):
+            row = [file, algorithm]
+            row += metrics(phases["compression"][i], PROBE)
+            row += metrics(phases["decompression"][i], PROBE)
+            row += metrics(phases["size"][i], ["compressed_size", "plain_size"])
+            rows.setdefault((file, report, "encoding", "substring_size"), []).append(row)
+    return rows
+
+
+def extraction_rows(records):
+    rows = {}
+    for r in records:
+        params = r.get("params", {})
+        if r["phase"] != "extraction":
+            continue
+        for column, suffix in (("substring_size", "extract"), ("workload", "extract-workloads")):
+            if column in params:
+                row = [r["file"], r["algorithm"]] + metrics(r, PROBE) + [params[column]]
+                rows.setdefault((r["file"], params.get("report", "gcx"), suffix, column),
+                                []).append(row)
+    return rows
+
+
+def write_reports(rows, output_dir):
+    for (file, report, suffix, column), values in rows.items():
+        header = COMPRESSION_HEADER if suffix == "encoding" else EXTRACTION_HEADER + [column]
+        path = os.path.join(output_dir, f"{file}-{report}-{suffix}.csv")
+        with open(path, "w", newline="") as f:
+            writer = csv.writer(f, delimiter="|", lineterminator="\n")
+            writer.writerow(header)
+            writer.writerows(values)
+        print(f"{path}: {len(values)} rows")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit(f"usage: {sys.argv[0]} <records.jsonl> <output dir>")
+    records = read_records(sys.argv[1])
+    os.makedirs(sys.argv[2], exist_ok=True)
+    write_reports(encoding_rows(records), sys.argv[2])
+    write_reports(extraction_rows(records), sys.argv[2])
@@ -0,0 +1,187 @@
+"""
+Runs the jobs queued by measure_compression.sh (queue_job) concurrently.
+
+Every line of the jobs file is
+    solo <TAB> threads <TAB> file <TAB> plain_size <TAB> algorithms <TAB> kind <TAB> command
+where algorithms is a pattern (fnmatch) of the report rows the job writes and kind
+is the report they go to (encoding or extract).
+
+- Each job gets <threads> dedicated cores (sched_setaffinity, Linux only), and a solo
+  job gets the machine: it starts when nothing else runs and nothing starts with it.
+- A job is admitted only when its predicted peak fits the memory budget together
+  with the running jobs. The prediction is the largest peak* column of the rows of
+  the same file and algorithm in earlier reports (report/*/<file>-gcx-<kind>.csv),
+  or plain_size * default factor when there is none.
+- Jobs start in queue order; the output of each one goes to <jobs dir>/<pass>-<n>.log and
+  schedule-<pass>.csv records where and for how long every job ran. The pass (default 1)
+  numbers the runs of the same queue (REPETITIONS of measure_compression.sh), so a pass
+  never overwrites the logs of another.
+- Jobs get no stdin: a tool that asks a question fails instead of waiting for an answer.
+
+usage: python3 scripts/scheduler.py <jobs file> <report dir> [max jobs] [memory budget in bytes] [pass]
+"""
+import csv
+import fnmatch
+import glob
+import os
+import subprocess
+import sys
+import time
+
+# margin over the largest peak seen, and the guess for jobs with no history
+PEAK_MARGIN = 1.25
+DEFAULT_PEAK_FACTOR = 10
+# fraction of the available memory used when no budget is given
+MEMORY_FRACTION = 0.8
+# seconds between checks of the running jobs
+POLL_INTERVAL = 0.1
+
+
+class Job:
+    def __init__(self, index, line):
+        solo, threads, file, plain_size, algorithms, kind, command = line.rstrip('\n').split('\t', 6)
+        self.index = index
+        self.solo = solo == '1'
+        self.threads = max(1, int(threads))
+        self.file = file
+        self.plain_size = int(plain_size)
+        self.algorithms = algorithms
+        self.kind = kind
+        self.command = command
+        self.peak = 0
+        self.cores = []
+        self.start = 0.0
+
+
+def available_memory():
+    try:
+        with open('/proc/meminfo') as meminfo:
+            for line in meminfo:
+                if line.startswith('MemAvailable:'):
+                    return int(line.split()[1]) * 1024
+    except OSError:
+        pass
+    return os.sysconf('SC_PAGE_SIZE') * os.sysconf('SC_PHYS_PAGES')
+
+
+def available_cores():
+    if hasattr(os, 'sched_getaffinity'):
+        return sorted(os.sched_getaffinity(0))
+    return list(range(os.cpu_count() or 1))
+
+
+def predict_peak(job, report_dir, history):
+    key = (job.file, job.kind)
+    if key not in history:
+        rows = []
+        for path in glob.glob(os.path.join(report_dir, '*', f"{job.file}-gcx-{job.kind}.csv")):
+            with open(path, newline='') as report:
+                rows += [row for row in csv.DictReader(report, delimiter='|')]
+        history[key] = rows
+
+    peak = 0
+    for row in history[key]:
+        if row.get('file') != job.file or not fnmatch.fnmatch(row.get('algorithm') or '', job.algorithms):
+            continue
+        for column, value in row.items():
+            if column and column.startswith('peak'):
+                try:
+                    peak = max(peak, int(float(value)))
+                except (TypeError, ValueError):
+                    pass
+    # bzip2 and 7zip rows have no malloc_count peak
+    if peak == 0:
+        return job.plain_size * DEFAULT_PEAK_FACTOR
+    return int(peak * PEAK_MARGIN)
+
+
+def start_job(job, jobs_dir, repo_dir, run):
+    log = open(os.path.join(jobs_dir, f"{run}-{job.index:05d}.log"), 'w')
+    cores = job.cores
+
+    def pin():
+        if cores and hasattr(os, 'sched_setaffinity'):
+            os.sched_setaffinity(0, cores)
+
+    job.start = time.monotonic()
+    process = subprocess.Popen(['bash', '-c', f"source ./measure_compression.sh && {job.command}"],
+                               cwd=repo_dir, stdin=subprocess.DEVNULL, stdout=log, stderr=subprocess.STDOUT, preexec_fn=pin)
+    log.close()
+    return process
+
+
+def schedule(jobs, report_dir, jobs_dir, max_jobs, budget, run):
+    repo_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    cores = available_cores()
+    free_cores = list(cores)
+    history = {}
+    for job in jobs:
+        job.peak = predict_peak(job, report_dir, history)
+
+    pending = list(jobs)
+    running = {}
+    used_memory = 0
+    failed = 0
+    with open(os.path.join(jobs_dir, f"schedule-{run}.csv"), 'w', newline='') as log:
+        writer = csv.writer(log, delimiter='|')
+        writer.writerow(['job', 'file', 'algorithms', 'solo', 'cores', 'predicted_peak', 'exit', 'wall', 'command'])
+        while pending or running:
+            # admission, in queue order
+            while pending and len(running) < max_jobs:
+                job = pending[0]
+                if running and (job.solo or any(j.solo for j, _ in running.values())):
+                    break
+                needed = len(cores) if job.solo else min(job.threads, len(cores))
+                if len(free_cores) < needed:
+                    break
+                # a job larger than the budget runs alone
+                if running and used_memory + job.peak > budget:
+                    break
+                if job.peak > budget:
+                    print(f"warning: job {job.index} ({job.file} {job.algorithms}) may need "
+                          f"{job.peak} bytes, more than the budget of {budget}")
+                job.cores, free_cores = free_cores[:needed], free_cores[needed:]
+                used_memory += job.peak
+                process = start_job(job, jobs_dir, repo_dir, run)
+                running[process.pid] = (job, process)
+                pending.pop(0)
+                print(f"[{time.strftime('%H:%M:%S')}] started job {job.index}: {job.file} {job.algorithms}"
+                      f" on cores {','.join(map(str, job.cores))}{' (solo)' if job.solo else ''}")
+
+            finished = [pid for pid, (_, process) in running.items() if process.poll() is not None]
+            if not finished:
+                time.sleep(POLL_INTERVAL)
+                continue
+            job, process = running.pop(finished[0])
+            wall = time.monotonic() - job.start
+            free_cores = sorted(free_cores + job.cores)
+            used_memory -= job.peak
+            if process.returncode != 0:
+                failed += 1
+            writer.writerow([job.index, job.file, job.algorithms, int(job.solo), ','.join(map(str, job.cores)),
+                             job.peak, process.returncode, f"{wall:.4f}", job.command])
+            log.flush()
+            print(f"[{time.strftime('%H:%M:%S')}] finished job {job.index}: {job.file} {job.algorithms}"
+                  f" in {wall:.1f}s, exit {process.returncode}")
+    return failed
+
+
+def main(argv):
+    jobs_file = argv[1]
+    report_dir = argv[2]
+    max_jobs = int(argv[3]) if len(argv) > 3 and int(argv[3]) > 0 else len(available_cores())
+    budget = int(argv[4]) if len(argv) > 4 and int(argv[4]) > 0 else int(available_memory() * MEMORY_FRACTION)
+    run = int(argv[5]) if len(argv) > 5 else 1
+
+    with open(jobs_file) as queue:
+        jobs = [Job(i, line) for i, line in enumerate(queue) if line.strip()]
+    jobs_dir = os.path.dirname(os.path.abspath(jobs_file))
+    print(f"{len(jobs)} jobs, at most {max_jobs} at a time, memory budget {budget} bytes")
+    failed = schedule(jobs, report_dir, jobs_dir, max_jobs, budget, run)
+    if failed:
+        print(f"{failed} jobs failed, see {jobs_dir}")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -6,7 +6,8 @@ BLUE='\033[34m'
 YELLOW='\033[33m'
 RED='\033[31m'
 RESET='\033[0m'
-CURR_DATE=$(date +"%Y-%m-%d")
+# jobs run by scripts/scheduler.py get the date of the run that queued them
+CURR_DATE=${CURR_DATE:-$(date +"%Y-%m-%d")}
 
 #files to compress
 files=()
@@ -19,7 +20,7 @@ RAW_FILES_DIR="dataset/raw_files"
 
 if [ "$(uname -s)" = "Darwin" ]; then
     stat_options="-f %z"
-    CURR_DATE="$CURR_DATE-mac"
+    CURR_DATE="${CURR_DATE%-mac}-mac"
     FILE_URLS=$(cat files_paths/initial_test_files.txt)
 else
     stat_options="-c %s"
@@ -88,3 +89,19 @@ checks_equality() {
 	echo -e "\n\t\t\t ${GREEN} The files are the same. ${RESET}\n"
     fi
 }
+
+# seconds since the epoch with sub-second precision: $EPOCHREALTIME of bash 5 (no new process),
+# else GNU date +%N; only the date of macOS, without %N, needs python3
+if [ -n "$EPOCHREALTIME" ]; then
+    wall_clock() {
+        echo "${EPOCHREALTIME/,/.}"
+    }
+elif [ "$(date +%N)" != "N" ]; then
+    wall_clock() {
+        date +%s.%N
+    }
+else
+    wall_clock() {
+        python3 -c 'import time; print("%.6f" % time.time())'
+    }
+fi